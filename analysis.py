@@ -1,8 +1,6 @@
 import sys
 import numpy as np
-import symnmf
-import kmeans #modified HW1 kmeans implementation
-from sklearn.metrics import silhouette_score
+import symnmf # also runs the kmeans.py clustering and the silhouette score natively
 
 np.random.seed(1234)
 
@@ -11,29 +9,27 @@ def main():
     k = int(sys.argv[1])
     file_name = sys.argv[2]
     
-    # parse the points into a python matrix using numpy's loadtxt
-    np_array = np.loadtxt(file_name, delimiter = ',')
-    data_points = np_array.tolist()
-    N = len(data_points)
+    # parse the points with the C loader
+    np_array = np.asarray(symnmf.load_csv(file_name))
+    N = len(np_array)
     
     # call c module to compute the optimized H matrix
-    W = symnmf.norm(data_points)
-    m = np.array(W).mean() #convert to numpy array and get average cleanly
+    W = symnmf.norm_packed(np_array) # numpy arrays are read in place, W is kept as its upper triangle
+    m = W.mean()
     upper_bound = 2 * np.sqrt(m/k)
-    N = len(data_points)
     init_H = np.random.uniform(low=0, high=upper_bound, size=(N,k)) # a random matrix of size Nxk with values in the legal interval
-    optimized_H = symnmf.symnmf(W, init_H.tolist()) #pass W and the initial H in the form of a python matrix
+    optimized_H = symnmf.symnmf(W, init_H) #W and the initial H are passed as buffers
 
     #convert the H matrix to a numpy array and extract the custer assignment for each point using argmax()
-    H_np = np.array(optimized_H)
+    H_np = np.asarray(optimized_H)
     symnmf_clusters = np.argmax(H_np, axis=1)
     
-    #get the cluster assignment from kmeans.py
-    kmeans_clusters = kmeans.find_kmeans_labels(data_points, k)
+    #get the cluster assignment of kmeans.find_kmeans_labels, computed by the C module
+    kmeans_clusters = symnmf.kmeans(np_array, k)
     
-    #get silhouette scores
-    symnmf_score = silhouette_score(data_points, symnmf_clusters)
-    kmeans_score = silhouette_score(data_points, kmeans_clusters)
+    #get silhouette scores, the values of sklearn's silhouette_score
+    symnmf_score = symnmf.silhouette(np_array, symnmf_clusters)
+    kmeans_score = symnmf.silhouette(np_array, kmeans_clusters)
     
     print(f"nmf: {symnmf_score:.4f}")
     print(f"kmeans: {kmeans_score:.4f}")
@@ -0,0 +1,155 @@
+import sys
+import os
+import json
+import time
+import platform
+import argparse
+import tempfile
+import subprocess
+import numpy as np
+import symnmf
+
+'''
+============================================MAKE_BLOBS===========================================
+a synthetic dataset of N points in d dimensions drawn around k gaussian centers, the same seed
+always gives the same points
+'''
+def make_blobs(N, d, k, seed):
+    rng = np.random.RandomState(seed)
+    centers = rng.uniform(-10, 10, size=(k, d))
+    labels = rng.randint(0, k, size=N)
+    return centers[labels] + rng.normal(0, 1, size=(N, d))
+
+'''
+============================================WRITE_POINTS=========================================
+writes the points in the input format of symnmf.py and ./symnmf, 4 decimals per coordinate
+'''
+def write_points(points, file_name):
+    np.savetxt(file_name, points, fmt='%.4f', delimiter=',')
+
+'''
+============================================BEST_TIME============================================
+runs fn repeat times and returns the fastest wall time, the least disturbed run, with the value
+fn returned on that run
+'''
+def best_time(fn, repeat):
+    best, value = None, None
+    for _ in range(repeat):
+        start = time.perf_counter()
+        result = fn()
+        elapsed = time.perf_counter() - start
+        if best is None or elapsed < best:
+            best, value = elapsed, result
+    return best, value
+
+'''
+============================================BENCH_SIZE===========================================
+times every stage on one generated dataset with the given thread count, one record per stage
+  read_data_points       symnmf.load_csv on the written file
+  calculate_sym_matrix   symnmf.sym
+  calculate_norm_matrix  symnmf.norm
+  mat_multiply           one iteration of optimize_h, the W*H product and the k x k products
+  optimize_h             the whole optimization with the default options (iterations recorded)
+  python_roundtrip       symnmf.norm on lists of lists and back to lists, the conversion cost on
+                         top of calculate_norm_matrix
+  cli_symnmf             ./symnmf symnmf end to end, when the executable has been built
+'''
+def bench_size(N, d, k, threads, repeat, seed, cli):
+    points = make_blobs(N, d, k, seed)
+    handle, file_name = tempfile.mkstemp(suffix='.txt')
+    os.close(handle)
+    records = []
+    def record(stage, seconds, **extra):
+        entry = {'stage': stage, 'N': N, 'd': d, 'k': k, 'threads': threads, 'seconds': seconds}
+        entry.update(extra)
+        records.append(entry)
+    try:
+        write_points(points, file_name)
+        seconds, X = best_time(lambda: symnmf.load_csv(file_name, threads), repeat)
+        record('read_data_points', seconds)
+        seconds, _ = best_time(lambda: symnmf.sym(X, threads), repeat)
+        record('calculate_sym_matrix', seconds)
+        seconds, W = best_time(lambda: symnmf.norm(X, threads), repeat)
+        record('calculate_norm_matrix', seconds)
+        np.random.seed(1234) # the initialization of symnmf.py
+        init_H = np.random.uniform(low=0, high=2 * np.sqrt(np.asarray(W).mean() / k), size=(N, k))
+        seconds, _ = best_time(lambda: symnmf.symnmf(W, init_H, threads, max_iter=1, info=True), repeat)
+        record('mat_multiply', seconds)
+        seconds, result = best_time(lambda: symnmf.symnmf(W, init_H, threads, info=True), repeat)
+        record('optimize_h', seconds, iterations=result[1], converged=result[3])
+        X_list = np.asarray(X).tolist()
+        seconds, _ = best_time(lambda: symnmf.norm(X_list, threads).tolist(), repeat)
+        record('python_roundtrip', seconds)
+        if cli is not None:
+            command = [cli, '-t', str(threads), 'symnmf', str(k), file_name]
+            seconds, _ = best_time(lambda: subprocess.run(command, stdout=subprocess.DEVNULL, check=True), repeat)
+            record('cli_symnmf', seconds)
+    finally:
+        os.remove(file_name)
+    return records
+
+'''
+============================================COMPARE==============================================
+matches the results against a baseline file on (stage, N, d, k, threads) and prints one line per
+match, returns the number of stages slower than the baseline by more than the tolerance
+'''
+def compare(results, baseline_file, tolerance):
+    with open(baseline_file) as f:
+        baseline = json.load(f)
+    key = lambda r: (r['stage'], r['N'], r['d'], r['k'], r['threads'])
+    base = {key(r): r['seconds'] for r in baseline['results']}
+    regressions = 0
+    print('%-22s %7s %3s %3s %7s %11s %11s %7s' % ('stage', 'N', 'd', 'k', 'threads', 'baseline', 'now', 'ratio'))
+    for r in results:
+        if key(r) not in base:
+            continue
+        ratio = r['seconds'] / base[key(r)] if base[key(r)] > 0 else float('inf')
+        slower = ratio > 1 + tolerance
+        regressions += slower
+        print('%-22s %7d %3d %3d %7d %11.6f %11.6f %7.3f%s' % (r['stage'], r['N'], r['d'], r['k'], r['threads'],
+              base[key(r)], r['seconds'], ratio, '  REGRESSION' if slower else ''))
+    return regressions
+
+'''
+=================================================================================================
+=============================================MAIN================================================
+=================================================================================================
+'''
+def main():
+    parser = argparse.ArgumentParser(description='time the symnmf stages on generated gaussian blobs')
+    parser.add_argument('--sizes', default='500,1000,2000', help='comma separated N values')
+    parser.add_argument('--dims', type=int, default=3, help='d, coordinates per point')
+    parser.add_argument('--clusters', type=int, default=4, help='k, blobs generated and clusters fitted')
+    parser.add_argument('--threads', default='1', help='comma separated thread counts')
+    parser.add_argument('--repeat', type=int, default=3, help='runs per stage, the fastest is kept')
+    parser.add_argument('--seed', type=int, default=0, help='seed of the generated points')
+    parser.add_argument('--output', default='bench_output.txt', help='JSON results file')
+    parser.add_argument('--baseline', help='JSON results of an earlier run to compare against')
+    parser.add_argument('--tolerance', type=float, default=0.25, help='allowed slowdown against the baseline')
+    parser.add_argument('--cli', default='./symnmf', help='native executable timed end to end, skipped if missing')
+    args = parser.parse_args()
+
+    sizes = [int(n) for n in args.sizes.split(',')]
+    thread_counts = [int(t) for t in args.threads.split(',')]
+    cli = args.cli if os.path.isfile(args.cli) and os.access(args.cli, os.X_OK) else None
+    results = []
+    for N in sizes:
+        for threads in thread_counts:
+            results.extend(bench_size(N, args.dims, args.clusters, threads, args.repeat, args.seed, cli))
+            print('N=%d threads=%d done' % (N, threads), file=sys.stderr)
+    report = {
+        'machine': {'platform': platform.platform(), 'processor': platform.processor(), 'cpus': os.cpu_count(),
+                    'python': platform.python_version(), 'numpy': np.__version__},
+        'config': vars(args),
+        'results': results,
+    }
+    with open(args.output, 'w') as f:
+        json.dump(report, f, indent=1)
+    if args.baseline is not None:
+        regressions = compare(results, args.baseline, args.tolerance)
+        if regressions > 0:
+            print('%d stage(s) slower than the baseline by more than %.0f%%' % (regressions, 100 * args.tolerance))
+            sys.exit(1)
+
+if __name__ == "__main__":
+    main()
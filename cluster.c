@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "symnmf.h"
+#include "cluster.h"
+#include "profile.h"
+
+/*
+ * ========================================PADDED_COLUMNS==========================================
+ * the points transposed into d rows of `padded` entries (N rounded up to CLUSTER_BLOCK, the
+ * padding is 0), so a block of points is read along contiguous memory, one coordinate at a time
+ * returns NULL on failure, caller is the handler
+*/
+static double* padded_columns(const matrix *data_points, size_t *padded) {
+    const int N = data_points->rows, d = data_points->cols;
+    double *columns;
+    int i, c;
+    *padded = ((size_t)N + CLUSTER_BLOCK - 1) / CLUSTER_BLOCK * CLUSTER_BLOCK;
+    columns = (double *)calloc(*padded * (size_t)d, sizeof(double));
+    if (columns == NULL) { return NULL; }
+    PROFILE_ALLOC(*padded * (size_t)d * sizeof(double));
+    for (i = 0; i < N; i++) {
+        for (c = 0; c < d; c++) { columns[(size_t)c * *padded + i] = MAT_AT(data_points, i, c); }
+    }
+    return columns;
+}
+/*
+ * ========================================BLOCK_DISTANCES=========================================
+ * dist[j] = ||x_(j0 + j) - center||^2 for the CLUSTER_BLOCK points of a block, the coordinates
+ * summed in order like kmeans.euclidean()
+*/
+static void block_distances(const double *columns, size_t padded, int d, int j0, const double *center, double *dist) {
+    const double *column;
+    double sum[CLUSTER_BLOCK], coordinate, diff; /* a local sum, which no pointer can alias */
+    int j, c;
+    for (j = 0; j < CLUSTER_BLOCK; j++) { sum[j] = 0.0; }
+    for (c = 0; c < d; c++) {
+        column = columns + (size_t)c * padded + j0;
+        coordinate = center[c];
+        for (j = 0; j < CLUSTER_BLOCK; j++) {
+            diff = column[j] - coordinate;
+            sum[j] += diff * diff;
+        }
+    }
+    for (j = 0; j < CLUSTER_BLOCK; j++) { dist[j] = sum[j]; }
+}
+/*
+ * ========================================ASSIGN_POINTS===========================================
+ * labels[i] = the centroid closest to point i, the first one on ties like kmeans.assign_clusters()
+ * blocks of points are independent, so they are split between the threads
+*/
+static void assign_points(const double *columns, size_t padded, int N, int d, const matrix *centroids, int *labels) {
+    double dist[CLUSTER_BLOCK], best[CLUSTER_BLOCK];
+    int nearest[CLUSTER_BLOCK];
+    int j0, j, m, count;
+#ifdef _OPENMP
+#pragma omp parallel for private(dist, best, nearest, j, m, count) schedule(static)
+#endif
+    for (j0 = 0; j0 < N; j0 += CLUSTER_BLOCK) {
+        for (j = 0; j < CLUSTER_BLOCK; j++) { best[j] = HUGE_VAL; nearest[j] = 0; }
+        for (m = 0; m < centroids->rows; m++) {
+            block_distances(columns, padded, d, j0, MAT_ROW(centroids, m), dist);
+            for (j = 0; j < CLUSTER_BLOCK; j++) {
+                if (dist[j] < best[j]) { best[j] = dist[j]; nearest[j] = m; }
+            }
+        }
+        count = N - j0 < CLUSTER_BLOCK ? N - j0 : CLUSTER_BLOCK;
+        for (j = 0; j < count; j++) { labels[j0 + j] = nearest[j]; }
+    }
+}
+/*
+ * ========================================UPDATE_CENTROIDS========================================
+ * each centroid becomes the mean of its points, summed in point order and scaled by 1/size like
+ * kmeans.update_centroids(), the centroid of an empty cluster becomes 0
+*/
+static void update_centroids(const matrix *data_points, const int *labels, matrix *centroids, int *sizes) {
+    const int d = data_points->cols;
+    double *center, scale;
+    int i, m, c;
+    for (m = 0; m < centroids->rows; m++) {
+        sizes[m] = 0;
+        for (c = 0; c < d; c++) { MAT_AT(centroids, m, c) = 0.0; }
+    }
+    for (i = 0; i < data_points->rows; i++) {
+        center = MAT_ROW(centroids, labels[i]);
+        for (c = 0; c < d; c++) { center[c] += MAT_AT(data_points, i, c); }
+        sizes[labels[i]]++;
+    }
+    for (m = 0; m < centroids->rows; m++) {
+        scale = sizes[m] > 0 ? 1.0 / sizes[m] : 0.0;
+        for (c = 0; c < d; c++) { MAT_AT(centroids, m, c) *= scale; }
+    }
+}
+/*
+ * ========================================KMEANS_LABELS===========================================
+ * k-means as kmeans.find_kmeans_labels() runs it: the first k points are the initial centroids,
+ * and it stops after max_iter updates or once no centroid moved by eps or more (keeping the
+ * centroids before that update). the assignment step is the O(N*k*d) part, it runs over blocks
+ * of points in parallel, the O(N*d) update stays sequential so the sums match kmeans.py
+ * returns the N x 1 labels, NULL if k is not in [1, N] or on failure, caller is the handler
+*/
+matrix* kmeans_labels(const matrix *data_points, int k, int max_iter, double eps) {
+    const int N = data_points->rows, d = data_points->cols;
+    matrix *centroids = NULL, *next = NULL, *swap, *labels = NULL;
+    double *columns = NULL;
+    int *assigned = NULL, *sizes = NULL;
+    size_t padded;
+    int i, m, iter, moved = 1;
+
+    if (k < 1 || k > N) { return NULL; }
+    PROFILE_BEGIN("kmeans");
+    columns = padded_columns(data_points, &padded);
+    centroids = matrix_alloc(k, d);
+    next = matrix_alloc(k, d);
+    assigned = (int *)malloc((size_t)N * sizeof(int));
+    sizes = (int *)malloc((size_t)k * sizeof(int));
+    labels = matrix_alloc(N, 1);
+    if (columns == NULL || centroids == NULL || next == NULL || assigned == NULL || sizes == NULL || labels == NULL) {
+        free(columns); free_matrix(centroids); free_matrix(next); free(assigned); free(sizes); free_matrix(labels);
+        PROFILE_END(0);
+        return NULL;
+    }
+    for (m = 0; m < k; m++) {
+        for (i = 0; i < d; i++) { MAT_AT(centroids, m, i) = MAT_AT(data_points, m, i); }
+    }
+    for (iter = 0; iter < max_iter && moved; iter++) {
+        assign_points(columns, padded, N, d, centroids, assigned);
+        update_centroids(data_points, assigned, next, sizes);
+        for (moved = 0, m = 0; m < k && !moved; m++) {
+            moved = sqrt(squared_euclidean_distance(MAT_ROW(centroids, m), MAT_ROW(next, m), d)) >= eps;
+        }
+        if (moved) { swap = centroids; centroids = next; next = swap; }
+    }
+    if (moved) { assign_points(columns, padded, N, d, centroids, assigned); } /* labels of the last update */
+    for (i = 0; i < N; i++) { MAT_AT(labels, i, 0) = assigned[i]; }
+    PROFILE_END((iter + moved) * 3.0 * N * k * d);
+    free(columns); free_matrix(centroids); free_matrix(next); free(assigned); free(sizes);
+    return labels;
+}
+/*
+ * ========================================SILHOUETTE_ROW==========================================
+ * s_i = (b - a) / max(a, b) from the distance sums of point i to every cluster: a is the mean
+ * distance to the rest of its own cluster, b the smallest mean distance to another non empty one.
+ * s_i is 0 for a point alone in its cluster, and where sklearn would get 0/0
+*/
+static double silhouette_row(const double *sums, const int *sizes, int clusters, int own) {
+    double a, b = HUGE_VAL, mean;
+    int m;
+    if (sizes[own] == 1) { return 0.0; }
+    a = sums[own] / (sizes[own] - 1);
+    for (m = 0; m < clusters; m++) {
+        if (m == own || sizes[m] == 0) { continue; }
+        mean = sums[m] / sizes[m];
+        if (mean < b) { b = mean; }
+    }
+    if (a == b) { return 0.0; } /* also a = b = 0, duplicated points */
+    return (b - a) / (a > b ? a : b);
+}
+/*
+ * ========================================SILHOUETTE_SCORE========================================
+ * the mean silhouette coefficient of the labeling over all points, euclidean distances
+ * the O(N^2 * d) distances are never stored: SILHOUETTE_ROWS points at a time are measured
+ * against blocks of CLUSTER_BLOCK points, each distance is added to the sum of the cluster of the
+ * far point, and a point's coefficient is taken once its sums are complete. row blocks are split
+ * between the threads and every sum runs in point order, so the score does not depend on them
+ * returns 1 on success, 0 on failure, -1 if the labels are not integers in [0, N) or there are
+ * not between 2 and N - 1 distinct clusters (sklearn raises there too)
+*/
+int silhouette_score(const matrix *data_points, const matrix *labels, double *score) {
+    const int N = data_points->rows, d = data_points->cols;
+    double *columns, *coefficients, *sums, dist[CLUSTER_BLOCK];
+    int *cluster, *sizes;
+    size_t padded;
+    int clusters = 0, distinct = 0, failed = 0, i, i0, j, j0, r, rows, count;
+
+    if (labels->rows != N || labels->cols != 1) { return -1; }
+    for (i = 0; i < N; i++) {
+        if (!(MAT_AT(labels, i, 0) >= 0 && MAT_AT(labels, i, 0) < N) || MAT_AT(labels, i, 0) != floor(MAT_AT(labels, i, 0))) { return -1; }
+        if ((int)MAT_AT(labels, i, 0) >= clusters) { clusters = (int)MAT_AT(labels, i, 0) + 1; }
+    }
+    PROFILE_BEGIN("silhouette");
+    columns = padded_columns(data_points, &padded);
+    coefficients = (double *)malloc((size_t)N * sizeof(double));
+    cluster = (int *)malloc((size_t)N * sizeof(int));
+    sizes = (int *)calloc((size_t)clusters, sizeof(int));
+    if (columns == NULL || coefficients == NULL || cluster == NULL || sizes == NULL) {
+        free(columns); free(coefficients); free(cluster); free(sizes);
+        PROFILE_END(0);
+        return 0;
+    }
+    for (i = 0; i < N; i++) {
+        cluster[i] = (int)MAT_AT(labels, i, 0);
+        distinct += sizes[cluster[i]]++ == 0;
+    }
+    if (distinct < 2 || distinct > N - 1) {
+        free(columns); free(coefficients); free(cluster); free(sizes);
+        PROFILE_END(0);
+        return -1;
+    }
+#ifdef _OPENMP
+#pragma omp parallel private(sums, dist, i0, j, j0, r, rows, count)
+#endif
+    {
+        sums = (double *)malloc((size_t)SILHOUETTE_ROWS * (size_t)clusters * sizeof(double)); /* per thread */
+        if (sums == NULL) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+            failed = 1;
+        }
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (i0 = 0; i0 < N; i0 += SILHOUETTE_ROWS) {
+            if (sums == NULL) { continue; }
+            rows = N - i0 < SILHOUETTE_ROWS ? N - i0 : SILHOUETTE_ROWS;
+            for (j = 0; j < rows * clusters; j++) { sums[j] = 0.0; }
+            for (j0 = 0; j0 < N; j0 += CLUSTER_BLOCK) {
+                count = N - j0 < CLUSTER_BLOCK ? N - j0 : CLUSTER_BLOCK;
+                for (r = 0; r < rows; r++) {
+                    block_distances(columns, padded, d, j0, MAT_ROW(data_points, i0 + r), dist);
+                    for (j = 0; j < count; j++) { sums[r * clusters + cluster[j0 + j]] += sqrt(dist[j]); }
+                }
+            }
+            for (r = 0; r < rows; r++) { coefficients[i0 + r] = silhouette_row(sums + r * clusters, sizes, clusters, cluster[i0 + r]); }
+        }
+        free(sums);
+    }
+    if (!failed) {
+        *score = 0.0;
+        for (i = 0; i < N; i++) { *score += coefficients[i]; }
+        *score /= N;
+    }
+    PROFILE_END((double)N * N * (3.0 * d + 2));
+    free(columns); free(coefficients); free(cluster); free(sizes);
+    return !failed;
+}
@@ -0,0 +1,12 @@
+/*
+ * the clustering side of analysis.py: k-means with the initialization, update and stopping rule
+ * of kmeans.py, and the mean silhouette coefficient of a labeling (sklearn's silhouette_score
+ * with the euclidean metric). labels are N x 1 matrices of cluster indices, like argmax_labels()
+ */
+#define KMEANS_DEFAULT_ITER 300  /* the defaults of kmeans.find_kmeans_labels */
+#define KMEANS_DEFAULT_EPS 1e-4
+#define CLUSTER_BLOCK 64         /* points per distance block, a fixed length the compiler vectorizes */
+#define SILHOUETTE_ROWS 8        /* rows sharing one block of points while it is in L1 */
+
+matrix* kmeans_labels(const matrix *data_points, int k, int max_iter, double eps);
+int silhouette_score(const matrix *data_points, const matrix *labels, double *score);
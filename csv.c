@@ -0,0 +1,302 @@
+#define _POSIX_C_SOURCE 200112L /* open, fstat, mmap */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include "symnmf.h"
+#include "csv.h"
+#if defined(__unix__) || defined(__APPLE__)
+#define CSV_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define CSV_MIN_CHUNK (1 << 20) /* bytes per thread below which splitting the parse does not pay off */
+#define CSV_FAST_DIGITS 15      /* any 15 digit integer is exact in a double */
+#define CSV_TOKEN_BUFFER 64
+
+static const double exact_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int is_delimiter(char c) {
+    return c == ',' || c == '\n' || c == '\r' || c == ' ' || c == '\t';
+}
+static int is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+static void csv_fail(csv_error *error, size_t line, size_t column, int errnum, const char *message) {
+    error->line = line;
+    error->column = column;
+    error->errnum = errnum;
+    error->message = message;
+}
+/*
+ * ========================================CSV_PARSE_DOUBLE========================================
+ * parses the number that starts at p and runs up to the next delimiter (or end)
+ * decimals with at most 15 significant digits and a power of ten up to 1e22 are converted with
+ * one exact multiply or divide, which is correctly rounded (Clinger's fast path) and so gives the
+ * same bits as strtod. anything else (longer mantissas, big exponents, nan, inf, hex) goes to strtod
+ * returns the number of characters consumed, 0 if the token is not a number
+*/
+size_t csv_parse_double(const char *p, const char *end, double *value) {
+    const char *q = p, *token_end = p;
+    char small[CSV_TOKEN_BUFFER], *buffer, *parsed_end;
+    double mantissa = 0.0, result;
+    int negative = 0, digits = 0, significant = 0, fast = 1, exponent = 0, exp_value = 0, exp_negative = 0, d;
+    size_t len;
+
+    while (token_end < end && !is_delimiter(*token_end)) { token_end++; }
+    len = (size_t)(token_end - p);
+    if (len == 0) { return 0; }
+    if (*q == '-' || *q == '+') { negative = *q == '-'; q++; }
+    for (; q < token_end && *q >= '0' && *q <= '9'; q++, digits++) {
+        d = *q - '0';
+        if ((significant > 0 || d != 0) && ++significant > CSV_FAST_DIGITS) { fast = 0; }
+        mantissa = mantissa * 10.0 + d;
+    }
+    if (q < token_end && *q == '.') {
+        for (q++; q < token_end && *q >= '0' && *q <= '9'; q++, digits++) {
+            d = *q - '0';
+            if ((significant > 0 || d != 0) && ++significant > CSV_FAST_DIGITS) { fast = 0; }
+            mantissa = mantissa * 10.0 + d;
+            exponent--;
+        }
+    }
+    if (digits > 0 && q < token_end && (*q == 'e' || *q == 'E')) {
+        q++;
+        if (q < token_end && (*q == '-' || *q == '+')) { exp_negative = *q == '-'; q++; }
+        if (q == token_end || *q < '0' || *q > '9') { fast = 0; }
+        for (; q < token_end && *q >= '0' && *q <= '9'; q++) {
+            if (exp_value < 10000) { exp_value = exp_value * 10 + (*q - '0'); }
+        }
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+    if (fast && digits > 0 && q == token_end) {
+        if (mantissa == 0.0) { exponent = 0; }
+        if (exponent >= -22 && exponent <= 22) {
+            result = exponent >= 0 ? mantissa * exact_pow10[exponent] : mantissa / exact_pow10[-exponent];
+            *value = negative ? -result : result;
+            return len;
+        }
+    }
+    /* slow path, strtod needs a terminated copy of the token */
+    buffer = len < CSV_TOKEN_BUFFER ? small : (char *)malloc(len + 1);
+    if (buffer == NULL) { return 0; }
+    memcpy(buffer, p, len);
+    buffer[len] = '\0';
+    result = strtod(buffer, &parsed_end);
+    if (parsed_end != buffer + len) { len = 0; }
+    if (buffer != small) { free(buffer); }
+    if (len > 0) { *value = result; }
+    return len;
+}
+/*
+ * ========================================PARSE_CHUNK=============================================
+ * one slice of the file, starting at a line start and ending after a newline (or at the end)
+ * values are appended row by row to a growable buffer, lines and errors are counted locally and
+ * made absolute once every slice is parsed
+*/
+typedef struct {
+    const char *begin, *end;
+    double *values;
+    size_t count, capacity;
+    size_t rows;
+    size_t lines;      /* newlines consumed */
+    int dim;           /* values per row, 0 before the first row */
+    size_t dim_line;   /* local line of the first row */
+    size_t error_line; /* local line of the error */
+    size_t error_column;
+    const char *error_message;
+} csv_chunk;
+
+static int chunk_push(csv_chunk *c, double value) {
+    double *grown;
+    size_t capacity;
+    if (c->count == c->capacity) {
+        capacity = c->capacity < 1024 ? 1024 : 2 * c->capacity;
+        grown = (double *)realloc(c->values, capacity * sizeof(double));
+        if (grown == NULL) { return 0; }
+        c->values = grown;
+        c->capacity = capacity;
+    }
+    c->values[c->count++] = value;
+    return 1;
+}
+static void chunk_fail(csv_chunk *c, const char *line_start, const char *p, const char *message) {
+    c->error_line = c->lines;
+    c->error_column = line_start == NULL ? 0 : (size_t)(p - line_start) + 1;
+    c->error_message = message;
+}
+static void parse_chunk(csv_chunk *c) {
+    const char *p = c->begin, *line_start;
+    double value;
+    size_t used;
+    int fields;
+
+    while (p < c->end) {
+        line_start = p;
+        while (p < c->end && is_blank(*p)) { p++; }
+        if (p < c->end && *p != '\n') { /* blank lines are skipped */
+            for (fields = 0;; p++) {
+                while (p < c->end && (*p == ' ' || *p == '\t')) { p++; }
+                used = csv_parse_double(p, c->end, &value);
+                if (used == 0) { chunk_fail(c, line_start, p, "expected a number"); return; }
+                if (!chunk_push(c, value)) { chunk_fail(c, NULL, p, "out of memory"); return; }
+                fields++;
+                p += used;
+                while (p < c->end && is_blank(*p)) { p++; }
+                if (p == c->end || *p == '\n') { break; }
+                if (*p != ',') { chunk_fail(c, line_start, p, "expected ',' or end of line"); return; }
+            }
+            if (c->dim == 0) {
+                c->dim = fields;
+                c->dim_line = c->lines;
+            }
+            else if (fields != c->dim) { chunk_fail(c, line_start, line_start, "wrong number of values on the line"); return; }
+            c->rows++;
+        }
+        if (p < c->end) { p++; c->lines++; } /* the newline */
+    }
+}
+/*
+ * ========================================CSV_PARSE===============================================
+ * parses len bytes of comma separated points (not necessarily terminated) in a single pass
+ * large inputs are split at line boundaries into one slice per thread, the slices are parsed in
+ * parallel and copied in order into the N x d matrix
+ * returns NULL with the position of the first malformed line in error, the caller is the handler
+*/
+matrix* csv_parse(const char *text, size_t len, csv_error *error) {
+    const char *end = text + len, *start, *newline;
+    csv_error ignored;
+    csv_chunk *chunks;
+    matrix *points = NULL;
+    size_t rows = 0, line_base = 0, r, row;
+    int chunk_count = symnmf_max_threads(), dim = 0, t;
+
+    if (error == NULL) { error = &ignored; }
+    if ((size_t)chunk_count > len / CSV_MIN_CHUNK + 1) { chunk_count = (int)(len / CSV_MIN_CHUNK + 1); }
+    chunks = (csv_chunk *)calloc((size_t)chunk_count, sizeof(csv_chunk));
+    if (chunks == NULL) { csv_fail(error, 0, 0, ENOMEM, "out of memory"); return NULL; }
+    chunks[0].begin = text;
+    for (t = 1; t < chunk_count; t++) { /* each slice starts right after a newline */
+        start = text + len / (size_t)chunk_count * (size_t)t;
+        if (start < chunks[t - 1].begin) { start = chunks[t - 1].begin; }
+        if (start > text && start[-1] != '\n') {
+            newline = (const char *)memchr(start, '\n', (size_t)(end - start));
+            start = newline == NULL ? end : newline + 1;
+        }
+        chunks[t - 1].end = start;
+        chunks[t].begin = start;
+    }
+    chunks[chunk_count - 1].end = end;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) if (chunk_count > 1)
+#endif
+    for (t = 0; t < chunk_count; t++) { parse_chunk(&chunks[t]); }
+
+    /* the first error in file order wins, earlier slices are complete so their line counts hold */
+    for (t = 0; t < chunk_count; t++) {
+        if (chunks[t].error_message != NULL) {
+            if (chunks[t].error_column == 0) { csv_fail(error, 0, 0, ENOMEM, chunks[t].error_message); }
+            else { csv_fail(error, line_base + chunks[t].error_line + 1, chunks[t].error_column, 0, chunks[t].error_message); }
+            goto cleanup;
+        }
+        if (chunks[t].rows > 0) {
+            if (dim == 0) { dim = chunks[t].dim; }
+            else if (chunks[t].dim != dim) {
+                csv_fail(error, line_base + chunks[t].dim_line + 1, 1, 0, "wrong number of values on the line");
+                goto cleanup;
+            }
+        }
+        rows += chunks[t].rows;
+        line_base += chunks[t].lines;
+    }
+    if (rows == 0) { csv_fail(error, 0, 0, 0, "no data points"); goto cleanup; }
+    if (rows > INT_MAX) { csv_fail(error, 0, 0, 0, "too many data points"); goto cleanup; }
+    points = matrix_alloc((int)rows, dim);
+    if (points == NULL) { csv_fail(error, 0, 0, ENOMEM, "out of memory"); goto cleanup; }
+    for (row = 0, t = 0; t < chunk_count; t++) {
+        for (r = 0; r < chunks[t].rows; r++, row++) {
+            memcpy(MAT_ROW(points, row), chunks[t].values + r * (size_t)dim, (size_t)dim * sizeof(double));
+        }
+    }
+cleanup:
+    for (t = 0; t < chunk_count; t++) { free(chunks[t].values); }
+    free(chunks);
+    return points;
+}
+/*
+ * ========================================LOAD_STDIO==============================================
+ * reads the whole file into memory, used where mmap is unavailable or the file is not regular
+*/
+static matrix* load_stdio(const char *file_name, csv_error *error) {
+    FILE *file;
+    char *text = NULL, *grown;
+    size_t len = 0, capacity = 0, got;
+    matrix *points;
+
+    file = fopen(file_name, "rb");
+    if (file == NULL) { csv_fail(error, 0, 0, errno, "cannot open file"); return NULL; }
+    do {
+        if (len == capacity) {
+            capacity = capacity < 65536 ? 65536 : 2 * capacity;
+            grown = (char *)realloc(text, capacity);
+            if (grown == NULL) {
+                free(text); fclose(file);
+                csv_fail(error, 0, 0, ENOMEM, "out of memory");
+                return NULL;
+            }
+            text = grown;
+        }
+        got = fread(text + len, 1, capacity - len, file);
+        len += got;
+    } while (got > 0);
+    if (ferror(file)) {
+        free(text); fclose(file);
+        csv_fail(error, 0, 0, EIO, "cannot read file");
+        return NULL;
+    }
+    fclose(file);
+    points = csv_parse(text, len, error);
+    free(text);
+    return points;
+}
+/*
+ * ========================================CSV_LOAD================================================
+ * loads a points file, one point per line with comma separated coordinates
+ * the file is memory mapped and parsed in place when possible
+ * returns NULL with the reason (and position for malformed input) in error, the caller is the handler
+*/
+matrix* csv_load(const char *file_name, csv_error *error) {
+    csv_error ignored;
+#ifdef CSV_MMAP
+    struct stat st;
+    const char *text;
+    matrix *points;
+    int fd;
+#endif
+
+    if (error == NULL) { error = &ignored; }
+#ifdef CSV_MMAP
+    fd = open(file_name, O_RDONLY);
+    if (fd < 0) { csv_fail(error, 0, 0, errno, "cannot open file"); return NULL; }
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && (off_t)(size_t)st.st_size == st.st_size) {
+        text = (const char *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (text != (const char *)MAP_FAILED) {
+            close(fd);
+            posix_madvise((void *)text, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+            points = csv_parse(text, (size_t)st.st_size, error);
+            munmap((void *)text, (size_t)st.st_size);
+            return points;
+        }
+    }
+    close(fd);
+#endif
+    return load_stdio(file_name, error);
+}
@@ -0,0 +1,15 @@
+/*
+ * where and why loading a points file failed. line and column are 1 based and 0 when the
+ * failure has no position (the file could not be opened or memory ran out), errnum then holds
+ * the errno of the failed system call or 0
+ */
+typedef struct {
+    size_t line;
+    size_t column;
+    int errnum;
+    const char *message;
+} csv_error;
+
+matrix* csv_load(const char *file_name, csv_error *error);
+matrix* csv_parse(const char *text, size_t len, csv_error *error);
+size_t csv_parse_double(const char *p, const char *end, double *value);
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "symnmf.h"
+#include "gemm.h"
+#include "distributed.h"
+#include "profile.h"
+
+/*
+ * ========================================FILL_OWN_ROWS===========================================
+ * the own rows of A with formula 1.1 (0 on the diagonal) and their row sums, the own degrees
+*/
+static void fill_own_rows(const matrix *data_points, int first, matrix *rows, double *degrees) {
+    const int N = data_points->rows, d = data_points->cols;
+    const double *point;
+    double *row, sum;
+    int i, j;
+
+#ifdef _OPENMP
+#pragma omp parallel for private(j, point, row, sum) schedule(static)
+#endif
+    for (i = 0; i < rows->rows; i++) {
+        point = MAT_ROW(data_points, first + i);
+        row = MAT_ROW(rows, i);
+        sum = 0.0;
+        for (j = 0; j < N; j++) {
+            row[j] = j == first + i ? 0.0 : exp(-squared_euclidean_distance(point, MAT_ROW(data_points, j), d) / 2.0);
+            sum += row[j];
+        }
+        degrees[first + i] = sum;
+    }
+}
+/*
+ * ========================================DISTRIBUTED_CREATE======================================
+ * the own rows of W = D^-1/2 * A * D^-1/2 from every point (each process holds all the points,
+ * only O(N*d)), after gathering the degrees of the other blocks. a collective, every process of
+ * t calls it with the same points
+ * returns NULL on failure, caller is the handler
+*/
+distributed_w* distributed_create(const matrix *data_points, transport *t) {
+    const int N = data_points->rows;
+    distributed_w *W;
+    double *degrees = NULL, sum = 0.0, row_sum;
+    int r, i, j, first, ok;
+
+    if (N < t->size) { return NULL; } /* every process owns at least a row */
+    PROFILE_BEGIN("similarity");
+    W = (distributed_w *)calloc(1, sizeof(distributed_w));
+    if (W != NULL) { W->starts = (int *)malloc((size_t)(t->size + 1) * sizeof(int)); }
+    degrees = (double *)malloc((size_t)N * sizeof(double));
+    if (W == NULL || W->starts == NULL || degrees == NULL) {
+        free_distributed(W); free(degrees);
+        PROFILE_END(0);
+        return NULL;
+    }
+    for (r = 0; r <= t->size; r++) { W->starts[r] = (int)((double)N * r / t->size); }
+    W->t = t;
+    W->N = N;
+    first = W->starts[t->rank];
+    W->rows = matrix_alloc(W->starts[t->rank + 1] - first, N);
+    if (W->rows == NULL) {
+        free_distributed(W); free(degrees);
+        PROFILE_END(0);
+        return NULL;
+    }
+    PROFILE_ALLOC((double)N * sizeof(double));
+    fill_own_rows(data_points, first, W->rows, degrees);
+    PROFILE_END((double)W->rows->rows * N * PROFILE_KERNEL_FLOPS(data_points->cols));
+    PROFILE_BEGIN("normalize");
+    ok = t->allgather(t, degrees, W->starts, 1);
+    if (ok) {
+        for (i = 0; i < N; i++) { degrees[i] = degrees[i] > 0 ? 1.0 / sqrt(degrees[i]) : 0.0; } /* avoid division by zero */
+        for (i = 0; i < W->rows->rows; i++) {
+            for (row_sum = 0.0, j = 0; j < N; j++) {
+                MAT_AT(W->rows, i, j) *= degrees[first + i] * degrees[j];
+                row_sum += MAT_AT(W->rows, i, j);
+            }
+            sum += row_sum;
+        }
+        ok = t->allreduce_sum(t, &sum, 1);
+    }
+    PROFILE_END(3.0 * W->rows->rows * N);
+    free(degrees);
+    if (!ok) {
+        free_distributed(W);
+        return NULL;
+    }
+    W->mean = sum / ((double)N * N);
+    return W;
+}
+/*
+ * ========================================FREE_DISTRIBUTED========================================
+ * frees the rows, the transport stays with the caller
+*/
+void free_distributed(distributed_w *W) {
+    if (W == NULL) { return; }
+    free(W->starts);
+    free_matrix(W->rows);
+    free(W);
+}
+/*
+ * ========================================W_OPERATOR_DISTRIBUTED==================================
+ * exposes the own rows of W to optimize_h_rows(), the operator takes and returns the own rows of
+ * H and W*H. the workspace is the packed B of gemm_tall_skinny() followed by the whole H, which
+ * every product gathers. a failed gather leaves out undefined, the next collective of
+ * optimize_h_rows() fails as well and ends the run
+*/
+static matrix* distributed_workspace_alloc(const w_operator *op, int k) {
+    const distributed_w *W = (const distributed_w *)op->data;
+    const int panels = (k + GEMM_NR - 1) / GEMM_NR;
+    return matrix_alloc(2 * panels * W->N, GEMM_NR);
+}
+static void distributed_multiply(const w_operator *op, const matrix *H, matrix *out, matrix *workspace) {
+    const distributed_w *W = (const distributed_w *)op->data;
+    const int k = H->cols, panels = (k + GEMM_NR - 1) / GEMM_NR, first = W->starts[W->t->rank];
+    matrix packed_B, all_H;
+    int i, c;
+
+    packed_B = *workspace;
+    packed_B.rows = panels * W->N;
+    all_H.rows = W->N;
+    all_H.cols = k;
+    all_H.stride = panels * GEMM_NR;
+    all_H.data = MAT_ROW(workspace, packed_B.rows);
+    for (i = 0; i < H->rows; i++) {
+        for (c = 0; c < k; c++) { MAT_AT(&all_H, first + i, c) = MAT_AT(H, i, c); }
+    }
+    if (!W->t->allgather(W->t, all_H.data, W->starts, all_H.stride)) { return; }
+    gemm_tall_skinny(W->rows, &all_H, out, &packed_B);
+}
+static double distributed_squared_norm(const w_operator *op) {
+    const distributed_w *W = (const distributed_w *)op->data;
+    double sum = 0.0;
+    int i, j;
+    for (i = 0; i < W->rows->rows; i++) {
+        for (j = 0; j < W->N; j++) { sum += MAT_AT(W->rows, i, j) * MAT_AT(W->rows, i, j); }
+    }
+    return W->t->allreduce_sum(W->t, &sum, 1) ? sum : -1.0;
+}
+void w_operator_distributed(w_operator *op, const distributed_w *W) {
+    op->N = W->rows->rows;
+    op->entries = (double)W->rows->rows * W->N;
+    op->data = W;
+    op->workspace_alloc = distributed_workspace_alloc;
+    op->multiply = distributed_multiply;
+    op->squared_norm = distributed_squared_norm;
+}
+/*
+ * ========================================DISTRIBUTED_OWN_ROWS====================================
+ * the own rows of an N x k H as a view into it, no copy
+*/
+matrix distributed_own_rows(const distributed_w *W, const matrix *H) {
+    matrix own = *H;
+    own.rows = W->starts[W->t->rank + 1] - W->starts[W->t->rank];
+    own.data = MAT_ROW(H, W->starts[W->t->rank]);
+    return own;
+}
+/*
+ * ========================================DISTRIBUTED_GATHER======================================
+ * the whole N x k H on every process from the own rows each one holds, a collective
+ * returns NULL on failure, caller is the handler
+*/
+matrix* distributed_gather(const distributed_w *W, const matrix *H) {
+    const int first = W->starts[W->t->rank];
+    matrix *all;
+    int i, c;
+
+    all = matrix_alloc(W->N, H->cols);
+    if (all == NULL) { return NULL; }
+    for (i = 0; i < H->rows; i++) {
+        for (c = 0; c < H->cols; c++) { MAT_AT(all, first + i, c) = MAT_AT(H, i, c); }
+    }
+    if (!W->t->allgather(W->t, all->data, W->starts, all->stride)) {
+        free_matrix(all);
+        return NULL;
+    }
+    return all;
+}
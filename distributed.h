@@ -0,0 +1,20 @@
+/*
+ * one block of rows of W for a run split over the processes of a transport: process r owns the
+ * rows [starts[r], starts[r + 1]) of W and of H. each process evaluates only its rows of A, the
+ * degrees are gathered, so no process ever holds all of W. a product gathers H first (N*k doubles
+ * per process) and costs (N / size) * N * k per process, every other step of optimize_h_rows()
+ * works on the own rows with a k x k or scalar sum over the processes
+ */
+typedef struct {
+    transport *t;
+    int N;
+    int *starts;  /* t->size + 1 row offsets, balanced */
+    matrix *rows; /* the own rows of W, starts[t->rank + 1] - starts[t->rank] x N */
+    double mean;  /* mean entry of the whole W, for the initial H */
+} distributed_w;
+
+distributed_w* distributed_create(const matrix *data_points, transport *t);
+void free_distributed(distributed_w *W);
+void w_operator_distributed(w_operator *op, const distributed_w *W);
+matrix distributed_own_rows(const distributed_w *W, const matrix *H);
+matrix* distributed_gather(const distributed_w *W, const matrix *H);
@@ -0,0 +1,211 @@
+#include <stdlib.h>
+#include <string.h>
+#include "symnmf.h"
+#include "gemm.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEMM_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * ========================================GEMM_PACK_ALLOC=========================================
+ * allocates the workspace that holds B packed into column panels of width GEMM_NR
+ * panel q occupies rows q*K .. q*K+K-1, columns past n are zero padding
+ * the caller allocates it once and passes it to every gemm_tall_skinny() call
+*/
+matrix* gemm_pack_alloc(int K, int n) {
+    const int panels = (n + GEMM_NR - 1) / GEMM_NR;
+    return matrix_alloc(panels * K, GEMM_NR);
+}
+/*
+ * ========================================GEMM_PACK_B=============================================
+ * copy B into the panel layout, every K row of a panel is GEMM_NR contiguous doubles
+ * inside a parallel region it must be reached by every thread of the team, the rows are shared among them
+*/
+void gemm_pack_b(const matrix *B, matrix *packed_B) {
+    const int K = B->rows, n = B->cols;
+    int p, q, j, width;
+    const double *src;
+    double *dst;
+
+    for (q = 0; q * GEMM_NR < n; q++) {
+        width = n - q * GEMM_NR < GEMM_NR ? n - q * GEMM_NR : GEMM_NR;
+#ifdef _OPENMP
+#pragma omp for private(src, dst, j) schedule(static)
+#endif
+        for (p = 0; p < K; p++) {
+            src = MAT_ROW(B, p) + q * GEMM_NR;
+            dst = MAT_ROW(packed_B, q * K + p);
+            for (j = 0; j < width; j++) { dst[j] = src[j]; }
+            for (; j < GEMM_NR; j++) { dst[j] = 0.0; } /* zero padding keeps the kernels branch free */
+        }
+    }
+}
+/*
+ * ========================================KERNEL_SCALAR===========================================
+ * portable micro-kernel, tile = A[0..mr) x packed panel over kc steps, any mr <= GEMM_MR_MAX
+ * also used for the row remainder of the vector paths
+*/
+static void kernel_scalar(int mr, int kc, const double *a, size_t lda, const double *b, double *tile) {
+    int r, p, j;
+    const double *a_row;
+    double a_val;
+    double *t_row;
+
+    for (r = 0; r < mr; r++) {
+        a_row = a + (size_t)r * lda;
+        t_row = tile + r * GEMM_NR;
+        for (j = 0; j < GEMM_NR; j++) { t_row[j] = 0.0; }
+        for (p = 0; p < kc; p++) {
+            a_val = a_row[p];
+            for (j = 0; j < GEMM_NR; j++) { t_row[j] += a_val * b[p * GEMM_NR + j]; }
+        }
+    }
+}
+#ifdef GEMM_X86
+/*
+ * ========================================KERNEL_AVX2=============================================
+ * 4 x 8 register tile, each row of the tile is held in two ymm accumulators
+*/
+__attribute__((target("avx2,fma")))
+static void kernel_avx2(int kc, const double *a, size_t lda, const double *b, double *tile) {
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d b0, b1, a_val;
+    const double *a0 = a, *a1 = a + lda, *a2 = a + 2 * lda, *a3 = a + 3 * lda;
+    int p;
+
+    for (p = 0; p < kc; p++) {
+        b0 = _mm256_loadu_pd(b + p * GEMM_NR);
+        b1 = _mm256_loadu_pd(b + p * GEMM_NR + 4);
+        a_val = _mm256_broadcast_sd(a0 + p); c00 = _mm256_fmadd_pd(a_val, b0, c00); c01 = _mm256_fmadd_pd(a_val, b1, c01);
+        a_val = _mm256_broadcast_sd(a1 + p); c10 = _mm256_fmadd_pd(a_val, b0, c10); c11 = _mm256_fmadd_pd(a_val, b1, c11);
+        a_val = _mm256_broadcast_sd(a2 + p); c20 = _mm256_fmadd_pd(a_val, b0, c20); c21 = _mm256_fmadd_pd(a_val, b1, c21);
+        a_val = _mm256_broadcast_sd(a3 + p); c30 = _mm256_fmadd_pd(a_val, b0, c30); c31 = _mm256_fmadd_pd(a_val, b1, c31);
+    }
+    _mm256_storeu_pd(tile, c00); _mm256_storeu_pd(tile + 4, c01);
+    _mm256_storeu_pd(tile + 8, c10); _mm256_storeu_pd(tile + 12, c11);
+    _mm256_storeu_pd(tile + 16, c20); _mm256_storeu_pd(tile + 20, c21);
+    _mm256_storeu_pd(tile + 24, c30); _mm256_storeu_pd(tile + 28, c31);
+}
+/*
+ * ========================================KERNEL_AVX512===========================================
+ * 8 x 8 register tile, one zmm accumulator per row of the tile
+*/
+__attribute__((target("avx512f")))
+static void kernel_avx512(int kc, const double *a, size_t lda, const double *b, double *tile) {
+    __m512d c0 = _mm512_setzero_pd(), c1 = _mm512_setzero_pd(), c2 = _mm512_setzero_pd(), c3 = _mm512_setzero_pd();
+    __m512d c4 = _mm512_setzero_pd(), c5 = _mm512_setzero_pd(), c6 = _mm512_setzero_pd(), c7 = _mm512_setzero_pd();
+    __m512d b_val;
+    int p;
+
+    for (p = 0; p < kc; p++) {
+        b_val = _mm512_loadu_pd(b + p * GEMM_NR);
+        c0 = _mm512_fmadd_pd(_mm512_set1_pd(a[p]), b_val, c0);
+        c1 = _mm512_fmadd_pd(_mm512_set1_pd(a[lda + p]), b_val, c1);
+        c2 = _mm512_fmadd_pd(_mm512_set1_pd(a[2 * lda + p]), b_val, c2);
+        c3 = _mm512_fmadd_pd(_mm512_set1_pd(a[3 * lda + p]), b_val, c3);
+        c4 = _mm512_fmadd_pd(_mm512_set1_pd(a[4 * lda + p]), b_val, c4);
+        c5 = _mm512_fmadd_pd(_mm512_set1_pd(a[5 * lda + p]), b_val, c5);
+        c6 = _mm512_fmadd_pd(_mm512_set1_pd(a[6 * lda + p]), b_val, c6);
+        c7 = _mm512_fmadd_pd(_mm512_set1_pd(a[7 * lda + p]), b_val, c7);
+    }
+    _mm512_storeu_pd(tile, c0); _mm512_storeu_pd(tile + 8, c1);
+    _mm512_storeu_pd(tile + 16, c2); _mm512_storeu_pd(tile + 24, c3);
+    _mm512_storeu_pd(tile + 32, c4); _mm512_storeu_pd(tile + 40, c5);
+    _mm512_storeu_pd(tile + 48, c6); _mm512_storeu_pd(tile + 56, c7);
+}
+#endif
+/*
+ * ========================================GEMM_DETECT_ISA=========================================
+ * picks the micro-kernel for the running cpu, detected on the first call and cached
+ * the SYMNMF_GEMM environment variable (scalar, avx2, avx512) forces a path, one the cpu lacks
+ * falls back to the widest it has. it is read once, a later change has no effect
+*/
+static int detected_isa = 0; /* 0 until the first call, then a GEMM_ISA_ value */
+
+static int detect_isa(void) {
+    const char *forced = getenv("SYMNMF_GEMM");
+    int isa = GEMM_ISA_SCALAR;
+#ifdef GEMM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) { isa = GEMM_ISA_AVX2; }
+    if (__builtin_cpu_supports("avx512f")) { isa = GEMM_ISA_AVX512; }
+#endif
+    if (forced != NULL) {
+        if (strcmp(forced, "scalar") == 0) { isa = GEMM_ISA_SCALAR; }
+        else if (strcmp(forced, "avx2") == 0 && isa >= GEMM_ISA_AVX2) { isa = GEMM_ISA_AVX2; }
+        else if (strcmp(forced, "avx512") == 0 && isa >= GEMM_ISA_AVX512) { isa = GEMM_ISA_AVX512; }
+    }
+    return isa;
+}
+int gemm_detect_isa(void) {
+    int isa;
+#ifdef _OPENMP
+#pragma omp critical (gemm_detect_isa)
+#endif
+    {
+        if (detected_isa == 0) { detected_isa = detect_isa(); }
+        isa = detected_isa;
+    }
+    return isa;
+}
+/*
+ * ========================================GEMM_TALL_SKINNY========================================
+ * C = A*B where A is N x K and B is K x n with small n
+ * K is processed in GEMM_KC blocks, inside a block every MR rows of A are multiplied against
+ * each packed panel of B by the register tiled micro-kernel and accumulated into C
+ * with OpenMP the MR row blocks are split among threads, each C entry is still summed by one
+ * thread in a fixed order, so the result does not depend on the thread count
+ * packed_B must come from gemm_pack_alloc(K, n), C must not alias A or B
+*/
+void gemm_tall_skinny(const matrix *A, const matrix *B, matrix *C, matrix *packed_B) {
+    const int N = A->rows, K = A->cols, n = B->cols;
+    const size_t lda = (size_t)A->stride;
+    const int isa = gemm_detect_isa();
+    const int mr = isa == GEMM_ISA_AVX512 ? 8 : 4;
+    double tile[GEMM_MR_MAX * GEMM_NR];
+    int i, j, r, q, p0, kc, rows, width;
+    const double *a_block, *b_block;
+    double *c_row;
+
+#ifdef _OPENMP
+#pragma omp parallel private(tile, i, j, r, q, p0, kc, rows, width, a_block, b_block, c_row) if ((double)N * K * n > 1e6)
+#endif
+    {
+        gemm_pack_b(B, packed_B);
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (i = 0; i < N; i++) {
+            c_row = MAT_ROW(C, i);
+            for (j = 0; j < n; j++) { c_row[j] = 0.0; }
+        }
+        for (p0 = 0; p0 < K; p0 += GEMM_KC) {
+            kc = K - p0 < GEMM_KC ? K - p0 : GEMM_KC;
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+            for (i = 0; i < N; i += mr) {
+                rows = N - i < mr ? N - i : mr;
+                a_block = MAT_ROW(A, i) + p0;
+                for (q = 0; q * GEMM_NR < n; q++) {
+                    b_block = MAT_ROW(packed_B, q * K + p0);
+                    if (rows < mr || isa == GEMM_ISA_SCALAR) { kernel_scalar(rows, kc, a_block, lda, b_block, tile); }
+#ifdef GEMM_X86
+                    else if (isa == GEMM_ISA_AVX512) { kernel_avx512(kc, a_block, lda, b_block, tile); }
+                    else { kernel_avx2(kc, a_block, lda, b_block, tile); }
+#endif
+                    width = n - q * GEMM_NR < GEMM_NR ? n - q * GEMM_NR : GEMM_NR;
+                    for (r = 0; r < rows; r++) { /* accumulate the tile, padding columns are dropped */
+                        c_row = MAT_ROW(C, i + r) + q * GEMM_NR;
+                        for (j = 0; j < width; j++) { c_row[j] += tile[r * GEMM_NR + j]; }
+                    }
+                }
+            }
+        }
+    }
+}
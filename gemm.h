@@ -0,0 +1,17 @@
+/*
+ * blocked matrix product specialized for the tall-skinny shape of the W*H numerator:
+ * A is N x K (large), B is K x n with n small (k of symnmf), C = A*B is N x n
+ */
+#define GEMM_NR 8      /* width of a packed panel of B, one zmm or two ymm registers */
+#define GEMM_MR_MAX 8  /* tallest register tile used by any of the micro-kernels */
+#define GEMM_KC 256    /* depth of a K block, keeps the packed B block resident in L1 */
+
+/* instruction set paths, gemm_detect_isa() picks the widest one the running cpu supports */
+#define GEMM_ISA_SCALAR 1
+#define GEMM_ISA_AVX2 2
+#define GEMM_ISA_AVX512 3
+
+matrix* gemm_pack_alloc(int K, int n);
+void gemm_pack_b(const matrix *B, matrix *packed_B);
+void gemm_tall_skinny(const matrix *A, const matrix *B, matrix *C, matrix *packed_B);
+int gemm_detect_isa(void);
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "symnmf.h"
+#include "gemm.h"
+#include "rng.h"
+
+/*
+ * checks gemm_tall_skinny() against the naive mat_multiply() on shapes that are not multiples of
+ * the register tile, the panel width GEMM_NR or the K block GEMM_KC, so every remainder path
+ * runs. the micro-kernel is the one gemm_detect_isa() picks, run it once per SYMNMF_GEMM value
+ * (make test does) to cover each path the cpu has
+ */
+
+static const char *isa_names[] = {"", "scalar", "avx2", "avx512"};
+
+/*
+ * ========================================RANDOM_MATRIX===========================================
+ * rows x cols uniform [0, 1) entries, the matrix_alloc() padding is left alone
+*/
+static matrix* random_matrix(mt_state *state, int rows, int cols) {
+    matrix *m = matrix_alloc(rows, cols);
+    int i, j;
+    if (m == NULL) { return NULL; }
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) { MAT_AT(m, i, j) = mt_next_double(state); }
+    }
+    return m;
+}
+/*
+ * ========================================CHECK_SHAPE=============================================
+ * one N x K times K x n product, entries must agree within rounding of a K term sum
+ * returns 1 if they do, 0 otherwise (or if memory runs out)
+*/
+static int check_shape(mt_state *state, int N, int K, int n) {
+    matrix *A = random_matrix(state, N, K), *B = random_matrix(state, K, n);
+    matrix *C = matrix_alloc(N, n), *packed_B = gemm_pack_alloc(K, n), *expected = NULL;
+    double error = 0.0, difference;
+    int i, j, ok = 0;
+
+    if (A != NULL && B != NULL && C != NULL && packed_B != NULL) { expected = mat_multiply(A, B); }
+    if (expected != NULL) {
+        gemm_tall_skinny(A, B, C, packed_B);
+        for (i = 0; i < N; i++) {
+            for (j = 0; j < n; j++) {
+                difference = fabs(MAT_AT(C, i, j) - MAT_AT(expected, i, j)) / MAT_AT(expected, i, j);
+                if (difference > error || difference != difference) { error = difference; } /* NaN fails too */
+            }
+        }
+        ok = error <= 1e-13;
+        if (!ok) { printf("gemm_test: %d x %d times %d x %d off by %g\n", N, K, K, n, error); }
+    }
+    free_matrix(A); free_matrix(B); free_matrix(C); free_matrix(packed_B); free_matrix(expected);
+    return ok;
+}
+/*
+ * ================================================================================================
+ * ==============================================MAIN==============================================
+ * ================================================================================================
+*/
+int main(void) {
+    static const int Ns[] = {1, 3, 4, 7, 8, 9, 37, 130};
+    static const int Ks[] = {1, 5, GEMM_KC - 1, GEMM_KC, GEMM_KC + 1, 2 * GEMM_KC + 75};
+    static const int ns[] = {1, 3, GEMM_NR, GEMM_NR + 1, 2 * GEMM_NR + 3};
+    const char *forced = getenv("SYMNMF_GEMM");
+    mt_state state;
+    unsigned a, b, c;
+    int failed = 0, shapes = 0;
+
+    mt_seed(&state, 1234);
+    for (a = 0; a < sizeof(Ns) / sizeof(Ns[0]); a++) {
+        for (b = 0; b < sizeof(Ks) / sizeof(Ks[0]); b++) {
+            for (c = 0; c < sizeof(ns) / sizeof(ns[0]); c++) {
+                if (!check_shape(&state, Ns[a], Ks[b], ns[c])) { failed++; }
+                shapes++;
+            }
+        }
+    }
+    printf("gemm_test: %s path%s%s%s, %d of %d shapes match mat_multiply\n", isa_names[gemm_detect_isa()],
+        forced != NULL ? " (SYMNMF_GEMM=" : "", forced != NULL ? forced : "", forced != NULL ? ")" : "", shapes - failed, shapes);
+    return failed == 0 ? 0 : 1;
+}
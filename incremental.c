@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "symnmf.h"
+#include "packed.h"
+#include "incremental.h"
+#include "profile.h"
+
+/*
+ * ========================================INCREMENTAL_CREATE======================================
+ * the incremental W of the given points (copied), as calculate_norm_matrix() would build it
+ * returns NULL on failure, caller is the handler
+*/
+incremental_w* incremental_create(const matrix *data_points) {
+    incremental_w *W = (incremental_w *)calloc(1, sizeof(incremental_w));
+    if (W == NULL) { return NULL; }
+    if (!incremental_extend(W, data_points)) {
+        free(W);
+        return NULL;
+    }
+    return W;
+}
+/*
+ * ========================================FREE_INCREMENTAL========================================
+*/
+void free_incremental(incremental_w *W) {
+    if (W == NULL) { return; }
+    free_matrix(W->points);
+    free_packed(W->A);
+    free(W->degrees);
+    free(W->inv_sqrt_degrees);
+    free(W);
+}
+/*
+ * ========================================EXTEND_SIMILARITY=======================================
+ * fills the rows of the grown A: an old row i keeps its entries and gains the columns of the new
+ * points, a new row is evaluated in full with formula 1.1. only the M(N + M) new pairs cost an exp,
+ * the old entries are copied, which is what moving them into the larger triangle costs anyway
+*/
+static void extend_similarity(const packed_matrix *old_A, const matrix *points, packed_matrix *A) {
+    const int N = old_A != NULL ? old_A->n : 0, T = points->rows, d = points->cols;
+    double *row;
+    const double *point;
+    int i, j;
+
+#ifdef _OPENMP
+#pragma omp parallel for private(j, row, point) schedule(dynamic, 16)
+#endif
+    for (i = 0; i < T; i++) {
+        row = PACKED_ROW(A, i);
+        point = MAT_ROW(points, i);
+        if (i < N) {
+            memcpy(row, PACKED_ROW(old_A, i), (size_t)(N - i) * sizeof(double));
+            j = N;
+        }
+        else { row[0] = 0; j = i + 1; } /* same point */
+        for (; j < T; j++) {
+            row[j - i] = exp(-squared_euclidean_distance(point, MAT_ROW(points, j), d) / 2.0);
+        }
+    }
+}
+/*
+ * ========================================EXTEND_DEGREES==========================================
+ * the degrees of the grown A: an old point adds its entries towards the new points to its degree,
+ * a new point sums its whole row (the part left of the diagonal is read down the columns)
+*/
+static void extend_degrees(const double *old_degrees, int N, const packed_matrix *A, double *degrees, double *inv_sqrt_degrees) {
+    const int T = A->n;
+    const double *row;
+    double sum;
+    int i, j;
+
+#ifdef _OPENMP
+#pragma omp parallel for private(j, row, sum) schedule(dynamic, 16)
+#endif
+    for (i = 0; i < T; i++) {
+        row = PACKED_ROW(A, i);
+        sum = 0.0;
+        if (i < N) {
+            for (j = N; j < T; j++) { sum += row[j - i]; }
+            degrees[i] = old_degrees[i] + sum;
+        }
+        else {
+            for (j = 0; j < i; j++) { sum += PACKED_ROW(A, j)[i - j]; }
+            for (j = i + 1; j < T; j++) { sum += row[j - i]; }
+            degrees[i] = sum;
+        }
+        inv_sqrt_degrees[i] = degrees[i] > 0 ? 1.0 / sqrt(degrees[i]) : 0.0; /* avoid division by zero */
+    }
+}
+/*
+ * ========================================INCREMENTAL_EXTEND======================================
+ * appends new_points (copied) after the points of W, A gains their rows and columns and every
+ * degree is updated. A is moved into a new allocation, so the old and new A coexist for a moment
+ * returns 1 on success, 0 on failure or a dimension mismatch, W is unchanged then
+*/
+int incremental_extend(incremental_w *W, const matrix *new_points) {
+    const int N = W->points != NULL ? W->points->rows : 0, M = new_points->rows, d = new_points->cols;
+    matrix *points;
+    packed_matrix *A;
+    double *degrees, *inv_sqrt_degrees;
+    int i, c;
+
+    if ((W->points != NULL && d != W->points->cols) || M < 1 || (double)N + M > 2147483647.0) { return 0; }
+    PROFILE_BEGIN("extend");
+    points = matrix_alloc(N + M, d);
+    A = packed_alloc(N + M);
+    degrees = (double *)malloc((size_t)(N + M) * sizeof(double));
+    inv_sqrt_degrees = (double *)malloc((size_t)(N + M) * sizeof(double));
+    if (points == NULL || A == NULL || degrees == NULL || inv_sqrt_degrees == NULL) {
+        free_matrix(points); free_packed(A); free(degrees); free(inv_sqrt_degrees);
+        PROFILE_END(0);
+        return 0;
+    }
+    PROFILE_ALLOC(2.0 * (N + M) * sizeof(double));
+    for (i = 0; i < N + M; i++) {
+        for (c = 0; c < d; c++) { MAT_AT(points, i, c) = i < N ? MAT_AT(W->points, i, c) : MAT_AT(new_points, i - N, c); }
+    }
+    extend_similarity(W->A, points, A);
+    extend_degrees(W->degrees, N, A, degrees, inv_sqrt_degrees);
+    free_matrix(W->points); free_packed(W->A); free(W->degrees); free(W->inv_sqrt_degrees);
+    W->points = points;
+    W->A = A;
+    W->degrees = degrees;
+    W->inv_sqrt_degrees = inv_sqrt_degrees;
+    W->W.A = A;
+    W->W.scale = inv_sqrt_degrees;
+    PROFILE_END((PROFILE_PAIRS(N + M) - PROFILE_PAIRS(N)) * (PROFILE_KERNEL_FLOPS(d) + 1) + 2.0 * (N + M));
+    return 1;
+}
+/*
+ * ========================================INCREMENTAL_EXTEND_H====================================
+ * the previous H (its rows are the first points of W) grown to every point of W: a new point
+ * starts from the average of the old rows weighted by its similarity to those points, so it
+ * leans towards the clusters of its neighbors, or from the mean old row if it has no neighbor
+ * returns the N x k warm start, NULL if H has more rows than W or on failure, caller is the handler
+*/
+matrix* incremental_extend_h(const incremental_w *W, const matrix *H) {
+    const int N = H->rows, T = W->points->rows, k = H->cols;
+    matrix *grown;
+    double *row, *mean, weight, total;
+    int i, j, c;
+
+    if (N < 1 || N > T) { return NULL; }
+    grown = matrix_alloc(T, k);
+    mean = (double *)calloc((size_t)k, sizeof(double));
+    if (grown == NULL || mean == NULL) {
+        free_matrix(grown); free(mean);
+        return NULL;
+    }
+    for (i = 0; i < N; i++) {
+        for (c = 0; c < k; c++) {
+            MAT_AT(grown, i, c) = MAT_AT(H, i, c);
+            mean[c] += MAT_AT(H, i, c) / N;
+        }
+    }
+#ifdef _OPENMP
+#pragma omp parallel for private(j, c, row, weight, total) schedule(dynamic, 16)
+#endif
+    for (i = N; i < T; i++) {
+        row = MAT_ROW(grown, i);
+        for (c = 0; c < k; c++) { row[c] = 0.0; }
+        total = 0.0;
+        for (j = 0; j < N; j++) {
+            weight = PACKED_ROW(W->A, j)[i - j];
+            for (c = 0; c < k; c++) { row[c] += weight * MAT_AT(H, j, c); }
+            total += weight;
+        }
+        for (c = 0; c < k; c++) { row[c] = total > 0 ? row[c] / total : mean[c]; }
+    }
+    free(mean);
+    return grown;
+}
+/*
+ * ========================================INCREMENTAL_NORM========================================
+ * the dense W = D^-1/2 * A * D^-1/2 of every point so far, the calculate_norm_matrix() result
+ * returns NULL on failure, caller is the handler
+*/
+matrix* incremental_norm(const incremental_w *W) {
+    const int T = W->points->rows;
+    const double *s = W->inv_sqrt_degrees;
+    matrix *norm;
+    int i, j;
+
+    norm = matrix_alloc(T, T);
+    if (norm == NULL) { return NULL; }
+#ifdef _OPENMP
+#pragma omp parallel for private(j) schedule(static)
+#endif
+    for (i = 0; i < T; i++) {
+        for (j = 0; j < T; j++) { MAT_AT(norm, i, j) = PACKED_AT(W->A, i, j) * (s[i] * s[j]); }
+    }
+    return norm;
+}
@@ -0,0 +1,21 @@
+/*
+ * the normalized W of a set of points that grows over time. A (packed) and the degrees are kept,
+ * so adding M points to N evaluates only the M(N + M) new kernel entries and updates the degrees
+ * instead of rebuilding everything. W itself is never formed, the operator scales around A
+ * (w_operator_scaled()), so renormalizing is the O(N) update of the inverse square roots.
+ * incremental_extend_h() grows the previous H with rows for the new points, which makes a warm
+ * start for optimize_h_run()
+ */
+typedef struct {
+    matrix *points;           /* every point so far in arrival order, NULL while empty */
+    packed_matrix *A;         /* similarity of every pair, NULL while empty */
+    double *degrees;          /* row sums of A */
+    double *inv_sqrt_degrees; /* 0 for a point with no neighbors */
+    scaled_packed W;          /* A scaled by inv_sqrt_degrees */
+} incremental_w;
+
+incremental_w* incremental_create(const matrix *data_points);
+int incremental_extend(incremental_w *W, const matrix *new_points);
+void free_incremental(incremental_w *W);
+matrix* incremental_extend_h(const incremental_w *W, const matrix *H);
+matrix* incremental_norm(const incremental_w *W);
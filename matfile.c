@@ -0,0 +1,434 @@
+#define _POSIX_C_SOURCE 200112L /* open, fstat, mmap, posix_madvise */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include "symnmf.h"
+#include "packed.h"
+#include "matfile.h"
+#include "profile.h"
+#if defined(__unix__) || defined(__APPLE__)
+#define MATFILE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const char matfile_magic[8] = {'S', 'Y', 'M', 'N', 'M', 'F', 'M', 'X'};
+
+static int host_is_little_endian(void) {
+    const int one = 1;
+    return *(const char *)&one == 1;
+}
+static void put_u32(unsigned char *p, unsigned long v) {
+    int i;
+    for (i = 0; i < 4; i++) { p[i] = (unsigned char)((v >> (8 * i)) & 0xffUL); }
+}
+static void put_u64(unsigned char *p, size_t v) {
+    put_u32(p, (unsigned long)(v & 0xffffffffUL));
+    put_u32(p + 4, (unsigned long)((v >> 16 >> 16) & 0xffffffffUL)); /* two shifts, size_t may be 32 bits */
+}
+static unsigned long get_u32(const unsigned char *p) {
+    return (unsigned long)p[0] | (unsigned long)p[1] << 8 | (unsigned long)p[2] << 16 | (unsigned long)p[3] << 24;
+}
+/* returns 0 if the value does not fit in a size_t */
+static int get_u64(const unsigned char *p, size_t *v) {
+    const unsigned long high = get_u32(p + 4);
+    if (high != 0 && sizeof(size_t) < 8) { return 0; }
+    *v = (size_t)get_u32(p) | (size_t)high << 16 << 16;
+    return 1;
+}
+/* reverses the bytes of count doubles, payloads are little-endian on every host */
+static void swap_doubles(double *values, size_t count) {
+    unsigned char *b, t;
+    size_t i;
+    int j;
+    for (i = 0; i < count; i++) {
+        b = (unsigned char *)(values + i);
+        for (j = 0; j < 4; j++) { t = b[j]; b[j] = b[7 - j]; b[7 - j] = t; }
+    }
+}
+/* the row stride matrix_alloc() gives a matrix with cols columns */
+static size_t padded_stride(int cols) {
+    const size_t align_doubles = MATRIX_ALIGNMENT / sizeof(double);
+    size_t stride = (size_t)cols;
+    if (stride >= align_doubles) { stride = (stride + align_doubles - 1) / align_doubles * align_doubles; }
+    return stride;
+}
+/*
+ * ========================================MATFILE_IS_BINARY=======================================
+ * returns 1 if the file starts with the binary matrix magic, 0 otherwise (or if it cannot be read)
+*/
+int matfile_is_binary(const char *file_name) {
+    unsigned char magic[sizeof(matfile_magic)];
+    FILE *file = fopen(file_name, "rb");
+    int binary;
+    if (file == NULL) { return 0; }
+    binary = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, matfile_magic, sizeof(magic)) == 0;
+    fclose(file);
+    return binary;
+}
+/*
+ * ========================================READ_DOUBLES============================================
+ * reads count little-endian doubles into dst
+*/
+static int read_doubles(FILE *file, double *dst, size_t count) {
+    if (fread(dst, sizeof(double), count, file) != count) { return 0; }
+    if (!host_is_little_endian()) { swap_doubles(dst, count); }
+    return 1;
+}
+/*
+ * ========================================PARSE_HEADER============================================
+ * validates the 64 byte header and fills the shape, layout and payload position
+ * returns 0 with a short reason in *error if the file cannot be used
+*/
+typedef struct {
+    unsigned long layout;
+    size_t rows, cols, stride, offset, bytes;
+} matfile_header;
+
+static int parse_header(const unsigned char *header, matfile_header *h, const char **error) {
+    size_t expected;
+    if (memcmp(header, matfile_magic, sizeof(matfile_magic)) != 0) { *error = "not a binary matrix file"; return 0; }
+    h->layout = get_u32(header + 16);
+    if (get_u32(header + 8) != MATFILE_VERSION || get_u32(header + 12) != MATFILE_DTYPE_FLOAT64
+            || (h->layout != MATFILE_LAYOUT_DENSE && h->layout != MATFILE_LAYOUT_PACKED)) {
+        *error = "unsupported binary matrix version, dtype or layout"; return 0;
+    }
+    *error = "corrupt binary matrix header";
+    if (!get_u64(header + 24, &h->rows) || !get_u64(header + 32, &h->cols) || !get_u64(header + 40, &h->stride)
+            || !get_u64(header + 48, &h->offset) || !get_u64(header + 56, &h->bytes)
+            || h->rows == 0 || h->cols == 0 || h->rows > INT_MAX || h->cols > INT_MAX || h->offset < MATFILE_HEADER_SIZE) {
+        return 0;
+    }
+    if (h->rows > (size_t)-1 / sizeof(double) / (h->rows > h->cols ? h->rows : h->cols)) { return 0; } /* size would overflow */
+    if (h->layout == MATFILE_LAYOUT_DENSE) {
+        if (h->stride < h->cols || h->stride > INT_MAX || h->rows > (size_t)-1 / sizeof(double) / h->stride) { return 0; }
+        expected = h->rows * h->stride * sizeof(double);
+    }
+    else {
+        if (h->rows != h->cols) { return 0; }
+        expected = h->rows * (h->rows + 1) / 2 * sizeof(double);
+    }
+    return h->bytes == expected;
+}
+/*
+ * ========================================MATFILE_READ============================================
+ * reads a binary matrix file into a new matrix, a packed file is expanded to the full symmetric matrix
+ * returns NULL with a short reason in *error (if error is not NULL), the caller is the handler
+*/
+matrix* matfile_read(const char *file_name, const char **error) {
+    unsigned char header[MATFILE_HEADER_SIZE];
+    const char *ignored;
+    matfile_header h;
+    size_t rows, cols, stride, i, j;
+    matrix *m = NULL;
+    double *row;
+    FILE *file;
+
+    if (error == NULL) { error = &ignored; }
+    file = fopen(file_name, "rb");
+    if (file == NULL) { *error = "cannot open file"; return NULL; }
+    if (fread(header, 1, sizeof(header), file) != sizeof(header)) { *error = "not a binary matrix file"; goto fail; }
+    if (!parse_header(header, &h, error)) { goto fail; }
+    rows = h.rows; cols = h.cols; stride = h.stride;
+    if (fseek(file, (long)h.offset, SEEK_SET) != 0) { *error = "corrupt binary matrix header"; goto fail; }
+    m = matrix_alloc((int)rows, (int)cols);
+    if (m == NULL) { *error = "out of memory"; goto fail; }
+    if (h.layout == MATFILE_LAYOUT_DENSE && stride == (size_t)m->stride) { /* same padding, one read */
+        if (!read_doubles(file, m->data, rows * stride)) { *error = "truncated binary matrix file"; goto fail; }
+    }
+    else if (h.layout == MATFILE_LAYOUT_DENSE) {
+        for (i = 0; i < rows; i++) {
+            row = MAT_ROW(m, i);
+            if (!read_doubles(file, row, cols)) { *error = "truncated binary matrix file"; goto fail; }
+            if (i + 1 < rows && fseek(file, (long)((stride - cols) * sizeof(double)), SEEK_CUR) != 0) { /* padding of the writer */
+                *error = "truncated binary matrix file"; goto fail;
+            }
+        }
+    }
+    else {
+        for (i = 0; i < rows; i++) { /* row i of the triangle holds (i, i) .. (i, n-1) */
+            row = MAT_ROW(m, i);
+            if (!read_doubles(file, row + i, rows - i)) { *error = "truncated binary matrix file"; goto fail; }
+            for (j = 0; j < i; j++) { row[j] = MAT_AT(m, j, i); }
+        }
+    }
+    fclose(file);
+    return m;
+fail:
+    free_matrix(m);
+    fclose(file);
+    return NULL;
+}
+/*
+ * ========================================MATFILE_MAP=============================================
+ * maps a binary matrix file read only and exposes its payload in place, a dense file as
+ * mapping->dense and a packed file as mapping->packed, nothing is copied. the kernels read the
+ * payload front to back, so pages are faulted in as they are reached and the kernel may drop
+ * them again, a W larger than memory streams from disk on every product
+ * returns NULL with a short reason in *error (if error is not NULL), the caller is the handler
+*/
+matfile_mapping* matfile_map(const char *file_name, const char **error) {
+#ifdef MATFILE_MMAP
+    const char *ignored;
+    matfile_header h;
+    matfile_mapping *mapping;
+    struct stat st;
+    void *base;
+    int fd;
+
+    if (error == NULL) { error = &ignored; }
+    if (!host_is_little_endian()) { *error = "mapping needs a little-endian host"; return NULL; }
+    fd = open(file_name, O_RDONLY);
+    if (fd < 0) { *error = "cannot open file"; return NULL; }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < MATFILE_HEADER_SIZE || (off_t)(size_t)st.st_size != st.st_size) {
+        close(fd); *error = "not a binary matrix file"; return NULL;
+    }
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); /* the mapping keeps the file open */
+    if (base == MAP_FAILED) { *error = "cannot map file"; return NULL; }
+    if (!parse_header((const unsigned char *)base, &h, error)) { munmap(base, (size_t)st.st_size); return NULL; }
+    if (h.offset % sizeof(double) != 0 || h.offset > (size_t)st.st_size || h.bytes > (size_t)st.st_size - h.offset) {
+        munmap(base, (size_t)st.st_size); *error = "truncated binary matrix file"; return NULL;
+    }
+    mapping = (matfile_mapping *)calloc(1, sizeof(matfile_mapping));
+    if (mapping == NULL) { munmap(base, (size_t)st.st_size); *error = "out of memory"; return NULL; }
+    mapping->base = base;
+    mapping->length = (size_t)st.st_size;
+    mapping->layout = h.layout;
+    if (h.layout == MATFILE_LAYOUT_DENSE) {
+        mapping->dense.rows = (int)h.rows;
+        mapping->dense.cols = (int)h.cols;
+        mapping->dense.stride = (int)h.stride;
+        mapping->dense.data = (double *)((char *)base + h.offset);
+    }
+    else {
+        mapping->packed.n = (int)h.rows;
+        mapping->packed.data = (double *)((char *)base + h.offset);
+    }
+    posix_madvise(base, mapping->length, POSIX_MADV_SEQUENTIAL); /* only a hint */
+    return mapping;
+#else
+    (void)file_name;
+    if (error != NULL) { *error = "memory mapping is not available"; }
+    return NULL;
+#endif
+}
+/*
+ * ========================================MATFILE_UNMAP===========================================
+ * releases a mapping from matfile_map(), NULL is ignored
+*/
+void matfile_unmap(matfile_mapping *mapping) {
+    if (mapping == NULL) { return; }
+#ifdef MATFILE_MMAP
+    munmap(mapping->base, mapping->length);
+#endif
+    free(mapping);
+}
+/*
+ * ========================================WRITE_HEADER============================================
+ * writes the 64 byte header, the payload follows it directly
+*/
+static int write_header(FILE *file, unsigned long layout, size_t rows, size_t cols, size_t stride, size_t bytes) {
+    unsigned char header[MATFILE_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    memcpy(header, matfile_magic, sizeof(matfile_magic));
+    put_u32(header + 8, MATFILE_VERSION);
+    put_u32(header + 12, MATFILE_DTYPE_FLOAT64);
+    put_u32(header + 16, layout);
+    put_u64(header + 24, rows);
+    put_u64(header + 32, cols);
+    put_u64(header + 40, stride);
+    put_u64(header + 48, MATFILE_HEADER_SIZE);
+    put_u64(header + 56, bytes);
+    return fwrite(header, 1, sizeof(header), file) == sizeof(header);
+}
+/*
+ * ========================================WRITE_DOUBLES===========================================
+ * writes count doubles from src little-endian followed by pad zeros, scratch holds count + pad
+*/
+static int write_doubles(FILE *file, const double *src, size_t count, size_t pad, double *scratch) {
+    size_t i;
+    if (host_is_little_endian() && pad == 0) { return fwrite(src, sizeof(double), count, file) == count; }
+    memcpy(scratch, src, count * sizeof(double));
+    for (i = 0; i < pad; i++) { scratch[count + i] = 0.0; }
+    if (!host_is_little_endian()) { swap_doubles(scratch, count); }
+    return fwrite(scratch, sizeof(double), count + pad, file) == count + pad;
+}
+/*
+ * ========================================MATFILE_WRITE===========================================
+ * writes m as a dense binary matrix file, rows padded like matrix_alloc() pads them
+ * m may be a view with any stride, only the first cols entries of each row are read
+ * returns 1 on success, 0 on failure
+*/
+int matfile_write(const char *file_name, const matrix *m) {
+    const size_t stride = padded_stride(m->cols);
+    double *scratch;
+    FILE *file;
+    int ok;
+    int i;
+
+    scratch = (double *)malloc(stride * sizeof(double));
+    if (scratch == NULL) { return 0; }
+    file = fopen(file_name, "wb");
+    if (file == NULL) { free(scratch); return 0; }
+    PROFILE_BEGIN("output");
+    ok = write_header(file, MATFILE_LAYOUT_DENSE, (size_t)m->rows, (size_t)m->cols, stride, (size_t)m->rows * stride * sizeof(double));
+    for (i = 0; ok && i < m->rows; i++) {
+        ok = write_doubles(file, MAT_ROW(m, i), (size_t)m->cols, stride - (size_t)m->cols, scratch);
+    }
+    free(scratch);
+    ok = fclose(file) == 0 && ok;
+    PROFILE_END(0);
+    return ok;
+}
+/*
+ * ========================================MATFILE_WRITE_PACKED====================================
+ * writes the upper triangle of a packed symmetric matrix, half the size of the dense file
+ * returns 1 on success, 0 on failure
+*/
+int matfile_write_packed(const char *file_name, const packed_matrix *p) {
+    const size_t n = (size_t)p->n;
+    double *scratch;
+    FILE *file;
+    size_t i;
+    int ok;
+
+    scratch = (double *)malloc((n > 0 ? n : 1) * sizeof(double));
+    if (scratch == NULL) { return 0; }
+    file = fopen(file_name, "wb");
+    if (file == NULL) { free(scratch); return 0; }
+    PROFILE_BEGIN("output");
+    ok = write_header(file, MATFILE_LAYOUT_PACKED, n, n, 0, n * (n + 1) / 2 * sizeof(double));
+    for (i = 0; ok && i < n; i++) {
+        ok = write_doubles(file, PACKED_ROW(p, i), n - i, 0, scratch);
+    }
+    free(scratch);
+    ok = fclose(file) == 0 && ok;
+    PROFILE_END(0);
+    return ok;
+}
+/*
+ * ========================================CHECKPOINT_WRITE========================================
+ * writes the state into "<file_name>.tmp" and renames it over file_name, so a process killed
+ * while writing leaves the previous checkpoint whole
+ * returns 1 on success, 0 on failure with errno telling why
+*/
+static const char checkpoint_magic[8] = {'S', 'Y', 'M', 'N', 'M', 'F', 'C', 'K'};
+
+int checkpoint_write(const char *file_name, const symnmf_checkpoint *c) {
+    unsigned char header[MATFILE_HEADER_SIZE];
+    const int N = c->H->rows, k = c->H->cols;
+    const size_t count = 4 + (size_t)N * k * (c->extra != NULL ? 2 : 1) + (size_t)c->iterations;
+    double scalars[4], *scratch;
+    char *temporary;
+    FILE *file;
+    int ok, i, errnum = 0;
+
+    scalars[0] = c->gamma; scalars[1] = c->gamma_max; scalars[2] = c->last_fit; scalars[3] = c->penalty;
+    temporary = (char *)malloc(strlen(file_name) + 5);
+    scratch = (double *)malloc((size_t)(k > 4 ? k : 4) * sizeof(double) + (size_t)c->iterations * sizeof(double));
+    if (temporary == NULL || scratch == NULL) { free(temporary); free(scratch); errno = ENOMEM; return 0; }
+    sprintf(temporary, "%s.tmp", file_name);
+    file = fopen(temporary, "wb");
+    if (file == NULL) { errnum = errno; free(temporary); free(scratch); errno = errnum; return 0; }
+    PROFILE_BEGIN("checkpoint");
+    memset(header, 0, sizeof(header));
+    memcpy(header, checkpoint_magic, sizeof(checkpoint_magic));
+    put_u32(header + 8, CHECKPOINT_VERSION);
+    put_u32(header + 12, (unsigned long)c->method);
+    put_u64(header + 16, (size_t)N);
+    put_u64(header + 24, (size_t)k);
+    put_u64(header + 32, (size_t)c->iterations);
+    put_u64(header + 40, (size_t)c->products);
+    put_u32(header + 48, c->extra != NULL);
+    put_u64(header + 56, count * sizeof(double));
+    ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    ok = ok && write_doubles(file, scalars, 4, 0, scratch);
+    for (i = 0; ok && i < N; i++) { ok = write_doubles(file, MAT_ROW(c->H, i), (size_t)k, 0, scratch); }
+    for (i = 0; ok && c->extra != NULL && i < N; i++) { ok = write_doubles(file, MAT_ROW(c->extra, i), (size_t)k, 0, scratch); }
+    ok = ok && (c->iterations == 0 || write_doubles(file, c->history, (size_t)c->iterations, 0, scratch));
+    ok = fclose(file) == 0 && ok;
+    if (ok && rename(temporary, file_name) != 0) { /* rename does not replace an existing file everywhere */
+        ok = remove(file_name) == 0 && rename(temporary, file_name) == 0;
+    }
+    if (!ok) { errnum = errno; remove(temporary); }
+    PROFILE_END(0);
+    free(temporary); free(scratch);
+    if (!ok) { errno = errnum; } /* the cleanup may have changed it */
+    return ok;
+}
+/*
+ * ========================================CHECKPOINT_READ=========================================
+ * reads a checkpoint written by checkpoint_write()
+ * returns NULL with a short reason in *error (if error is not NULL), the caller is the handler
+*/
+symnmf_checkpoint* checkpoint_read(const char *file_name, const char **error) {
+    unsigned char header[MATFILE_HEADER_SIZE];
+    const char *ignored;
+    symnmf_checkpoint *c = NULL;
+    size_t N, k, iterations, products, bytes, count;
+    double scalars[4];
+    unsigned long has_extra;
+    FILE *file;
+    int i;
+
+    if (error == NULL) { error = &ignored; }
+    file = fopen(file_name, "rb");
+    if (file == NULL) { *error = "cannot open file"; return NULL; }
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, checkpoint_magic, sizeof(checkpoint_magic)) != 0) {
+        *error = "not a checkpoint file"; goto fail;
+    }
+    *error = "corrupt checkpoint header";
+    has_extra = get_u32(header + 48);
+    if (get_u32(header + 8) != CHECKPOINT_VERSION || get_u32(header + 12) > SYMNMF_METHOD_HALS || has_extra > 1
+            || (has_extra == 1) != (get_u32(header + 12) != SYMNMF_METHOD_MU)) {
+        goto fail;
+    }
+    if (!get_u64(header + 16, &N) || !get_u64(header + 24, &k) || !get_u64(header + 32, &iterations)
+            || !get_u64(header + 40, &products) || !get_u64(header + 56, &bytes)
+            || N == 0 || k == 0 || N > INT_MAX || k > INT_MAX || iterations > INT_MAX || products > INT_MAX
+            || N > (size_t)-1 / sizeof(double) / 4 / k) {
+        goto fail;
+    }
+    count = 4 + N * k * (has_extra + 1) + iterations;
+    if (count < iterations || bytes / sizeof(double) != count || bytes % sizeof(double) != 0) { goto fail; }
+    c = (symnmf_checkpoint *)calloc(1, sizeof(symnmf_checkpoint));
+    if (c == NULL) { *error = "out of memory"; goto fail; }
+    c->method = (int)get_u32(header + 12);
+    c->iterations = (int)iterations;
+    c->products = (int)products;
+    c->H = matrix_alloc((int)N, (int)k);
+    if (has_extra) { c->extra = matrix_alloc((int)N, (int)k); }
+    if (iterations > 0) { c->history = (double *)malloc(iterations * sizeof(double)); }
+    if (c->H == NULL || (has_extra && c->extra == NULL) || (iterations > 0 && c->history == NULL)) { *error = "out of memory"; goto fail; }
+    *error = "truncated checkpoint file";
+    if (!read_doubles(file, scalars, 4)) { goto fail; }
+    c->gamma = scalars[0]; c->gamma_max = scalars[1]; c->last_fit = scalars[2]; c->penalty = scalars[3];
+    for (i = 0; i < (int)N; i++) {
+        if (!read_doubles(file, MAT_ROW(c->H, i), k)) { goto fail; }
+    }
+    for (i = 0; has_extra && i < (int)N; i++) {
+        if (!read_doubles(file, MAT_ROW(c->extra, i), k)) { goto fail; }
+    }
+    if (iterations > 0 && !read_doubles(file, c->history, iterations)) { goto fail; }
+    fclose(file);
+    return c;
+fail:
+    free_checkpoint(c);
+    fclose(file);
+    return NULL;
+}
+/*
+ * ========================================FREE_CHECKPOINT=========================================
+*/
+void free_checkpoint(symnmf_checkpoint *c) {
+    if (c == NULL) { return; }
+    free_matrix(c->H);
+    free_matrix(c->extra);
+    free(c->history);
+    free(c);
+}
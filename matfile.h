@@ -0,0 +1,47 @@
+/*
+ * binary matrix file: a 64 byte little-endian header, then the raw payload at payload_offset
+ * (64, so the payload of an mmap'd file starts MATRIX_ALIGNMENT aligned)
+ *   0 magic "SYMNMFMX"        24 rows (u64)
+ *   8 version (u32) = 1       32 cols (u64)
+ *  12 dtype (u32)             40 stride, elements between row starts (u64), dense layout only
+ *  16 layout (u32)            48 payload offset (u64)
+ *  20 reserved (u32) = 0      56 payload bytes (u64)
+ * dense payloads are rows x stride with rows padded like matrix_alloc() pads them, so a mapped
+ * payload can be used as a matrix in place. packed payloads hold the n(n+1)/2 upper triangle
+ */
+#define MATFILE_HEADER_SIZE 64
+#define MATFILE_VERSION 1
+#define MATFILE_DTYPE_FLOAT64 1
+#define MATFILE_LAYOUT_DENSE 0
+#define MATFILE_LAYOUT_PACKED 1
+
+/* a binary matrix file mapped read only by matfile_map(), the view matching layout points into it */
+typedef struct {
+    void *base;
+    size_t length;
+    unsigned long layout;
+    matrix dense;         /* MATFILE_LAYOUT_DENSE */
+    packed_matrix packed; /* MATFILE_LAYOUT_PACKED */
+} matfile_mapping;
+
+int matfile_is_binary(const char *file_name);
+matrix* matfile_read(const char *file_name, const char **error);
+int matfile_write(const char *file_name, const matrix *m);
+int matfile_write_packed(const char *file_name, const packed_matrix *p);
+matfile_mapping* matfile_map(const char *file_name, const char **error);
+void matfile_unmap(matfile_mapping *mapping);
+
+/*
+ * checkpoint file of optimize_h_run() (symnmf_checkpoint), little-endian like the matrix files
+ *   0 magic "SYMNMFCK"        24 k (u64)
+ *   8 version (u32) = 1       32 iterations (u64)
+ *  12 method (u32)            40 products (u64)
+ *  16 N (u64)                 48 has extra (u32), 52 reserved (u32) = 0, 56 payload bytes (u64)
+ * the payload holds gamma, gamma_max, last_fit and penalty, then H and extra (if any) as N rows
+ * of k doubles without padding, then the residual history
+ */
+#define CHECKPOINT_VERSION 1
+
+int checkpoint_write(const char *file_name, const symnmf_checkpoint *c);
+symnmf_checkpoint* checkpoint_read(const char *file_name, const char **error);
+void free_checkpoint(symnmf_checkpoint *c);
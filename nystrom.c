@@ -0,0 +1,430 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "symnmf.h"
+#include "packed.h"
+#include "rng.h"
+#include "nystrom.h"
+#include "profile.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+ * ========================================SAMPLE_UNIFORM==========================================
+ * m distinct indices out of N, the first m steps of a Fisher-Yates shuffle
+ * returns m, 0 on failure
+*/
+static int sample_uniform(int N, int m, unsigned long seed, int *chosen) {
+    mt_state rng;
+    int *order, a, j, swap;
+    order = (int *)malloc((size_t)N * sizeof(int));
+    if (order == NULL) { return 0; }
+    for (j = 0; j < N; j++) { order[j] = j; }
+    mt_seed(&rng, seed);
+    for (a = 0; a < m; a++) {
+        j = a + (int)(mt_next_double(&rng) * (N - a));
+        swap = order[a]; order[a] = order[j]; order[j] = swap;
+        chosen[a] = order[a];
+    }
+    free(order);
+    return m;
+}
+/*
+ * ========================================SAMPLE_KMEANSPP=========================================
+ * k-means++ seeding: the first landmark uniformly, every next one with probability proportional
+ * to its squared distance to the closest landmark so far, so the landmarks spread over the data
+ * stops early when every point coincides with a landmark. returns the landmarks chosen, 0 on failure
+*/
+static int sample_kmeanspp(const matrix *data_points, int m, unsigned long seed, int *chosen) {
+    const int N = data_points->rows, d = data_points->cols;
+    mt_state rng;
+    double *dist, total, target, cumulative, candidate;
+    int count, i, pick;
+
+    dist = (double *)malloc((size_t)N * sizeof(double));
+    if (dist == NULL) { return 0; }
+    mt_seed(&rng, seed);
+    chosen[0] = (int)(mt_next_double(&rng) * N);
+    for (i = 0; i < N; i++) { dist[i] = HUGE_VAL; }
+    for (count = 1; ; count++) {
+#ifdef _OPENMP
+#pragma omp parallel for private(candidate) schedule(static)
+#endif
+        for (i = 0; i < N; i++) { /* distances to the landmark just chosen */
+            candidate = squared_euclidean_distance(MAT_ROW(data_points, i), MAT_ROW(data_points, chosen[count - 1]), d);
+            if (candidate < dist[i]) { dist[i] = candidate; }
+        }
+        if (count == m) { break; }
+        for (total = 0.0, i = 0; i < N; i++) { total += dist[i]; }
+        if (!(total > 0)) { break; } /* only copies of landmarks are left */
+        target = mt_next_double(&rng) * total;
+        for (pick = -1, cumulative = 0.0, i = 0; i < N; i++) {
+            if (dist[i] <= 0) { continue; }
+            pick = i; /* the last candidate if rounding leaves target past the sum */
+            cumulative += dist[i];
+            if (cumulative > target) { break; }
+        }
+        chosen[count] = pick;
+    }
+    free(dist);
+    return count;
+}
+/*
+ * ========================================JACOBI_EIGEN============================================
+ * eigendecomposition of the symmetric U by cyclic Jacobi rotations: U is overwritten, its diagonal
+ * ends up holding the eigenvalues and the columns of V the eigenvectors. sweeps stop once the off
+ * diagonal mass is negligible against the diagonal, or after NYSTROM_SWEEPS
+*/
+static void jacobi_eigen(matrix *U, matrix *V) {
+    const int m = U->rows;
+    double off, diagonal, theta, t, c, s, a, b;
+    int sweep, p, q, i;
+
+    for (p = 0; p < m; p++) {
+        for (q = 0; q < m; q++) { MAT_AT(V, p, q) = p == q ? 1.0 : 0.0; }
+    }
+    for (sweep = 0; sweep < NYSTROM_SWEEPS; sweep++) {
+        for (off = 0.0, diagonal = 0.0, p = 0; p < m; p++) {
+            diagonal += MAT_AT(U, p, p) * MAT_AT(U, p, p);
+            for (q = p + 1; q < m; q++) { off += MAT_AT(U, p, q) * MAT_AT(U, p, q); }
+        }
+        if (off <= 1e-30 * diagonal) { break; }
+        for (p = 0; p < m - 1; p++) {
+            for (q = p + 1; q < m; q++) {
+                if (MAT_AT(U, p, q) == 0.0) { continue; }
+                /* the rotation of the (p, q) plane that zeroes U_pq, t = tan of its angle */
+                theta = (MAT_AT(U, q, q) - MAT_AT(U, p, p)) / (2.0 * MAT_AT(U, p, q));
+                t = (theta >= 0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+                c = 1.0 / sqrt(t * t + 1.0);
+                s = t * c;
+                for (i = 0; i < m; i++) { /* U * J */
+                    a = MAT_AT(U, i, p); b = MAT_AT(U, i, q);
+                    MAT_AT(U, i, p) = c * a - s * b;
+                    MAT_AT(U, i, q) = s * a + c * b;
+                }
+                for (i = 0; i < m; i++) { /* J^T * U */
+                    a = MAT_AT(U, p, i); b = MAT_AT(U, q, i);
+                    MAT_AT(U, p, i) = c * a - s * b;
+                    MAT_AT(U, q, i) = s * a + c * b;
+                }
+                for (i = 0; i < m; i++) { /* V * J */
+                    a = MAT_AT(V, i, p); b = MAT_AT(V, i, q);
+                    MAT_AT(V, i, p) = c * a - s * b;
+                    MAT_AT(V, i, q) = s * a + c * b;
+                }
+            }
+        }
+    }
+}
+/*
+ * ========================================PSEUDO_INVERSE_ROOT=====================================
+ * the m x r projection P = V_r L_r^-1/2 onto the eigenvalues of U above NYSTROM_RCOND times the
+ * largest, so that C U^+ C^T = (C P)(C P)^T. U and V come from jacobi_eigen()
+ * returns r, written to the first r columns of P
+*/
+static int pseudo_inverse_root(const matrix *U, const matrix *V, matrix *P) {
+    const int m = U->rows;
+    double largest = 0.0, root;
+    int a, i, r = 0;
+    for (a = 0; a < m; a++) {
+        if (MAT_AT(U, a, a) > largest) { largest = MAT_AT(U, a, a); }
+    }
+    for (a = 0; a < m; a++) {
+        if (!(MAT_AT(U, a, a) > NYSTROM_RCOND * largest)) { continue; }
+        root = 1.0 / sqrt(MAT_AT(U, a, a));
+        for (i = 0; i < m; i++) { MAT_AT(P, i, r) = MAT_AT(V, i, a) * root; }
+        r++;
+    }
+    return r;
+}
+/*
+ * ========================================TRANSPOSE_PRODUCT=======================================
+ * G = F^T * T (r x k) for the N x r factor and an N x k T: every thread sums its static share of
+ * the rows into its own r x k partial, the partials are then added in thread order, so a fixed
+ * thread count gives fixed results. partials holds r rows per thread of the team, G r rows
+*/
+static void transpose_product(const matrix *F, const matrix *T, matrix *partials, matrix *G, int threads) {
+    const int N = F->rows, r = F->cols, k = T->cols;
+    double *part, f;
+    int i, a, c, t, team;
+
+#ifdef _OPENMP
+#pragma omp parallel private(i, a, c, t, team, part, f) num_threads(threads)
+#endif
+    {
+#ifdef _OPENMP
+        t = omp_get_thread_num(); team = omp_get_num_threads();
+#else
+        t = 0; team = 1;
+#endif
+        for (a = 0; a < r; a++) {
+            part = MAT_ROW(partials, (size_t)t * r + a);
+            for (c = 0; c < k; c++) { part[c] = 0.0; }
+        }
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (i = 0; i < N; i++) {
+            for (a = 0; a < r; a++) {
+                f = MAT_AT(F, i, a);
+                part = MAT_ROW(partials, (size_t)t * r + a);
+                for (c = 0; c < k; c++) { part[c] += f * MAT_AT(T, i, c); }
+            }
+        }
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (a = 0; a < r; a++) {
+            for (c = 0; c < k; c++) { MAT_AT(G, a, c) = 0.0; }
+            for (t = 0; t < team; t++) {
+                part = MAT_ROW(partials, (size_t)t * r + a);
+                for (c = 0; c < k; c++) { MAT_AT(G, a, c) += part[c]; }
+            }
+        }
+    }
+}
+/*
+ * ========================================NYSTROM_DEGREES=========================================
+ * the diagonal of F F^T and the approximate degrees F (F^T 1) minus it, the row sums of A~, with
+ * their inverse square roots. returns 1 on success, 0 on failure
+*/
+static int nystrom_degrees(nystrom_w *W) {
+    const int N = W->factor->rows, r = W->factor->cols, threads = symnmf_max_threads();
+    matrix *ones, *partials, *sums;
+    double degree, diagonal;
+    int i, a;
+
+    ones = matrix_alloc(N, 1);
+    partials = matrix_alloc(threads * r, 1);
+    sums = matrix_alloc(r, 1);
+    if (ones == NULL || partials == NULL || sums == NULL) {
+        free_matrix(ones); free_matrix(partials); free_matrix(sums);
+        return 0;
+    }
+    for (i = 0; i < N; i++) { MAT_AT(ones, i, 0) = 1.0; }
+    transpose_product(W->factor, ones, partials, sums, threads);
+    for (i = 0; i < N; i++) {
+        for (degree = diagonal = 0.0, a = 0; a < r; a++) {
+            degree += MAT_AT(W->factor, i, a) * MAT_AT(sums, a, 0);
+            diagonal += MAT_AT(W->factor, i, a) * MAT_AT(W->factor, i, a);
+        }
+        W->diagonal[i] = diagonal;
+        degree -= diagonal;
+        W->inv_sqrt_degrees[i] = degree > 0 ? 1.0 / sqrt(degree) : 0.0; /* avoid division by zero */
+    }
+    free_matrix(ones); free_matrix(partials); free_matrix(sums);
+    return 1;
+}
+/*
+ * ========================================FREE_NYSTROM============================================
+*/
+void free_nystrom(nystrom_w *W) {
+    if (W == NULL) { return; }
+    free_matrix(W->factor);
+    free(W->diagonal);
+    free(W->inv_sqrt_degrees);
+    free(W);
+}
+/*
+ * ========================================NYSTROM_CREATE==========================================
+ * samples the landmarks (NYSTROM_UNIFORM or NYSTROM_KMEANSPP, seeded), computes the N x m kernel
+ * block C with formula 1.1 (the landmark itself included, K_ii = 1), decomposes the landmark
+ * block U and turns C into the factor F = C P in place, row by row
+ * the Jacobi decomposition is O(m^3) per sweep, which keeps m at a few hundred to a thousand
+ * returns NULL if landmarks is not in [1, N] or on failure, caller is the handler
+*/
+nystrom_w* nystrom_create(const matrix *data_points, int landmarks, int sampling, unsigned long seed) {
+    const int N = data_points->rows, d = data_points->cols;
+    nystrom_w *W;
+    matrix *C = NULL, *U = NULL, *V = NULL, *P = NULL;
+    int *chosen = NULL;
+    double *row = NULL, sum;
+    int m, r, i, a, b, failed = 0;
+
+    if (landmarks < 1 || landmarks > N) { return NULL; }
+    PROFILE_BEGIN("nystrom");
+    W = (nystrom_w *)calloc(1, sizeof(nystrom_w));
+    chosen = (int *)malloc((size_t)landmarks * sizeof(int));
+    if (W == NULL || chosen == NULL) { free(W); free(chosen); PROFILE_END(0); return NULL; }
+    if (sampling == NYSTROM_KMEANSPP) { m = sample_kmeanspp(data_points, landmarks, seed, chosen); }
+    else { m = sample_uniform(N, landmarks, seed, chosen); }
+    C = matrix_alloc(N, m > 0 ? m : 1);
+    U = matrix_alloc(m > 0 ? m : 1, m > 0 ? m : 1);
+    V = matrix_alloc(m > 0 ? m : 1, m > 0 ? m : 1);
+    P = matrix_alloc(m > 0 ? m : 1, m > 0 ? m : 1);
+    W->diagonal = (double *)malloc((size_t)N * sizeof(double));
+    W->inv_sqrt_degrees = (double *)malloc((size_t)N * sizeof(double));
+    if (m == 0 || C == NULL || U == NULL || V == NULL || P == NULL || W->diagonal == NULL || W->inv_sqrt_degrees == NULL) {
+        free(chosen); free_matrix(C); free_matrix(U); free_matrix(V); free_matrix(P); free_nystrom(W);
+        PROFILE_END(0);
+        return NULL;
+    }
+    PROFILE_ALLOC(2.0 * N * sizeof(double)); /* the matrices count themselves */
+#ifdef _OPENMP
+#pragma omp parallel for private(a) schedule(static)
+#endif
+    for (i = 0; i < N; i++) {
+        for (a = 0; a < m; a++) {
+            MAT_AT(C, i, a) = exp(-squared_euclidean_distance(MAT_ROW(data_points, i), MAT_ROW(data_points, chosen[a]), d) / 2.0);
+        }
+    }
+    for (a = 0; a < m; a++) {
+        for (b = 0; b < m; b++) { MAT_AT(U, a, b) = MAT_AT(C, chosen[a], b); }
+    }
+    jacobi_eigen(U, V);
+    r = pseudo_inverse_root(U, V, P);
+#ifdef _OPENMP
+#pragma omp parallel private(i, a, b, row, sum)
+#endif
+    {
+        row = (double *)malloc((size_t)m * sizeof(double)); /* per thread copy of the row of C */
+        if (row == NULL) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+            failed = 1;
+        }
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (i = 0; i < N; i++) {
+            if (row == NULL) { continue; }
+            for (a = 0; a < m; a++) { row[a] = MAT_AT(C, i, a); }
+            for (b = 0; b < r; b++) {
+                for (sum = 0.0, a = 0; a < m; a++) { sum += row[a] * MAT_AT(P, a, b); }
+                MAT_AT(C, i, b) = sum;
+            }
+        }
+        free(row);
+    }
+    free(chosen); free_matrix(U); free_matrix(V); free_matrix(P);
+    W->landmarks = m;
+    W->rank = r;
+    W->factor = C;
+    C->cols = r; /* the first r columns, the stride stays that of C */
+    if (failed || r == 0 || !nystrom_degrees(W)) {
+        free_nystrom(W);
+        PROFILE_END(0);
+        return NULL;
+    }
+    PROFILE_END((double)N * m * (PROFILE_KERNEL_FLOPS(d) + 2.0 * r) + 4.0 * N * r);
+    return W;
+}
+/*
+ * ========================================W_OPERATOR_NYSTROM======================================
+ * exposes the approximate W to optimize_h_op(): with T = S H and E the diagonal of F F^T,
+ * W H = S (F (F^T T) - E T), O(N r k).
+ * the workspace holds T (N rows), one r x k partial of F^T T per thread, then F^T T itself
+*/
+static matrix* nystrom_workspace_alloc(const w_operator *op, int k) {
+    const nystrom_w *W = (const nystrom_w *)op->data;
+    return matrix_alloc(op->N + (symnmf_max_threads() + 1) * W->rank, k);
+}
+static void nystrom_multiply(const w_operator *op, const matrix *H, matrix *out, matrix *workspace) {
+    const nystrom_w *W = (const nystrom_w *)op->data;
+    const int N = op->N, r = W->rank, k = H->cols;
+    const int threads = (workspace->rows - N) / r - 1;
+    const double *s = W->inv_sqrt_degrees;
+    matrix T, partials, G;
+    double sum;
+    int i, a, c;
+
+    T = *workspace; T.rows = N; T.cols = k;
+    partials = *workspace; partials.rows = threads * r; partials.cols = k; partials.data = MAT_ROW(workspace, N);
+    G = *workspace; G.rows = r; G.cols = k; G.data = MAT_ROW(workspace, N + (size_t)threads * r);
+#ifdef _OPENMP
+#pragma omp parallel for private(c) schedule(static)
+#endif
+    for (i = 0; i < N; i++) {
+        for (c = 0; c < k; c++) { MAT_AT(&T, i, c) = s[i] * MAT_AT(H, i, c); }
+    }
+    transpose_product(W->factor, &T, &partials, &G, threads);
+#ifdef _OPENMP
+#pragma omp parallel for private(a, c, sum) schedule(static)
+#endif
+    for (i = 0; i < N; i++) {
+        for (c = 0; c < k; c++) {
+            for (sum = 0.0, a = 0; a < r; a++) { sum += MAT_AT(W->factor, i, a) * MAT_AT(&G, a, c); }
+            MAT_AT(out, i, c) = s[i] * (sum - W->diagonal[i] * MAT_AT(&T, i, c));
+        }
+    }
+}
+/*
+ * ||W||_F^2 with B = S F: W is B B^T without its diagonal, so ||B B^T||^2 - sum_i (B B^T)_ii^2,
+ * where ||B B^T||_F = ||B^T B||_F and B^T B is r x r, O(N r^2) instead of O(N^2 r)
+ * returns a negative value if memory runs out
+*/
+static double nystrom_squared_norm(const w_operator *op) {
+    const nystrom_w *W = (const nystrom_w *)op->data;
+    const int N = op->N, r = W->rank, threads = symnmf_max_threads();
+    const double *s = W->inv_sqrt_degrees;
+    matrix *B, *partials, *gram;
+    double total = 0.0, diagonal;
+    int i, a;
+
+    B = matrix_alloc(N, r);
+    partials = matrix_alloc(threads * r, r);
+    gram = matrix_alloc(r, r);
+    if (B == NULL || partials == NULL || gram == NULL) {
+        free_matrix(B); free_matrix(partials); free_matrix(gram);
+        return -1.0;
+    }
+    for (i = 0; i < N; i++) {
+        for (a = 0; a < r; a++) { MAT_AT(B, i, a) = s[i] * MAT_AT(W->factor, i, a); }
+        diagonal = s[i] * s[i] * W->diagonal[i];
+        total -= diagonal * diagonal;
+    }
+    transpose_product(B, B, partials, gram, threads);
+    for (i = 0; i < r * r; i++) { total += MAT_AT(gram, i / r, i % r) * MAT_AT(gram, i / r, i % r); }
+    free_matrix(B); free_matrix(partials); free_matrix(gram);
+    return total;
+}
+void w_operator_nystrom(w_operator *op, const nystrom_w *W) {
+    op->N = W->factor->rows;
+    op->entries = 2.0 * W->factor->rows * W->rank; /* the two passes over F */
+    op->data = W;
+    op->workspace_alloc = nystrom_workspace_alloc;
+    op->multiply = nystrom_multiply;
+    op->squared_norm = nystrom_squared_norm;
+}
+/*
+ * ========================================NYSTROM_ERROR===========================================
+ * the relative error ||W - W~||_F / ||W||_F of the approximation against the exact W of
+ * calculate_norm_packed(), entry by entry. O(N^2) memory and O(N^2 r) time, for validating the
+ * landmark count on small inputs. returns a negative value on failure
+*/
+double nystrom_error(const nystrom_w *W, const matrix *data_points) {
+    const int N = W->factor->rows, r = W->rank;
+    const double *s = W->inv_sqrt_degrees;
+    packed_matrix *exact;
+    double *errors, *norms, approx, dot, error = 0.0, norm = 0.0, weight;
+    const double *row;
+    int i, j, a;
+
+    if (data_points->rows != N) { return -1.0; }
+    exact = calculate_norm_packed(data_points);
+    errors = (double *)malloc((size_t)N * sizeof(double));
+    norms = (double *)malloc((size_t)N * sizeof(double));
+    if (exact == NULL || errors == NULL || norms == NULL) {
+        free_packed(exact); free(errors); free(norms);
+        return -1.0;
+    }
+#ifdef _OPENMP
+#pragma omp parallel for private(j, a, row, approx, dot, weight) schedule(dynamic, 16)
+#endif
+    for (i = 0; i < N; i++) {
+        row = PACKED_ROW(exact, i);
+        errors[i] = norms[i] = 0.0;
+        for (j = i; j < N; j++) { /* each off diagonal pair stands for two entries */
+            for (dot = 0.0, a = 0; a < r; a++) { dot += MAT_AT(W->factor, i, a) * MAT_AT(W->factor, j, a); }
+            approx = j == i ? 0.0 : s[i] * s[j] * dot;
+            weight = j == i ? 1.0 : 2.0;
+            errors[i] += weight * (row[j - i] - approx) * (row[j - i] - approx);
+            norms[i] += weight * row[j - i] * row[j - i];
+        }
+    }
+    for (i = 0; i < N; i++) { error += errors[i]; norm += norms[i]; }
+    free_packed(exact); free(errors); free(norms);
+    return norm > 0 ? sqrt(error / norm) : sqrt(error);
+}
@@ -0,0 +1,29 @@
+/*
+ * low-rank (Nystrom) approximation of W for large N: m landmark points are sampled, only the
+ * N x m block C of the gaussian kernel K = A + I is computed, and K ~ C * U^+ * C^T where U is
+ * the m x m kernel of the landmarks. the pseudo-inverse comes from a Jacobi eigendecomposition
+ * U = V L V^T, so the approximation is kept as one thin factor F = C V_r L_r^-1/2 (r <= m
+ * eigenvalues kept). A ~ F F^T with its own diagonal removed rather than I: a point far from
+ * every landmark has F F^T ~ 0 on its row, diagonal included, and removing 1 there would leave
+ * it a negative self similarity. W ~ S A~ S with S the inverse square roots of the row sums of
+ * A~. memory is O(N*m) and a product with W costs O(N*r*k)
+ */
+typedef struct {
+    int landmarks;            /* landmark points sampled */
+    int rank;                 /* columns of factor, eigenvalues of U kept by the pseudo-inverse */
+    matrix *factor;           /* N x rank, K ~ factor * factor^T */
+    double *diagonal;         /* diagonal of factor * factor^T, removed from A~ */
+    double *inv_sqrt_degrees; /* 0 for a point whose approximate degree is not positive */
+} nystrom_w;
+
+/* how the landmarks are sampled */
+#define NYSTROM_UNIFORM 0  /* m distinct points, uniformly */
+#define NYSTROM_KMEANSPP 1 /* k-means++ seeding, each next landmark with probability ~ its squared distance to the chosen ones */
+
+#define NYSTROM_RCOND 1e-10     /* eigenvalues of U below this times the largest are dropped */
+#define NYSTROM_SWEEPS 50       /* cap on the Jacobi sweeps, they converge quadratically */
+
+nystrom_w* nystrom_create(const matrix *data_points, int landmarks, int sampling, unsigned long seed);
+void free_nystrom(nystrom_w *W);
+void w_operator_nystrom(w_operator *op, const nystrom_w *W);
+double nystrom_error(const nystrom_w *W, const matrix *data_points);
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "symnmf.h"
+#include "output.h"
+#include "profile.h"
+
+#define OUTPUT_TASK_BYTES (256 * 1024) /* text formatted per task before it is written */
+#define FIXED4_FAST_LIMIT 100000.0     /* below it value * 10^4 rounds to an exact 32 bit integer */
+#define FIXED4_TIE_MARGIN 1e-6         /* far above the error of value * 10^4 in that range */
+
+/*
+ * ========================================OUTPUT_FORMAT_FIXED4====================================
+ * writes value as printf("%.4f") would (no terminator) and returns the number of characters
+ * printf rounds the exact binary value, value * 10^4 is off from it by far less than the tie
+ * margin below FIXED4_FAST_LIMIT, so unless the fraction is that close to a half the rounding
+ * direction is the same. near ties, nan, inf and large values go to sprintf
+ * out must hold OUTPUT_MAX_VALUE_CHARS characters
+*/
+size_t output_format_fixed4(double value, char *out) {
+    const int negative = value < 0.0 || (value == 0.0 && 1.0 / value < 0.0); /* -0.0 prints "-0.0000" */
+    double scaled, whole;
+    unsigned long rounded, integer_part;
+    char digits[16];
+    int frac, count, i;
+    size_t len = 0;
+
+    scaled = negative ? -value * 10000.0 : value * 10000.0;
+    if (!(scaled < FIXED4_FAST_LIMIT * 10000.0)) { return (size_t)sprintf(out, "%.4f", value); } /* also nan */
+    whole = floor(scaled);
+    if (fabs(scaled - whole - 0.5) < FIXED4_TIE_MARGIN) { return (size_t)sprintf(out, "%.4f", value); }
+    rounded = (unsigned long)whole + (scaled - whole > 0.5 ? 1UL : 0UL);
+    integer_part = rounded / 10000UL;
+    frac = (int)(rounded % 10000UL);
+    if (negative) { out[len++] = '-'; }
+    count = 0;
+    do { digits[count++] = (char)('0' + integer_part % 10UL); integer_part /= 10UL; } while (integer_part > 0);
+    while (count > 0) { out[len++] = digits[--count]; }
+    out[len++] = '.';
+    for (i = 3; i >= 0; i--) { out[len + i] = (char)('0' + frac % 10); frac /= 10; }
+    return len + 4;
+}
+/*
+ * ========================================FORMAT_ROWS=============================================
+ * formats rows [begin, end) as comma separated lines into the growable text buffer
+ * returns 0 if the buffer cannot grow
+*/
+typedef struct {
+    char *text;
+    size_t len, capacity;
+    double *row;
+} output_task;
+
+static int format_rows(output_task *task, int begin, int end, int cols, output_row_fn fill, const void *source) {
+    char *grown;
+    size_t capacity;
+    int i, j;
+
+    task->len = 0;
+    for (i = begin; i < end; i++) {
+        fill(source, i, task->row);
+        for (j = 0; j < cols; j++) {
+            if (task->capacity - task->len < OUTPUT_MAX_VALUE_CHARS + 2) {
+                capacity = 2 * task->capacity + OUTPUT_MAX_VALUE_CHARS + 2;
+                grown = (char *)realloc(task->text, capacity);
+                if (grown == NULL) { return 0; }
+                task->text = grown;
+                task->capacity = capacity;
+            }
+            task->len += output_format_fixed4(task->row[j], task->text + task->len);
+            task->text[task->len++] = j < cols - 1 ? ',' : '\n';
+        }
+    }
+    return 1;
+}
+/*
+ * ========================================OUTPUT_ROWS=============================================
+ * prints a rows x cols matrix in the print_matrix() format, byte for byte the same as printf("%.4f")
+ * rows are formatted in tasks of about OUTPUT_TASK_BYTES into per task buffers, one task per
+ * thread at a time, and the buffers are written in row order with a single fwrite each
+ * returns 1 on success, 0 if memory runs out or the write fails
+*/
+int output_rows(FILE *out, int rows, int cols, output_row_fn fill, const void *source) {
+    const int threads = symnmf_max_threads();
+    int rows_per_task, task_count, t, begin, ok = 1, formatted = 1;
+    output_task *tasks;
+
+    if (cols <= 0) { return 1; }
+    rows_per_task = OUTPUT_TASK_BYTES / (8 * cols) + 1; /* about 8 characters per value */
+    task_count = threads;
+    tasks = (output_task *)calloc((size_t)task_count, sizeof(output_task));
+    if (tasks == NULL) { return 0; }
+    PROFILE_BEGIN("output");
+    for (t = 0; t < task_count; t++) {
+        tasks[t].row = (double *)malloc((size_t)cols * sizeof(double));
+        if (tasks[t].row == NULL) { ok = 0; }
+    }
+    for (begin = 0; ok && begin < rows; begin += task_count * rows_per_task) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) reduction(&& : formatted) if (task_count > 1 && rows - begin > rows_per_task)
+#endif
+        for (t = 0; t < task_count; t++) {
+            const int first = begin + t * rows_per_task;
+            const int last = first + rows_per_task < rows ? first + rows_per_task : rows;
+            if (first < last) { formatted = format_rows(&tasks[t], first, last, cols, fill, source) && formatted; }
+            else { tasks[t].len = 0; }
+        }
+        ok = formatted;
+        for (t = 0; ok && t < task_count; t++) {
+            if (tasks[t].len > 0 && fwrite(tasks[t].text, 1, tasks[t].len, out) != tasks[t].len) { ok = 0; }
+        }
+    }
+    for (t = 0; t < task_count; t++) {
+        free(tasks[t].text);
+        free(tasks[t].row);
+    }
+    free(tasks);
+    PROFILE_END(0);
+    return ok;
+}
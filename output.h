@@ -0,0 +1,10 @@
+/*
+ * fills row i (cols values) of whatever matrix source points to, used by output_rows() so each
+ * storage format prints through the same buffered writer
+ */
+typedef void (*output_row_fn)(const void *source, int i, double *row);
+
+#define OUTPUT_MAX_VALUE_CHARS 400 /* "%.4f" of the largest double fits */
+
+size_t output_format_fixed4(double value, char *out);
+int output_rows(FILE *out, int rows, int cols, output_row_fn fill, const void *source);
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "symnmf.h"
+#include "packed.h"
+#include "output.h"
+#include "gemm.h"
+#include "profile.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SYMM_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * ========================================SYMM_WORKSPACE_ALLOC====================================
+ * scratch space of symm_multiply(), in the GEMM_NR wide panel layout of gemm.c: H packed into
+ * panels, followed by one block of panels per thread for the transposed contributions
+*/
+static matrix* symm_workspace_alloc(int N, int k) {
+    const int panels = (k + GEMM_NR - 1) / GEMM_NR;
+    return matrix_alloc((symnmf_max_threads() + 1) * panels * N, GEMM_NR);
+}
+static matrix* packed_workspace_alloc(const w_operator *op, int k) {
+    return symm_workspace_alloc(op->N, k);
+}
+/*
+ * ========================================PRECISIONS==============================================
+ * packed_impl.h holds the storage, the kernels and the builders, instantiated here for a double
+ * W (packed_matrix) and a float W (packed_matrix_f32, the *_f32 functions)
+*/
+#define PACKED_REAL double
+#define PACKED_TYPE packed_matrix
+#define PACKED_FN(name) name
+#include "packed_impl.h"
+#undef PACKED_REAL
+#undef PACKED_TYPE
+#undef PACKED_FN
+
+#define PACKED_REAL float
+#define PACKED_TYPE packed_matrix_f32
+#define PACKED_FN(name) name##_f32
+#include "packed_impl.h"
+#undef PACKED_REAL
+#undef PACKED_TYPE
+#undef PACKED_FN
+
+/*
+ * ========================================W_OPERATOR_SCALED=======================================
+ * exposes W = diag(scale) * A * diag(scale) over a packed A without forming W: H is scaled into
+ * the workspace, multiplied by symm_multiply() and the rows of the product are scaled, 2Nk
+ * multiplies more than a packed W. the workspace is the one of symm_multiply() followed by
+ * room for the scaled H
+*/
+static matrix* scaled_workspace_alloc(const w_operator *op, int k) {
+    const int panels = (k + GEMM_NR - 1) / GEMM_NR;
+    return matrix_alloc((symnmf_max_threads() + 2) * panels * op->N, GEMM_NR);
+}
+static void scaled_multiply(const w_operator *op, const matrix *H, matrix *out, matrix *workspace) {
+    const scaled_packed *W = (const scaled_packed *)op->data;
+    const int N = op->N, k = H->cols;
+    const int panels = (k + GEMM_NR - 1) / GEMM_NR;
+    matrix symm_workspace, scaled_H;
+    int i, c;
+
+    symm_workspace = *workspace;
+    symm_workspace.rows -= panels * N; /* symm_multiply() sizes its team from the rows it gets */
+    scaled_H.rows = N;
+    scaled_H.cols = k;
+    scaled_H.stride = panels * GEMM_NR;
+    scaled_H.data = MAT_ROW(workspace, symm_workspace.rows);
+#ifdef _OPENMP
+#pragma omp parallel for private(c) schedule(static)
+#endif
+    for (i = 0; i < N; i++) {
+        for (c = 0; c < k; c++) { MAT_AT(&scaled_H, i, c) = W->scale[i] * MAT_AT(H, i, c); }
+    }
+    symm_multiply(W->A, &scaled_H, out, &symm_workspace);
+#ifdef _OPENMP
+#pragma omp parallel for private(c) schedule(static)
+#endif
+    for (i = 0; i < N; i++) {
+        for (c = 0; c < k; c++) { MAT_AT(out, i, c) *= W->scale[i]; }
+    }
+}
+static double scaled_squared_norm(const w_operator *op) {
+    const scaled_packed *W = (const scaled_packed *)op->data;
+    double diagonal = 0.0, off_diagonal = 0.0, row_sum, entry;
+    const double *row;
+    int i, j;
+    for (i = 0; i < W->A->n; i++) {
+        row = PACKED_ROW(W->A, i);
+        entry = row[0] * W->scale[i] * W->scale[i];
+        diagonal += entry * entry;
+        for (row_sum = 0.0, j = 1; j < W->A->n - i; j++) {
+            entry = row[j] * W->scale[i + j];
+            row_sum += entry * entry;
+        }
+        off_diagonal += row_sum * W->scale[i] * W->scale[i];
+    }
+    return diagonal + 2 * off_diagonal;
+}
+void w_operator_scaled(w_operator *op, const scaled_packed *W) {
+    op->N = W->A->n;
+    op->entries = (double)W->A->n * W->A->n;
+    op->data = W;
+    op->workspace_alloc = scaled_workspace_alloc;
+    op->multiply = scaled_multiply;
+    op->squared_norm = scaled_squared_norm;
+}
@@ -0,0 +1,41 @@
+/*
+ * symmetric N x N matrix with only the upper triangle (diagonal included) stored: row i holds
+ * the entries (i, i) .. (i, N-1), N(N+1)/2 doubles sharing one allocation with the header
+ */
+typedef struct {
+    int n;
+    double *data;
+} packed_matrix;
+/* the same layout in single precision, half the memory and bandwidth for W */
+typedef struct {
+    int n;
+    float *data;
+} packed_matrix_f32;
+#define PACKED_ROW(p, i) ((p)->data + (size_t)(i) * (2 * (size_t)(p)->n - (size_t)(i) + 1) / 2)
+#define PACKED_AT(p, i, j) ((i) <= (j) ? PACKED_ROW(p, i)[(j) - (i)] : PACKED_ROW(p, j)[(i) - (j)])
+/* W = diag(scale) * A * diag(scale) without storing W, the normalization of A by the degrees */
+typedef struct {
+    const packed_matrix *A;
+    const double *scale; /* n entries */
+} scaled_packed;
+#define SYMM_MR 4 /* rows of W per block of symm_multiply(), the rows one symm_span() call takes */
+
+packed_matrix* packed_alloc(int n);
+void free_packed(packed_matrix *p);
+packed_matrix* calculate_sym_packed(const matrix *data_points);
+packed_matrix* calculate_norm_packed(const matrix *data_points);
+int print_packed(const packed_matrix *p);
+double packed_mean(const packed_matrix *p);
+void w_operator_packed(w_operator *op, const packed_matrix *W);
+void w_operator_scaled(w_operator *op, const scaled_packed *W);
+void symm_span(int isa, int mr, int j0, int j1, const double *const *a_rows, const double *h_i,
+               const double *h_panel, double *part_panel, double *tile);
+packed_matrix_f32* packed_alloc_f32(int n);
+void free_packed_f32(packed_matrix_f32 *p);
+packed_matrix_f32* calculate_sym_packed_f32(const matrix *data_points);
+packed_matrix_f32* calculate_norm_packed_f32(const matrix *data_points);
+int print_packed_f32(const packed_matrix_f32 *p);
+double packed_mean_f32(const packed_matrix_f32 *p);
+void w_operator_packed_f32(w_operator *op, const packed_matrix_f32 *W);
+void symm_span_f32(int isa, int mr, int j0, int j1, const float *const *a_rows, const double *h_i,
+                   const double *h_panel, double *part_panel, double *tile);
@@ -0,0 +1,369 @@
+/*
+ * packed symmetric storage and kernels, written once for both precisions: packed.c includes
+ * this file with PACKED_REAL (double or float, the stored element), PACKED_TYPE (the matrix
+ * struct) and PACKED_FN(name) (the function name for that precision) defined
+ * only W is stored in PACKED_REAL, H, the products and every sum stay double
+ */
+/*
+ * ========================================PACKED_ALLOC============================================
+ * allocates a zero initialized packed symmetric n x n matrix, header and payload in one block
+ * returns NULL on failure, caller is the handler
+*/
+PACKED_TYPE* PACKED_FN(packed_alloc)(int n) {
+    size_t count, offset;
+    PACKED_TYPE *p;
+
+    if (n < 0) { return NULL; }
+    count = (size_t)n * ((size_t)n + 1) / 2;
+    if (count > ((size_t)-1 - sizeof(PACKED_TYPE) - MATRIX_ALIGNMENT) / sizeof(PACKED_REAL)) { return NULL; } /* size would overflow */
+    p = (PACKED_TYPE *)calloc(1, sizeof(PACKED_TYPE) + MATRIX_ALIGNMENT + count * sizeof(PACKED_REAL));
+    if (p == NULL) { return NULL; }
+    PROFILE_ALLOC(sizeof(PACKED_TYPE) + MATRIX_ALIGNMENT + count * sizeof(PACKED_REAL));
+    offset = (size_t)(p + 1) % MATRIX_ALIGNMENT;
+    p->data = (PACKED_REAL *)((char *)(p + 1) + (offset == 0 ? 0 : MATRIX_ALIGNMENT - offset));
+    p->n = n;
+    return p;
+}
+/*
+ * ========================================FREE_PACKED=============================================
+ * free a matrix allocated by packed_alloc()
+*/
+void PACKED_FN(free_packed)(PACKED_TYPE *p) {
+    free(p);
+}
+/*
+ * ========================================SYMM_SPAN_SCALAR========================================
+ * columns j0 .. j1-1 of rows r0 .. r0+mr-1 of a block against one GEMM_NR wide panel of H
+ * every W entry is loaded once and used twice: W_ij*H_j is summed into the tile of out rows,
+ * W_ij*H_i into the partials of row j. a_rows[r][j] = W(i0 + r, j), h_i holds the panel rows
+ * of the block. portable version, also used for blocks shorter than SYMM_MR
+*/
+static void PACKED_FN(symm_span_scalar)(int mr, int j0, int j1, const PACKED_REAL *const *a_rows, const double *h_i,
+                      const double *h_panel, double *part_panel, double *tile) {
+    double acc[SYMM_MR * GEMM_NR], t[GEMM_NR];
+    const double *b;
+    double *p;
+    double a;
+    int r, j, c;
+
+    for (c = 0; c < mr * GEMM_NR; c++) { acc[c] = tile[c]; }
+    for (j = j0; j < j1; j++) {
+        b = h_panel + (size_t)j * GEMM_NR;
+        for (c = 0; c < GEMM_NR; c++) { t[c] = 0.0; }
+        for (r = 0; r < mr; r++) {
+            a = a_rows[r][j];
+            for (c = 0; c < GEMM_NR; c++) {
+                acc[r * GEMM_NR + c] += a * b[c];
+                t[c] += a * h_i[r * GEMM_NR + c];
+            }
+        }
+        p = part_panel + (size_t)j * GEMM_NR;
+        for (c = 0; c < GEMM_NR; c++) { p[c] += t[c]; }
+    }
+    for (c = 0; c < mr * GEMM_NR; c++) { tile[c] = acc[c]; }
+}
+#ifdef SYMM_X86
+/*
+ * ========================================SYMM_SPAN_AVX2==========================================
+ * symm_span_scalar() for two rows, every GEMM_NR wide row is held in two ymm registers
+*/
+__attribute__((target("avx2,fma")))
+static void PACKED_FN(symm_span_avx2)(int j0, int j1, const PACKED_REAL *const *a_rows, const double *h_i,
+                      const double *h_panel, double *part_panel, double *tile) {
+    __m256d c00 = _mm256_loadu_pd(tile), c01 = _mm256_loadu_pd(tile + 4);
+    __m256d c10 = _mm256_loadu_pd(tile + 8), c11 = _mm256_loadu_pd(tile + 12);
+    const __m256d h00 = _mm256_loadu_pd(h_i), h01 = _mm256_loadu_pd(h_i + 4);
+    const __m256d h10 = _mm256_loadu_pd(h_i + 8), h11 = _mm256_loadu_pd(h_i + 12);
+    const PACKED_REAL *a0 = a_rows[0], *a1 = a_rows[1];
+    __m256d b0, b1, a, t0, t1;
+    double *p;
+    int j;
+
+    for (j = j0; j < j1; j++) {
+        b0 = _mm256_loadu_pd(h_panel + (size_t)j * GEMM_NR);
+        b1 = _mm256_loadu_pd(h_panel + (size_t)j * GEMM_NR + 4);
+        a = _mm256_set1_pd(a0[j]);
+        c00 = _mm256_fmadd_pd(a, b0, c00); c01 = _mm256_fmadd_pd(a, b1, c01);
+        t0 = _mm256_mul_pd(a, h00); t1 = _mm256_mul_pd(a, h01);
+        a = _mm256_set1_pd(a1[j]);
+        c10 = _mm256_fmadd_pd(a, b0, c10); c11 = _mm256_fmadd_pd(a, b1, c11);
+        t0 = _mm256_fmadd_pd(a, h10, t0); t1 = _mm256_fmadd_pd(a, h11, t1);
+        p = part_panel + (size_t)j * GEMM_NR;
+        _mm256_storeu_pd(p, _mm256_add_pd(_mm256_loadu_pd(p), t0));
+        _mm256_storeu_pd(p + 4, _mm256_add_pd(_mm256_loadu_pd(p + 4), t1));
+    }
+    _mm256_storeu_pd(tile, c00); _mm256_storeu_pd(tile + 4, c01);
+    _mm256_storeu_pd(tile + 8, c10); _mm256_storeu_pd(tile + 12, c11);
+}
+/*
+ * ========================================SYMM_SPAN_AVX512========================================
+ * symm_span_scalar() for SYMM_MR rows, one zmm register per GEMM_NR wide row
+*/
+__attribute__((target("avx512f")))
+static void PACKED_FN(symm_span_avx512)(int j0, int j1, const PACKED_REAL *const *a_rows, const double *h_i,
+                      const double *h_panel, double *part_panel, double *tile) {
+    __m512d c0 = _mm512_loadu_pd(tile), c1 = _mm512_loadu_pd(tile + 8);
+    __m512d c2 = _mm512_loadu_pd(tile + 16), c3 = _mm512_loadu_pd(tile + 24);
+    const __m512d h0 = _mm512_loadu_pd(h_i), h1 = _mm512_loadu_pd(h_i + 8);
+    const __m512d h2 = _mm512_loadu_pd(h_i + 16), h3 = _mm512_loadu_pd(h_i + 24);
+    const PACKED_REAL *a0 = a_rows[0], *a1 = a_rows[1], *a2 = a_rows[2], *a3 = a_rows[3];
+    __m512d b, a, t;
+    double *p;
+    int j;
+
+    for (j = j0; j < j1; j++) {
+        b = _mm512_loadu_pd(h_panel + (size_t)j * GEMM_NR);
+        a = _mm512_set1_pd(a0[j]); c0 = _mm512_fmadd_pd(a, b, c0); t = _mm512_mul_pd(a, h0);
+        a = _mm512_set1_pd(a1[j]); c1 = _mm512_fmadd_pd(a, b, c1); t = _mm512_fmadd_pd(a, h1, t);
+        a = _mm512_set1_pd(a2[j]); c2 = _mm512_fmadd_pd(a, b, c2); t = _mm512_fmadd_pd(a, h2, t);
+        a = _mm512_set1_pd(a3[j]); c3 = _mm512_fmadd_pd(a, b, c3); t = _mm512_fmadd_pd(a, h3, t);
+        p = part_panel + (size_t)j * GEMM_NR;
+        _mm512_storeu_pd(p, _mm512_add_pd(_mm512_loadu_pd(p), t));
+    }
+    _mm512_storeu_pd(tile, c0); _mm512_storeu_pd(tile + 8, c1);
+    _mm512_storeu_pd(tile + 16, c2); _mm512_storeu_pd(tile + 24, c3);
+}
+#endif
+/*
+ * ========================================SYMM_SPAN===============================================
+ * columns j0 .. j1-1 of mr rows against one GEMM_NR wide panel of H through the widest span kernel
+ * a_rows[r][j] = W(i0 + r, j) for j0 <= j < j1, tile holds the mr accumulated out rows
+*/
+void PACKED_FN(symm_span)(int isa, int mr, int j0, int j1, const PACKED_REAL *const *a_rows, const double *h_i,
+                          const double *h_panel, double *part_panel, double *tile) {
+    if (mr < SYMM_MR || isa == GEMM_ISA_SCALAR) { PACKED_FN(symm_span_scalar)(mr, j0, j1, a_rows, h_i, h_panel, part_panel, tile); }
+#ifdef SYMM_X86
+    else if (isa == GEMM_ISA_AVX512) { PACKED_FN(symm_span_avx512)(j0, j1, a_rows, h_i, h_panel, part_panel, tile); }
+    else { /* two rows at a time keep the avx2 kernel inside 16 registers */
+        PACKED_FN(symm_span_avx2)(j0, j1, a_rows, h_i, h_panel, part_panel, tile);
+        PACKED_FN(symm_span_avx2)(j0, j1, a_rows + 2, h_i + 2 * GEMM_NR, h_panel, part_panel, tile + 2 * GEMM_NR);
+    }
+#endif
+}
+/*
+ * ========================================SYMM_BLOCK_KERNEL=======================================
+ * rows i0 .. i0+mr-1 of W against one GEMM_NR wide panel of H, the result lands in tile
+ * entries inside the block (the small triangle) go to the tile only, since those out rows are
+ * all owned by the caller, the columns right of the block go through the widest span kernel
+*/
+static void PACKED_FN(symm_block_kernel)(int isa, const PACKED_TYPE *W, int i0, int mr, const double *h_panel, double *part_panel, double *tile) {
+    const PACKED_REAL *a_rows[SYMM_MR]; /* a_rows[r][j] = W(i0 + r, j) for every j >= i0 + r */
+    double h_i[SYMM_MR * GEMM_NR];
+    double a;
+    int r, s, c;
+
+    for (r = 0; r < mr; r++) {
+        a_rows[r] = PACKED_ROW(W, i0 + r) - (i0 + r);
+        for (c = 0; c < GEMM_NR; c++) {
+            h_i[r * GEMM_NR + c] = h_panel[(size_t)(i0 + r) * GEMM_NR + c];
+            tile[r * GEMM_NR + c] = 0.0;
+        }
+    }
+    for (r = 0; r < mr; r++) { /* triangle inside the block, diagonal included */
+        for (s = r; s < mr; s++) {
+            a = a_rows[r][i0 + s];
+            for (c = 0; c < GEMM_NR; c++) { tile[r * GEMM_NR + c] += a * h_i[s * GEMM_NR + c]; }
+            if (s == r) { continue; }
+            for (c = 0; c < GEMM_NR; c++) { tile[s * GEMM_NR + c] += a * h_i[r * GEMM_NR + c]; }
+        }
+    }
+    PACKED_FN(symm_span)(isa, mr, i0 + mr, W->n, a_rows, h_i, h_panel, part_panel, tile);
+}
+/*
+ * ========================================SYMM_MULTIPLY===========================================
+ * out = W*H for packed symmetric W, reading every stored entry once
+ * blocks of SYMM_MR rows are dealt round robin to the threads. the contributions of a block to
+ * its own rows go straight into out, the transposed ones into the thread's own partials, which
+ * are added to out in thread order once all blocks are done, so a fixed thread count gives
+ * fixed results. workspace must come from symm_workspace_alloc()
+*/
+static void PACKED_FN(symm_multiply)(const PACKED_TYPE *W, const matrix *H, matrix *out, matrix *workspace) {
+    const int N = W->n, k = H->cols;
+    const int panels = (k + GEMM_NR - 1) / GEMM_NR;
+    const size_t panel_rows = (size_t)panels * N;
+    const int isa = gemm_detect_isa();
+    int i, j, r, c, q, t, threads, mr, width;
+    double tile[SYMM_MR * GEMM_NR];
+    double *part, *out_row;
+    matrix packed_H; /* view of the first panels * N rows of the workspace */
+
+    if (N == 0) { return; }
+    packed_H = *workspace;
+    packed_H.rows = (int)panel_rows;
+#ifdef _OPENMP
+#pragma omp parallel private(i, j, r, c, q, t, threads, mr, width, tile, part, out_row) num_threads((int)(workspace->rows / panel_rows) - 1)
+#endif
+    {
+#ifdef _OPENMP
+        t = omp_get_thread_num(); threads = omp_get_num_threads();
+#else
+        t = 0; threads = 1;
+#endif
+        gemm_pack_b(H, &packed_H); /* shared among the team, ends with a barrier */
+        part = MAT_ROW(workspace, (1 + (size_t)t) * panel_rows);
+        for (j = 0; j < (int)panel_rows * GEMM_NR; j++) { part[j] = 0.0; }
+        /* blocks get shorter with i, a small round robin chunk keeps the threads balanced */
+#ifdef _OPENMP
+#pragma omp for schedule(static, 4)
+#endif
+        for (i = 0; i < N; i += SYMM_MR) {
+            mr = N - i < SYMM_MR ? N - i : SYMM_MR;
+            for (q = 0; q < panels; q++) {
+                PACKED_FN(symm_block_kernel)(isa, W, i, mr, MAT_ROW(&packed_H, (size_t)q * N), part + (size_t)q * N * GEMM_NR, tile);
+                width = k - q * GEMM_NR < GEMM_NR ? k - q * GEMM_NR : GEMM_NR;
+                for (r = 0; r < mr; r++) {
+                    out_row = MAT_ROW(out, i + r) + q * GEMM_NR;
+                    for (c = 0; c < width; c++) { out_row[c] = tile[r * GEMM_NR + c]; }
+                }
+            }
+        }
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (j = 0; j < N; j++) { /* add the transposed contributions, thread 0 first */
+            out_row = MAT_ROW(out, j);
+            for (t = 0; t < threads; t++) {
+                part = MAT_ROW(workspace, (1 + (size_t)t) * panel_rows);
+                for (q = 0; q < panels; q++) {
+                    width = k - q * GEMM_NR < GEMM_NR ? k - q * GEMM_NR : GEMM_NR;
+                    for (c = 0; c < width; c++) { out_row[q * GEMM_NR + c] += part[((size_t)q * N + j) * GEMM_NR + c]; }
+                }
+            }
+        }
+    }
+}
+/*
+ * ========================================FILL_PACKED_SIMILARITY==================================
+ * populates the upper triangle of A using formula 1.1, exp is evaluated once per pair
+*/
+static void PACKED_FN(fill_packed_similarity)(const matrix *data_points, PACKED_TYPE *A) {
+    const int N = data_points->rows, d = data_points->cols;
+    int i, j;
+    PACKED_REAL *row;
+    const double *point;
+
+#ifdef _OPENMP
+#pragma omp parallel for private(j, row, point) schedule(dynamic, 16)
+#endif
+    for (i = 0; i < N; i++) {
+        row = PACKED_ROW(A, i);
+        point = MAT_ROW(data_points, i);
+        row[0] = 0; /* same point */
+        for (j = i + 1; j < N; j++) {
+            row[j - i] = exp(-squared_euclidean_distance(point, MAT_ROW(data_points, j), d) / 2.0);
+        }
+    }
+}
+/*
+ * ===================================CALCULATE_SYM_PACKED=========================================
+ * packed counterpart of calculate_sym_matrix(), half the memory and half the exp calls
+*/
+PACKED_TYPE* PACKED_FN(calculate_sym_packed)(const matrix *data_points) {
+    PACKED_TYPE *sym_matrix;
+    PROFILE_BEGIN("similarity");
+    sym_matrix = PACKED_FN(packed_alloc)(data_points->rows);
+    if (sym_matrix != NULL) { PACKED_FN(fill_packed_similarity)(data_points, sym_matrix); }
+    PROFILE_END(PROFILE_PAIRS(data_points->rows) * PROFILE_KERNEL_FLOPS(data_points->cols));
+    return sym_matrix; /* NULL on failure, caller is the handler */
+}
+/*
+ * ===================================CALCULATE_NORM_PACKED========================================
+ * packed counterpart of calculate_norm_matrix(), A is built in place, its row sums are taken
+ * with symm_multiply() against a vector of ones and the buffer is scaled in place to W
+*/
+PACKED_TYPE* PACKED_FN(calculate_norm_packed)(const matrix *data_points) {
+    const int N = data_points->rows;
+    int i, j;
+    PACKED_REAL *row;
+    double sqrt_i;
+    PACKED_TYPE *norm_matrix;
+    matrix *ones, *sqrt_degrees, *workspace;
+
+    norm_matrix = PACKED_FN(calculate_sym_packed)(data_points);
+    if (norm_matrix == NULL) { return NULL; } /* caller is the handler */
+    ones = matrix_alloc(N, 1);
+    sqrt_degrees = matrix_alloc(N, 1);
+    workspace = symm_workspace_alloc(N, 1);
+    if (ones == NULL || sqrt_degrees == NULL || workspace == NULL) {
+        PACKED_FN(free_packed)(norm_matrix); free_matrix(ones); free_matrix(sqrt_degrees); free_matrix(workspace);
+        return NULL;
+    }
+    PROFILE_BEGIN("degrees");
+    for (i = 0; i < N; i++) { MAT_AT(ones, i, 0) = 1.0; }
+    PACKED_FN(symm_multiply)(norm_matrix, ones, sqrt_degrees, workspace); /* row sums of A, the degrees */
+    for (i = 0; i < N; i++) { MAT_AT(sqrt_degrees, i, 0) = sqrt(MAT_AT(sqrt_degrees, i, 0)); }
+    PROFILE_END(2.0 * N * N);
+    free_matrix(ones); free_matrix(workspace);
+    PROFILE_BEGIN("normalize");
+#ifdef _OPENMP
+#pragma omp parallel for private(j, row, sqrt_i) schedule(dynamic, 16)
+#endif
+    for (i = 0; i < N; i++) {
+        row = PACKED_ROW(norm_matrix, i);
+        sqrt_i = MAT_AT(sqrt_degrees, i, 0);
+        for (j = i; j < N; j++) { /* W_ij = A_ij/(sqrt(degree_i) * sqrt(degree_j)) */
+            if (sqrt_i == 0 || MAT_AT(sqrt_degrees, j, 0) == 0) { row[j - i] = 0; } /* avoid division by zero */
+            else { row[j - i] = row[j - i] / (sqrt_i * MAT_AT(sqrt_degrees, j, 0)); }
+        }
+    }
+    PROFILE_END(2 * (PROFILE_PAIRS(N) + N));
+    free_matrix(sqrt_degrees);
+    return norm_matrix;
+}
+/*
+ * ========================================PACKED_MEAN=============================================
+ * mean of all N^2 entries of the symmetric matrix, each off diagonal entry counts twice
+*/
+double PACKED_FN(packed_mean)(const PACKED_TYPE *p) {
+    double diagonal = 0.0, off_diagonal = 0.0;
+    const PACKED_REAL *row;
+    int i, j;
+    for (i = 0; i < p->n; i++) {
+        row = PACKED_ROW(p, i);
+        diagonal += row[0];
+        for (j = 1; j < p->n - i; j++) { off_diagonal += row[j]; }
+    }
+    return (diagonal + 2 * off_diagonal) / ((double)p->n * p->n);
+}
+/*
+ * ========================================PRINT_PACKED============================================
+ * print the full symmetric matrix in the print_matrix() format
+ * returns 1 on success, 0 if the output could not be written
+*/
+static void PACKED_FN(fill_packed_row)(const void *source, int i, double *row) {
+    const PACKED_TYPE *p = (const PACKED_TYPE *)source;
+    const PACKED_REAL *upper = PACKED_ROW(p, i);
+    int j;
+    for (j = 0; j < i; j++) { row[j] = PACKED_ROW(p, j)[i - j]; }
+    for (j = i; j < p->n; j++) { row[j] = upper[j - i]; }
+}
+int PACKED_FN(print_packed)(const PACKED_TYPE *p) {
+    return output_rows(stdout, p->n, p->n, PACKED_FN(fill_packed_row), p);
+}
+/*
+ * ========================================W_OPERATOR_PACKED=======================================
+ * exposes a packed W to optimize_h_op(), the numerator goes through symm_multiply()
+*/
+static void PACKED_FN(packed_multiply)(const w_operator *op, const matrix *H, matrix *out, matrix *workspace) {
+    PACKED_FN(symm_multiply)((const PACKED_TYPE *)op->data, H, out, workspace);
+}
+static double PACKED_FN(packed_squared_norm)(const w_operator *op) {
+    const PACKED_TYPE *W = (const PACKED_TYPE *)op->data;
+    double diagonal = 0.0, off_diagonal = 0.0;
+    const PACKED_REAL *row;
+    int i, j;
+    for (i = 0; i < W->n; i++) {
+        row = PACKED_ROW(W, i);
+        diagonal += row[0] * row[0];
+        for (j = 1; j < W->n - i; j++) { off_diagonal += row[j] * row[j]; }
+    }
+    return diagonal + 2 * off_diagonal;
+}
+void PACKED_FN(w_operator_packed)(w_operator *op, const PACKED_TYPE *W) {
+    op->N = W->n;
+    op->entries = (double)W->n * W->n;
+    op->data = W;
+    op->workspace_alloc = packed_workspace_alloc;
+    op->multiply = PACKED_FN(packed_multiply);
+    op->squared_norm = PACKED_FN(packed_squared_norm);
+}
@@ -0,0 +1,233 @@
+#define _POSIX_C_SOURCE 200112L /* pthread_mutex_t, pthread_self */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "profile.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#define PROFILE_PTHREAD
+#include <pthread.h>
+#endif
+
+/* open stages, their start time and the allocation total when they began */
+typedef struct {
+    int stage;
+    double start;
+    double bytes_at_start;
+} profile_frame;
+
+static profile_stage stages[PROFILE_MAX_STAGES];
+static int stage_count = 0;
+static profile_frame frames[PROFILE_MAX_DEPTH];
+static int depth = 0;
+static double allocated = 0.0;    /* bytes allocated since the last reset */
+static double iteration_mark = 0.0;
+static double *iterations = NULL; /* seconds, residual and flops of each iteration */
+static int iteration_count = 0, iteration_capacity = 0;
+#ifdef PROFILE_PTHREAD
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER; /* guards everything above */
+static pthread_t owner;                                  /* the recording thread while depth > 0 */
+#define PROFILE_LOCK() pthread_mutex_lock(&lock)
+#define PROFILE_UNLOCK() pthread_mutex_unlock(&lock)
+#else
+#define PROFILE_LOCK() ((void)0)
+#define PROFILE_UNLOCK() ((void)0)
+#endif
+
+/*
+ * ========================================PROFILE_NOW=============================================
+ * wall clock seconds, omp_get_wtime() when OpenMP is there, processor time otherwise
+*/
+static double profile_now(void) {
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+/*
+ * ========================================PROFILE_RECORDING=======================================
+ * 1 if the calling thread may record, called with the lock held. threads inside a parallel region
+ * never record. outside of one, the thread that opens a stage while none is open owns the record
+ * until it closes that stage, any other thread is ignored meanwhile
+*/
+static int profile_recording(void) {
+#ifdef _OPENMP
+    if (omp_in_parallel()) { return 0; }
+#endif
+#ifdef PROFILE_PTHREAD
+    if (depth == 0) { owner = pthread_self(); }
+    return pthread_equal(owner, pthread_self());
+#else
+    return 1;
+#endif
+}
+/*
+ * ========================================PROFILE_BEGIN===========================================
+ * opens the stage with the given name (a string literal, compared by content), nested in the
+ * stages already open. stages past PROFILE_MAX_DEPTH or PROFILE_MAX_STAGES are not recorded
+*/
+void profile_begin(const char *stage) {
+    int s;
+    PROFILE_LOCK();
+    if (!profile_recording()) { PROFILE_UNLOCK(); return; }
+    if (depth >= PROFILE_MAX_DEPTH) { depth++; PROFILE_UNLOCK(); return; }
+    for (s = 0; s < stage_count; s++) {
+        const char *a = stages[s].name, *b = stage;
+        while (*a != '\0' && *a == *b) { a++; b++; }
+        if (*a == *b) { break; }
+    }
+    if (s == stage_count && stage_count < PROFILE_MAX_STAGES) {
+        stages[s].name = stage;
+        stages[s].calls = 0;
+        stages[s].seconds = stages[s].bytes = stages[s].flops = 0.0;
+        stage_count++;
+    }
+    frames[depth].stage = s < stage_count ? s : -1;
+    frames[depth].bytes_at_start = allocated;
+    frames[depth].start = iteration_mark = profile_now();
+    depth++;
+    PROFILE_UNLOCK();
+}
+/*
+ * ========================================PROFILE_END=============================================
+ * closes the innermost open stage, adding its time, allocations and the given FLOP estimate
+*/
+void profile_end(double flops) {
+    profile_frame *frame;
+    PROFILE_LOCK();
+    if (depth > 0 && profile_recording()) {
+        depth--;
+        frame = depth < PROFILE_MAX_DEPTH ? &frames[depth] : NULL;
+        if (frame != NULL && frame->stage >= 0) {
+            stages[frame->stage].calls++;
+            stages[frame->stage].seconds += profile_now() - frame->start;
+            stages[frame->stage].bytes += allocated - frame->bytes_at_start;
+            stages[frame->stage].flops += flops;
+        }
+    }
+    PROFILE_UNLOCK();
+}
+/*
+ * ========================================PROFILE_ALLOC===========================================
+ * counts an allocation, from any thread, so the bytes of a stage include what threads running
+ * beside its owner allocated meanwhile
+*/
+void profile_alloc(double bytes) {
+#ifdef PROFILE_PTHREAD
+    PROFILE_LOCK();
+    allocated += bytes;
+    PROFILE_UNLOCK();
+#else
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+    allocated += bytes;
+#endif
+}
+/*
+ * ========================================PROFILE_ITERATION=======================================
+ * records an iteration that ended now: the time since the previous one (or since the innermost
+ * stage began), its residual and its FLOP estimate. iterations are kept if memory runs out
+*/
+void profile_iteration(double residual, double flops) {
+    const double now = profile_now();
+    double *grown;
+    int capacity;
+    PROFILE_LOCK();
+    if (depth == 0 || !profile_recording()) { PROFILE_UNLOCK(); return; } /* iterations run inside a stage */
+    if (iteration_count == iteration_capacity) {
+        capacity = 2 * iteration_capacity + 64;
+        grown = (double *)realloc(iterations, (size_t)capacity * 3 * sizeof(double));
+        if (grown == NULL) { PROFILE_UNLOCK(); return; }
+        iterations = grown;
+        iteration_capacity = capacity;
+    }
+    iterations[3 * iteration_count] = now - iteration_mark;
+    iterations[3 * iteration_count + 1] = residual;
+    iterations[3 * iteration_count + 2] = flops;
+    iteration_count++;
+    iteration_mark = now;
+    PROFILE_UNLOCK();
+}
+/*
+ * ========================================PROFILE_RESET===========================================
+ * forgets every stage and iteration recorded so far, stages still open are dropped
+*/
+static void reset_locked(void) {
+    stage_count = 0;
+    depth = 0;
+    allocated = 0.0;
+    iteration_count = 0;
+}
+void profile_reset(void) {
+    PROFILE_LOCK();
+    reset_locked();
+    PROFILE_UNLOCK();
+}
+/*
+ * ========================================PROFILE_SNAPSHOT_TAKE===================================
+ * a copy of everything recorded so far, taken in one go while recording threads wait, with reset
+ * the record is cleared in the same step so nothing recorded in between is lost
+ * returns NULL if memory runs out, caller is the handler
+*/
+profile_snapshot* profile_snapshot_take(int reset) {
+    profile_snapshot *snapshot = (profile_snapshot *)malloc(sizeof(profile_snapshot));
+    if (snapshot == NULL) { return NULL; }
+    PROFILE_LOCK();
+    snapshot->stage_count = stage_count;
+    memcpy(snapshot->stages, stages, (size_t)stage_count * sizeof(profile_stage));
+    snapshot->iteration_count = iteration_count;
+    snapshot->iterations = (double *)malloc((size_t)(iteration_count > 0 ? iteration_count : 1) * 3 * sizeof(double));
+    if (snapshot->iterations != NULL) {
+        memcpy(snapshot->iterations, iterations, (size_t)iteration_count * 3 * sizeof(double));
+        if (reset) { reset_locked(); }
+    }
+    PROFILE_UNLOCK();
+    if (snapshot->iterations == NULL) { free(snapshot); return NULL; }
+    return snapshot;
+}
+void profile_snapshot_free(profile_snapshot *snapshot) {
+    if (snapshot == NULL) { return; }
+    free(snapshot->iterations);
+    free(snapshot);
+}
+/*
+ * ========================================PROFILE_WRITE_JSON======================================
+ * writes everything recorded as one JSON object:
+ *   {"enabled": true, "stages": {"<name>": {"calls", "seconds", "bytes", "flops"}, ...},
+ *    "iterations": {"seconds": [...], "residual": [...], "flops": [...]}}
+ * enabled is false (and nothing is recorded) unless compiled with SYMNMF_PROFILE
+ * returns 1 on success, 0 if the write fails or memory runs out
+*/
+int profile_write_json(FILE *out) {
+    static const char *series[3] = {"seconds", "residual", "flops"};
+    profile_snapshot *snapshot = profile_snapshot_take(0);
+    const profile_stage *stages;
+    const double *iterations;
+    int s, i, ok;
+    if (snapshot == NULL) { return 0; }
+    stages = snapshot->stages; iterations = snapshot->iterations; /* the copies shadow the live record */
+    ok = fprintf(out, "{\"enabled\": %s, \"stages\": {", PROFILE_ENABLED ? "true" : "false") > 0;
+    for (s = 0; ok && s < snapshot->stage_count; s++) {
+        ok = fprintf(out, "%s\"%s\": {\"calls\": %ld, \"seconds\": %.9g, \"bytes\": %.17g, \"flops\": %.17g}", s > 0 ? ", " : "",
+                stages[s].name, stages[s].calls, stages[s].seconds, stages[s].bytes, stages[s].flops) > 0;
+    }
+    ok = ok && fprintf(out, "}, \"iterations\": {") > 0;
+    for (s = 0; ok && s < 3; s++) {
+        ok = fprintf(out, "%s\"%s\": [", s > 0 ? ", " : "", series[s]) > 0;
+        for (i = 0; ok && i < snapshot->iteration_count; i++) {
+            if (iterations[3 * i + s] - iterations[3 * i + s] == 0.0) { /* finite */
+                ok = fprintf(out, "%s%.9g", i > 0 ? ", " : "", iterations[3 * i + s]) > 0;
+            }
+            else { ok = fprintf(out, "%snull", i > 0 ? ", " : "") > 0; } /* JSON has no nan or inf */
+        }
+        ok = ok && fprintf(out, "]") > 0;
+    }
+    ok = ok && fprintf(out, "}}\n") > 0;
+    profile_snapshot_free(snapshot);
+    return ok;
+}
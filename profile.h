@@ -0,0 +1,56 @@
+/*
+ * per stage and per iteration instrumentation: wall time, bytes allocated and estimated FLOPs
+ * of every named stage, and the time, FLOPs and residual of every iteration of optimize_h_run()
+ * it is compiled in with -DSYMNMF_PROFILE (make profile, SYMNMF_PROFILE=1 for setup.py), without
+ * it the PROFILE_ macros expand to nothing and their arguments are never evaluated
+ * one thread records at a time: the thread that opens a stage while none is open owns the record
+ * until it closes that stage, stages it opens meanwhile nest. other threads (a second python
+ * thread running a clustering, the threads of a parallel region, so also the iterations of
+ * symnmf_batch() jobs) are not recorded while it does. a mutex guards the record, read it through
+ * a snapshot
+ */
+#ifdef SYMNMF_PROFILE
+#define PROFILE_ENABLED 1
+#define PROFILE_BEGIN(stage) profile_begin(stage)
+#define PROFILE_END(flops) profile_end((double)(flops))
+#define PROFILE_ALLOC(bytes) profile_alloc((double)(bytes))
+#define PROFILE_ITERATION(residual, flops) profile_iteration((double)(residual), (double)(flops))
+#else
+#define PROFILE_ENABLED 0
+#define PROFILE_BEGIN(stage) ((void)0)
+#define PROFILE_END(flops) ((void)0)
+#define PROFILE_ALLOC(bytes) ((void)0)
+#define PROFILE_ITERATION(residual, flops) ((void)0)
+#endif
+
+#define PROFILE_MAX_STAGES 32 /* distinct stage names, later ones are not recorded */
+#define PROFILE_MAX_DEPTH 8   /* stages open at once */
+#define PROFILE_EXP_FLOPS 20  /* what one exp() is counted as in the estimates */
+#define PROFILE_PAIRS(N) ((double)(N) * ((N) - 1) / 2)
+#define PROFILE_KERNEL_FLOPS(d) (3.0 * (d) + PROFILE_EXP_FLOPS) /* distance, scaling and exp of one pair */
+
+/* totals of one stage name over every time it ran, times include nested stages */
+typedef struct {
+    const char *name;
+    long calls;
+    double seconds;
+    double bytes; /* allocated while it ran */
+    double flops;
+} profile_stage;
+
+void profile_begin(const char *stage);
+void profile_end(double flops);
+void profile_alloc(double bytes);
+void profile_iteration(double residual, double flops);
+/* a copy of the record, consistent even while other threads record */
+typedef struct {
+    int stage_count;
+    profile_stage stages[PROFILE_MAX_STAGES]; /* in the order they first ran */
+    int iteration_count;
+    double *iterations; /* seconds, residual and flops of each iteration, in the order they ran */
+} profile_snapshot;
+
+void profile_reset(void);
+profile_snapshot* profile_snapshot_take(int reset);
+void profile_snapshot_free(profile_snapshot *snapshot);
+int profile_write_json(FILE *out);
@@ -0,0 +1,51 @@
+#include "rng.h"
+
+#define MT_SHIFT 397
+#define MT_MATRIX_A 0x9908b0dfUL
+#define MT_UPPER_MASK 0x80000000UL
+#define MT_LOWER_MASK 0x7fffffffUL
+#define MT_WORD 0xffffffffUL
+
+/*
+ * ========================================MT_SEED=================================================
+ * init_genrand() of the reference MT19937, what np.random.seed(seed) does for 0 <= seed < 2^32
+*/
+void mt_seed(mt_state *state, unsigned long seed) {
+    int i;
+    state->key[0] = seed & MT_WORD;
+    for (i = 1; i < MT_STATE_SIZE; i++) {
+        state->key[i] = (1812433253UL * (state->key[i - 1] ^ (state->key[i - 1] >> 30)) + (unsigned long)i) & MT_WORD;
+    }
+    state->pos = MT_STATE_SIZE;
+}
+/*
+ * ========================================MT_NEXT32===============================================
+ * next 32 bit output, the whole state is regenerated every MT_STATE_SIZE draws
+*/
+static void mt_generate(mt_state *state) {
+    unsigned long y;
+    int i;
+    for (i = 0; i < MT_STATE_SIZE; i++) {
+        y = (state->key[i] & MT_UPPER_MASK) | (state->key[(i + 1) % MT_STATE_SIZE] & MT_LOWER_MASK);
+        state->key[i] = state->key[(i + MT_SHIFT) % MT_STATE_SIZE] ^ (y >> 1) ^ ((y & 1UL) ? MT_MATRIX_A : 0UL);
+    }
+    state->pos = 0;
+}
+unsigned long mt_next32(mt_state *state) {
+    unsigned long y;
+    if (state->pos == MT_STATE_SIZE) { mt_generate(state); }
+    y = state->key[state->pos++];
+    y ^= y >> 11;
+    y ^= (y << 7) & 0x9d2c5680UL;
+    y ^= (y << 15) & 0xefc60000UL;
+    y ^= y >> 18;
+    return y & MT_WORD;
+}
+/*
+ * ========================================MT_NEXT_DOUBLE==========================================
+ * uniform double in [0, 1) with 53 random bits, genrand_res53() as numpy's random_sample uses it
+*/
+double mt_next_double(mt_state *state) {
+    const unsigned long a = mt_next32(state) >> 5, b = mt_next32(state) >> 6;
+    return ((double)a * 67108864.0 + (double)b) / 9007199254740992.0;
+}
@@ -0,0 +1,14 @@
+/*
+ * MT19937 generator seeded and sampled like numpy's legacy np.random.seed / np.random.uniform,
+ * so a given seed gives the same initial H in C as in symnmf.py
+ */
+#define MT_STATE_SIZE 624
+
+typedef struct {
+    unsigned long key[MT_STATE_SIZE]; /* 32 bit words, unsigned long is at least 32 bits */
+    int pos;
+} mt_state;
+
+void mt_seed(mt_state *state, unsigned long seed);
+unsigned long mt_next32(mt_state *state);
+double mt_next_double(mt_state *state);
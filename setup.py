@@ -1,11 +1,29 @@
+import os
 from setuptools import Extension, setup
 
 module = Extension(
     'symnmf', 
     sources=[
         'symnmf.c',
+        'gemm.c',
+        'packed.c',
+        'sparse.c',
+        'csv.c',
+        'matfile.c',
+        'output.c',
+        'rng.c',
+        'tiled.c',
+        'profile.c',
+        'cluster.c',
+        'incremental.c',
+        'nystrom.c',
+        'transport.c',
+        'distributed.c',
         'symnmfmodule.c'
-    ]
+    ],
+    define_macros=[('SYMNMF_PROFILE', None)] if os.environ.get('SYMNMF_PROFILE') == '1' else [], # instrumented build
+    extra_compile_args=['-fopenmp'],
+    extra_link_args=['-fopenmp']
 )
 
 setup(
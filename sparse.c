@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "symnmf.h"
+#include "sparse.h"
+#include "profile.h"
+
+/*
+ * ========================================CSR_ALLOC===============================================
+ * allocates an n x n csr matrix with room for nnz entries, header and arrays in one block
+ * row_ptr is zero initialized, returns NULL on failure, caller is the handler
+*/
+csr_matrix* csr_alloc(int n, size_t nnz) {
+    size_t ptr_bytes, col_bytes, val_bytes;
+    csr_matrix *m;
+
+    if (n < 0 || nnz > ((size_t)-1 / 4) / (sizeof(double) + sizeof(int))) { return NULL; } /* size would overflow */
+    ptr_bytes = ((size_t)n + 1) * sizeof(size_t);
+    col_bytes = (nnz * sizeof(int) + sizeof(double) - 1) / sizeof(double) * sizeof(double); /* keeps val aligned */
+    val_bytes = nnz * sizeof(double);
+    m = (csr_matrix *)calloc(1, sizeof(csr_matrix) + ptr_bytes + col_bytes + val_bytes);
+    if (m == NULL) { return NULL; }
+    PROFILE_ALLOC(sizeof(csr_matrix) + ptr_bytes + col_bytes + val_bytes);
+    m->n = n;
+    m->nnz = nnz;
+    m->row_ptr = (size_t *)(m + 1);
+    m->col = (int *)((char *)m->row_ptr + ptr_bytes);
+    m->val = (double *)((char *)m->col + col_bytes);
+    return m;
+}
+/*
+ * ========================================FREE_CSR================================================
+ * free a matrix allocated by csr_alloc()
+*/
+void free_csr(csr_matrix *m) {
+    free(m);
+}
+/*
+ * ========================================NEIGHBOR_HEAP===========================================
+ * max-heap on (distance, index) holding the closest candidates seen so far, the farthest on top
+ * ties are broken by index so the selection does not depend on the scan order
+*/
+static int farther(const double *dist, const int *idx, int a, int b) {
+    return dist[a] > dist[b] || (dist[a] == dist[b] && idx[a] > idx[b]);
+}
+static void heap_sift_down(double *dist, int *idx, int size, int pos) {
+    int child;
+    double d;
+    int i;
+    while ((child = 2 * pos + 1) < size) {
+        if (child + 1 < size && farther(dist, idx, child + 1, child)) { child++; }
+        if (!farther(dist, idx, child, pos)) { break; }
+        d = dist[pos]; dist[pos] = dist[child]; dist[child] = d;
+        i = idx[pos]; idx[pos] = idx[child]; idx[child] = i;
+        pos = child;
+    }
+}
+static void heap_push(double *dist, int *idx, int *size, int capacity, double d, int j) {
+    int pos, parent;
+    double dd;
+    int ii;
+    if (capacity == 0) { return; }
+    if (*size == capacity) { /* full, replace the farthest if the new one is closer */
+        if (d > dist[0] || (d == dist[0] && j > idx[0])) { return; }
+        dist[0] = d; idx[0] = j;
+        heap_sift_down(dist, idx, *size, 0);
+        return;
+    }
+    pos = (*size)++;
+    dist[pos] = d; idx[pos] = j;
+    while (pos > 0) {
+        parent = (pos - 1) / 2;
+        if (!farther(dist, idx, pos, parent)) { break; }
+        dd = dist[pos]; dist[pos] = dist[parent]; dist[parent] = dd;
+        ii = idx[pos]; idx[pos] = idx[parent]; idx[parent] = ii;
+        pos = parent;
+    }
+}
+/*
+ * ========================================COMPARE_INT=============================================
+ * qsort comparator for column indices
+*/
+static int compare_int(const void *a, const void *b) {
+    const int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+/*
+ * ========================================DIRECTED_NEIGHBORS======================================
+ * neighbor lists of every point, point i owns slots [offsets[i], offsets[i] + counts[i])
+ * knn mode (neighbors > 0): the neighbors closest points, optionally within radius, capacity
+ * neighbors per point. radius mode (neighbors == 0): every point within radius, a counting
+ * scan sizes the lists first. returns the list storage or NULL on failure
+*/
+static int* directed_neighbors(const matrix *data_points, int neighbors, double radius, size_t *offsets, int *counts) {
+    const int N = data_points->rows, d = data_points->cols;
+    const double radius_sq = radius * radius;
+    const int capacity = neighbors < N - 1 ? neighbors : N - 1;
+    int *lists;
+    double *heap_dist;
+    int *heap_idx;
+    int i, j, size, failed = 0;
+    double dist;
+
+    if (neighbors > 0) {
+        for (i = 0; i <= N; i++) { offsets[i] = (size_t)i * (size_t)capacity; }
+    }
+    else { /* radius only, count first */
+#ifdef _OPENMP
+#pragma omp parallel for private(j) schedule(dynamic, 16)
+#endif
+        for (i = 0; i < N; i++) {
+            counts[i] = 0;
+            for (j = 0; j < N; j++) {
+                if (j != i && squared_euclidean_distance(MAT_ROW(data_points, i), MAT_ROW(data_points, j), d) <= radius_sq) { counts[i]++; }
+            }
+        }
+        offsets[0] = 0;
+        for (i = 0; i < N; i++) { offsets[i + 1] = offsets[i] + (size_t)counts[i]; }
+    }
+    lists = (int *)malloc((offsets[N] > 0 ? offsets[N] : 1) * sizeof(int));
+    if (lists == NULL) { return NULL; }
+#ifdef _OPENMP
+#pragma omp parallel private(i, j, size, dist, heap_dist, heap_idx)
+#endif
+    {
+        heap_dist = (double *)malloc((capacity > 0 ? capacity : 1) * sizeof(double)); /* per thread heap */
+        heap_idx = (int *)malloc((capacity > 0 ? capacity : 1) * sizeof(int));
+        if (heap_dist == NULL || heap_idx == NULL) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+            failed = 1;
+        }
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+        for (i = 0; i < N; i++) {
+            if (heap_dist == NULL || heap_idx == NULL) { continue; }
+            size = 0;
+            for (j = 0; j < N; j++) {
+                if (j == i) { continue; }
+                dist = squared_euclidean_distance(MAT_ROW(data_points, i), MAT_ROW(data_points, j), d);
+                if (radius > 0 && dist > radius_sq) { continue; } /* outside the cutoff */
+                if (neighbors > 0) { heap_push(heap_dist, heap_idx, &size, capacity, dist, j); }
+                else { lists[offsets[i] + size++] = j; }
+            }
+            if (neighbors > 0) {
+                for (j = 0; j < size; j++) { lists[offsets[i] + j] = heap_idx[j]; }
+            }
+            counts[i] = size;
+        }
+        free(heap_dist); free(heap_idx);
+    }
+    if (failed) { free(lists); return NULL; }
+    return lists;
+}
+/*
+ * ========================================CALCULATE_KNN_NORM======================================
+ * sparse normalized similarity matrix W built from the neighbor graph of the points
+ * A_ij = exp(-||x_i - x_j||^2 / 2) (formula 1.1) is kept when j is a neighbor of i or i is a
+ * neighbor of j, so A stays symmetric, every other entry is treated as 0. W = D^-1/2 * A * D^-1/2
+ * exactly as in calculate_norm_matrix(). with neighbors >= N-1 and no radius the result equals
+ * the dense W. memory is O(N * neighbors), time O(N^2 * d) for the neighbor search
+*/
+csr_matrix* calculate_knn_norm(const matrix *data_points, int neighbors, double radius) {
+    const int N = data_points->rows, d = data_points->cols;
+    size_t *offsets, *sym_ptr, p, q, nnz;
+    int *counts, *lists, *sym_col, *fill;
+    double *sqrt_degrees;
+    csr_matrix *W = NULL;
+    int i, j;
+    double row_sum;
+
+    if (neighbors < 0 || (neighbors == 0 && radius <= 0)) { return NULL; } /* need at least one of the two rules */
+    offsets = (size_t *)malloc(((size_t)N + 1) * sizeof(size_t));
+    sym_ptr = (size_t *)calloc((size_t)N + 1, sizeof(size_t));
+    counts = (int *)calloc((size_t)N + 1, sizeof(int));
+    fill = (int *)calloc((size_t)N + 1, sizeof(int));
+    sqrt_degrees = (double *)malloc(((size_t)N + 1) * sizeof(double));
+    if (offsets == NULL || sym_ptr == NULL || counts == NULL || fill == NULL || sqrt_degrees == NULL) {
+        free(offsets); free(sym_ptr); free(counts); free(fill); free(sqrt_degrees);
+        return NULL; /* caller is the handler */
+    }
+    lists = directed_neighbors(data_points, neighbors, radius, offsets, counts);
+    sym_col = NULL;
+    if (lists != NULL) {
+        /* union of the directed graph and its transpose, every edge i->j lands in rows i and j */
+        for (i = 0; i < N; i++) {
+            for (p = offsets[i]; p < offsets[i] + (size_t)counts[i]; p++) { sym_ptr[i + 1]++; sym_ptr[lists[p] + 1]++; }
+        }
+        for (i = 0; i < N; i++) { sym_ptr[i + 1] += sym_ptr[i]; }
+        sym_col = (int *)malloc((sym_ptr[N] > 0 ? sym_ptr[N] : 1) * sizeof(int));
+    }
+    if (sym_col != NULL) {
+        for (i = 0; i < N; i++) {
+            for (p = offsets[i]; p < offsets[i] + (size_t)counts[i]; p++) {
+                j = lists[p];
+                sym_col[sym_ptr[i] + fill[i]++] = j;
+                sym_col[sym_ptr[j] + fill[j]++] = i;
+            }
+        }
+        /* sort every row and drop the duplicates left by mutual neighbors */
+        nnz = 0;
+        for (i = 0; i < N; i++) {
+            qsort(sym_col + sym_ptr[i], sym_ptr[i + 1] - sym_ptr[i], sizeof(int), compare_int);
+            for (p = sym_ptr[i]; p < sym_ptr[i + 1]; p++) {
+                if (p == sym_ptr[i] || sym_col[p] != sym_col[p - 1]) { nnz++; }
+            }
+        }
+        W = csr_alloc(N, nnz);
+    }
+    if (W != NULL) {
+        q = 0;
+        for (i = 0; i < N; i++) {
+            W->row_ptr[i] = q;
+            for (p = sym_ptr[i]; p < sym_ptr[i + 1]; p++) {
+                if (p == sym_ptr[i] || sym_col[p] != sym_col[p - 1]) { W->col[q++] = sym_col[p]; }
+            }
+        }
+        W->row_ptr[N] = q;
+        /* similarity values and degrees, the row sums of the sparse A */
+#ifdef _OPENMP
+#pragma omp parallel for private(p, row_sum) schedule(dynamic, 64)
+#endif
+        for (i = 0; i < N; i++) {
+            row_sum = 0.0;
+            for (p = W->row_ptr[i]; p < W->row_ptr[i + 1]; p++) {
+                W->val[p] = exp(-squared_euclidean_distance(MAT_ROW(data_points, i), MAT_ROW(data_points, W->col[p]), d) / 2.0);
+                row_sum += W->val[p];
+            }
+            sqrt_degrees[i] = sqrt(row_sum);
+        }
+#ifdef _OPENMP
+#pragma omp parallel for private(p, j) schedule(dynamic, 64)
+#endif
+        for (i = 0; i < N; i++) { /* W_ij = A_ij/(sqrt(degree_i) * sqrt(degree_j)) */
+            for (p = W->row_ptr[i]; p < W->row_ptr[i + 1]; p++) {
+                j = W->col[p];
+                if (sqrt_degrees[i] == 0 || sqrt_degrees[j] == 0) { W->val[p] = 0; } /* avoid division by zero */
+                else { W->val[p] = W->val[p] / (sqrt_degrees[i] * sqrt_degrees[j]); }
+            }
+        }
+    }
+    free(offsets); free(sym_ptr); free(counts); free(fill); free(sqrt_degrees); free(lists); free(sym_col);
+    return W;
+}
+/*
+ * ========================================CSR_MULTIPLY============================================
+ * out = W*H for a csr W, rows are independent so threads split them without any reduction
+*/
+static void csr_multiply(const w_operator *op, const matrix *H, matrix *out, matrix *workspace) {
+    const csr_matrix *W = (const csr_matrix *)op->data;
+    const int k = H->cols;
+    int i, c;
+    size_t p;
+    double *out_row;
+    const double *h_row;
+    double w;
+
+    (void)workspace; /* none needed */
+#ifdef _OPENMP
+#pragma omp parallel for private(c, p, out_row, h_row, w) schedule(dynamic, 64)
+#endif
+    for (i = 0; i < W->n; i++) {
+        out_row = MAT_ROW(out, i);
+        for (c = 0; c < k; c++) { out_row[c] = 0.0; }
+        for (p = W->row_ptr[i]; p < W->row_ptr[i + 1]; p++) {
+            w = W->val[p];
+            h_row = MAT_ROW(H, W->col[p]);
+            for (c = 0; c < k; c++) { out_row[c] += w * h_row[c]; }
+        }
+    }
+}
+/*
+ * ========================================W_OPERATOR_CSR==========================================
+ * exposes a sparse W to optimize_h_op()
+*/
+static double csr_squared_norm(const w_operator *op) {
+    const csr_matrix *W = (const csr_matrix *)op->data;
+    double sum = 0.0;
+    size_t p;
+    for (p = 0; p < W->row_ptr[W->n]; p++) { sum += W->val[p] * W->val[p]; }
+    return sum;
+}
+void w_operator_csr(w_operator *op, const csr_matrix *W) {
+    op->N = W->n;
+    op->entries = (double)W->row_ptr[W->n]; /* the stored entries, a product costs 2 * nnz * k */
+    op->data = W;
+    op->workspace_alloc = NULL;
+    op->multiply = csr_multiply;
+    op->squared_norm = csr_squared_norm;
+}
@@ -0,0 +1,19 @@
+/*
+ * N x N sparse matrix in compressed sparse row form, row i holds the entries
+ * col[row_ptr[i]] .. col[row_ptr[i+1]-1] (ascending) with values val[...]
+ * the header and the three arrays share a single allocation
+ */
+typedef struct {
+    int n;
+    size_t nnz;
+    size_t *row_ptr; /* n + 1 offsets */
+    int *col;
+    double *val;
+} csr_matrix;
+
+#define KNN_DEFAULT_NEIGHBORS 10
+
+csr_matrix* csr_alloc(int n, size_t nnz);
+void free_csr(csr_matrix *m);
+csr_matrix* calculate_knn_norm(const matrix *data_points, int neighbors, double radius);
+void w_operator_csr(w_operator *op, const csr_matrix *W);
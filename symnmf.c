@@ -1,7 +1,30 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <errno.h>
 #include "symnmf.h"
+#include "gemm.h"
+#include "packed.h"
+#include "sparse.h"
+#include "csv.h"
+#include "matfile.h"
+#include "output.h"
+#include "rng.h"
+#include "tiled.h"
+#include "nystrom.h"
+#include "transport.h"
+#include "distributed.h"
+#include "profile.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define MOMENTUM_GAMMA 0.5       /* first extrapolation weight of the momentum method */
+#define MOMENTUM_GROW 1.05       /* gamma after an extrapolation that improved the fit */
+#define MOMENTUM_GROW_MAX 1.01   /* the cap on gamma after an improvement, at most 1 */
+#define MOMENTUM_SHRINK 1.5      /* gamma after a restart is divided by it */
+#define MOMENTUM_FLOOR 1e-16     /* extrapolated entries stay positive */
+#define HALS_PENALTY 3.0         /* default penalty of hals, times the mean diagonal of init_H^T*init_H */
 
 /*
  * ========================================STRING_COMPARE==========================================
@@ -19,57 +42,85 @@ int string_compare(const char *str1, const char *str2) {
     return (*str1 == *str2); 
 }
 /*
- * ========================================READ_DATA_POINTS========================================
- * reads data points from file into a dynamically allocated 2D array
- * returns a pointer to the array and sets N (number of points) and d (dimension)
- */
-double** read_data_points(char *file_name, int *N, int *d) {
-    FILE *file;
-    double value;
-    char c;
-    int point_count = 0, dim = 0;
-    double **matrix;
-    int i, j;
-
-    file = fopen(file_name, "r");
-    if (file == NULL) {
-        printf("An Error Has Occurred\n");
-        exit(1);
-    }
-    /* count the number of points and dimension */
-    while (fscanf(file, "%lf%c", &value, &c) != EOF) { /* %lf is for floating point number and %c is for delimeter (comma or newline) */
-        if (point_count == 0) { dim++; } /* first point, count dimension */
-        if (c == '\n') { point_count++; } /* end of point */
-    }
-    if (c != '\n' && ftell(file) > 0) { point_count++; } /* in case no newline is in last line */
-    *N = point_count; *d = dim; /* used to access point_count and dim globally */
-    rewind(file); /* reset file pointer to the beginning */
-    /* allocate memory for the matrix */
-    matrix = (double **)malloc(point_count * sizeof(double *));
-    if (matrix == NULL) {
-        printf("An Error Has Occurred\n");
-        fclose(file);
-        exit(1);
+ * ========================================THREADS=================================================
+ * thread count used by the parallel sections of the calling thread, only meaningful when built
+ * with OpenMP. n <= 0 leaves the runtime default (OMP_NUM_THREADS or the number of cores)
+*/
+void symnmf_set_threads(int n) {
+#ifdef _OPENMP
+    if (n > 0) { omp_set_num_threads(n); }
+#else
+    (void)n;
+#endif
+}
+int symnmf_max_threads(void) {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+/*
+ * ===================================REDUCE_IN_THREAD_ORDER=======================================
+ * adds the len partial values of every thread into the shared total, thread 0 first, so a
+ * reduction gives the same bits on every run with the same thread count
+ * inside a parallel region it must be reached by all threads of the team
+*/
+static void reduce_in_thread_order(const double *partial, double *total, int len) {
+    int i;
+#ifdef _OPENMP
+    int t;
+#pragma omp for ordered schedule(static, 1)
+    for (t = 0; t < omp_get_num_threads(); t++) {
+#pragma omp ordered
+        for (i = 0; i < len; i++) { total[i] += partial[i]; }
     }
-    for (i = 0; i < point_count; i++) {
-        matrix[i] = (double *)malloc(dim * sizeof(double));
-        if (matrix[i] == NULL) {
-            printf("An Error Has Occured\n");
-            for (j = 0; j < i; j++) { free(matrix[j]); } /* free previously allocated rows */
-            free(matrix); fclose(file); exit(1);
-        }
+#else
+    for (i = 0; i < len; i++) { total[i] += partial[i]; }
+#endif
+}
+/*
+ * ========================================MATRIX_ALLOC============================================
+ * allocates a zero initialized rows x cols matrix, header and payload in one block
+ * the payload starts at the first MATRIX_ALIGNMENT boundary after the header
+ * returns NULL on failure, caller is the handler
+*/
+matrix* matrix_alloc(int rows, int cols) {
+    const size_t align_doubles = MATRIX_ALIGNMENT / sizeof(double);
+    size_t stride, payload, offset;
+    matrix *m;
+
+    if (rows < 0 || cols < 0) { return NULL; }
+    stride = (size_t)cols;
+    if (stride >= align_doubles) { /* pad wide rows so each one starts aligned */
+        stride = (stride + align_doubles - 1) / align_doubles * align_doubles;
     }
-    for (i = 0; i < point_count; i++) { /* populate matrix*/
-        for (j = 0; j < dim; j++) { fscanf(file, "%lf%c", &matrix[i][j], &c); }
+    if (stride != 0 && (size_t)rows > ((size_t)-1 - sizeof(matrix) - MATRIX_ALIGNMENT) / sizeof(double) / stride) {
+        return NULL; /* size would overflow */
     }
-    fclose(file);
-    return matrix;
+    payload = (size_t)rows * stride * sizeof(double);
+    m = (matrix *)calloc(1, sizeof(matrix) + MATRIX_ALIGNMENT + payload); /* calloc for the 0 initialization */
+    if (m == NULL) { return NULL; }
+    PROFILE_ALLOC(sizeof(matrix) + MATRIX_ALIGNMENT + payload);
+    offset = (size_t)(m + 1) % MATRIX_ALIGNMENT;
+    m->data = (double *)((char *)(m + 1) + (offset == 0 ? 0 : MATRIX_ALIGNMENT - offset));
+    m->rows = rows;
+    m->cols = cols;
+    m->stride = (int)stride;
+    return m;
+}
+/*
+ * ========================================FREE_MATRIX=============================================
+ * free a matrix allocated by matrix_alloc(), header and payload go together
+*/
+void free_matrix(matrix *m) {
+    free(m);
 }
 /*
  * ========================================EUCLIDEAN_DISTANCE=====================================
  * calculate squared euclidean distance between two vectors
 */
-double squared_euclidean_distance(double *vec1, double *vec2, int d) {
+double squared_euclidean_distance(const double *vec1, const double *vec2, int d) {
     double dist = 0.0;
     int i;
     for (i = 0; i < d; i++) {
@@ -78,300 +129,1135 @@ double squared_euclidean_distance(double *vec1, double *vec2, int d) {
     return dist;
 }
 /*
- * ===================================CALCULATE_SYM_MATRIX=========================================
- * allocates memofy for matrix A of size NxN and populates it using formula 1.1
+ * ========================================FILL_SIMILARITY=========================================
+ * populates A (N x N) in place using formula 1.1
+ * exp is evaluated once per pair: the strict upper triangle is computed row by row, then copied
+ * to the lower triangle in MIRROR_BLOCK x MIRROR_BLOCK tiles so both sides stay cache friendly
 */
-double** calculate_sym_matrix(double **data_points, int N, int d) {
-    int i, j;
-    double dist;
-    double **sym_matrix = (double **)malloc(N * sizeof(double *));
-    if (sym_matrix == NULL) {
-        return NULL; /* caller is the handler */
-    }
+#define MIRROR_BLOCK 64
+static void fill_similarity(const matrix *data_points, matrix *A) {
+    const int N = data_points->rows, d = data_points->cols;
+    int i, j, bi, bj, i_end, j_end;
+    double *row;
+    const double *point;
+
+    /* later rows are shorter, dynamic scheduling keeps the threads balanced */
+#ifdef _OPENMP
+#pragma omp parallel for private(j, row, point) schedule(dynamic, 16)
+#endif
     for (i = 0; i < N; i++) {
-        sym_matrix[i] = (double *)malloc(N * sizeof(double));
-        if (sym_matrix[i] == NULL) { /* mid-allocation error, free previous allocations */
-            for (j = 0; j < i; j++) {
-                free(sym_matrix[j]);
-            }
-            free(sym_matrix);
-            return NULL; /* caller is the handler */
+        row = MAT_ROW(A, i);
+        point = MAT_ROW(data_points, i);
+        row[i] = 0; /* same point */
+        for (j = i + 1; j < N; j++) {
+            row[j] = exp(-squared_euclidean_distance(point, MAT_ROW(data_points, j), d) / 2.0);
         }
-        for (j = 0; j < N; j++) {
-            if (i == j) { /* same point */
-                sym_matrix[i][j] = 0;
-            }
-            else {
-                dist = squared_euclidean_distance(data_points[i], data_points[j], d);
-                sym_matrix[i][j] = exp(-dist / 2.0);
+    }
+#ifdef _OPENMP
+#pragma omp parallel for private(bj, i, j, i_end, j_end) schedule(dynamic, 1)
+#endif
+    for (bi = 0; bi < N; bi += MIRROR_BLOCK) { /* lower tile (bi, bj) is the transpose of upper tile (bj, bi) */
+        i_end = bi + MIRROR_BLOCK < N ? bi + MIRROR_BLOCK : N;
+        for (bj = 0; bj <= bi; bj += MIRROR_BLOCK) {
+            j_end = bj + MIRROR_BLOCK < N ? bj + MIRROR_BLOCK : N;
+            for (i = bi; i < i_end; i++) {
+                for (j = bj; j < j_end && j < i; j++) { MAT_AT(A, i, j) = MAT_AT(A, j, i); }
             }
         }
     }
-    return sym_matrix;
 }
 /*
- * ========================================FREE_MATRIX=============================================
- * free allocated memory for a 2D matrix of size NxN
+ * ===================================CALCULATE_SYM_MATRIX=========================================
+ * allocates memofy for matrix A of size NxN and populates it using formula 1.1
 */
-void free_matrix(double **matrix, int N) {
-    int i;
-    if (matrix != NULL) {
-        for (i = 0; i < N; i++) {
-            free(matrix[i]); 
-        }
-        free(matrix); 
-    }
+matrix* calculate_sym_matrix(const matrix *data_points) {
+    matrix *sym_matrix;
+    PROFILE_BEGIN("similarity");
+    sym_matrix = matrix_alloc(data_points->rows, data_points->rows);
+    if (sym_matrix != NULL) { fill_similarity(data_points, sym_matrix); }
+    PROFILE_END(PROFILE_PAIRS(data_points->rows) * PROFILE_KERNEL_FLOPS(data_points->cols));
+    return sym_matrix; /* NULL on failure, caller is the handler */
 }
 /*
  * ========================================PRINT_MATRIX============================================
  * print matrix with 4 decimal places format and comma seperation
+ * returns 1 on success, 0 if the output could not be written
 */
-void print_matrix(double **matrix, int rows, int cols) {
-    int i;
+static void fill_matrix_row(const void *source, int i, double *row) {
+    const matrix *m = (const matrix *)source;
     int j;
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            printf("%.4f", matrix[i][j]);
-            if (j < cols - 1) {
-                printf(",");
-            }
-        }
-        printf("\n");
-    }
+    for (j = 0; j < m->cols; j++) { row[j] = MAT_AT(m, i, j); }
+}
+int print_matrix(const matrix *m) {
+    return output_rows(stdout, m->rows, m->cols, fill_matrix_row, m);
+}
+/*
+ * ========================================PRINT_DIAGONAL==========================================
+ * print the diagonal matrix diag(vec) in the print_matrix() format, one row at a time
+ * so the dense N x N matrix never has to exist
+*/
+static void fill_diagonal_row(const void *source, int i, double *row) {
+    const matrix *vec = (const matrix *)source;
+    int j;
+    for (j = 0; j < vec->rows; j++) { row[j] = 0.0; }
+    row[i] = MAT_AT(vec, i, 0);
+}
+int print_diagonal(const matrix *vec) {
+    return output_rows(stdout, vec->rows, vec->rows, fill_diagonal_row, vec);
 }
 /*
  * ========================================CALCULATE_DDG_MATRIX====================================
- * calculate the diagonal degree matrix D from the symmetric matrix A
- * this method reuses calculate_sym_matrix() to calculate the symmetric matrix A
+ * calculate the degrees of the similarity matrix A, the diagonal of D, as an N x 1 vector
+ * each row sum is accumulated straight from the kernel, so A is never stored
 */
-double** calculate_ddg_matrix(double **data_points, int N, int d) {
+matrix* calculate_ddg_matrix(const matrix *data_points) {
+    const int N = data_points->rows, d = data_points->cols;
     int i;
     int j;
     double row_sum;
-    double **sym_matrix;
-    double **ddg_matrix;
+    const double *point;
+    matrix *degrees;
 
-    /* get similarity matrix A */
-    sym_matrix = calculate_sym_matrix(data_points, N, d);
-    if (sym_matrix == NULL) {
+    degrees = matrix_alloc(N, 1);
+    if (degrees == NULL) {
         return NULL; /* caller is the handler */
     }
-
-    /* allocate memort for ddg matrix D */
-    ddg_matrix = (double **)malloc(N * sizeof(double *));
-    if (ddg_matrix == NULL) {
-        free_matrix(sym_matrix, N); /* free intermediate matrix */
-        return NULL; 
-    }
+    PROFILE_BEGIN("degrees");
+#ifdef _OPENMP
+#pragma omp parallel for private(j, point, row_sum) schedule(static)
+#endif
     for (i = 0; i < N; i++) {
-        ddg_matrix[i] = (double *)calloc(N, sizeof(double)); /* we use calloc for the 0 initialization */
-        if (ddg_matrix[i] == NULL) { 
-            free_matrix(sym_matrix, N);
-            free_matrix(ddg_matrix, i);
-            return NULL; 
-        }
-        /* calculate row sum for each row, place the sum on the diagonal of that row */
+        /* same summation order as a row of calculate_sym_matrix(), so D matches A bit for bit */
+        point = MAT_ROW(data_points, i);
         row_sum = 0.0;
         for (j = 0; j < N; j++) {
-            row_sum += sym_matrix[i][j];
+            if (j != i) { row_sum += exp(-squared_euclidean_distance(point, MAT_ROW(data_points, j), d) / 2.0); }
         }
-        ddg_matrix[i][i] = row_sum;
+        MAT_AT(degrees, i, 0) = row_sum;
     }
-    free_matrix(sym_matrix, N); /* we dont need matrix A */
-
-    return ddg_matrix;
+    PROFILE_END(2 * PROFILE_PAIRS(N) * (PROFILE_KERNEL_FLOPS(d) + 1));
+    return degrees;
 }
 /*
  * ========================================CALCULATE_NORM_MATRIX===================================
  * calculates normalized similarity matrix W
- * this method reuses calculate_sym_matrix() to calculate the symmetric matrix A
+ * fused pipeline: A is built in the buffer that is returned, its row sums give the degrees and
+ * the buffer is then scaled in place to W = D^-1/2 * A * D^-1/2, so only one N x N matrix exists
 */
-double** calculate_norm_matrix(double **data_points, int N, int d) {
+matrix* calculate_norm_matrix(const matrix *data_points) {
+    const int N = data_points->rows;
     int i, j;
-    double* degrees;
-    double **sym_matrix, **norm_matrix;
+    double row_sum;
+    double *sqrt_degrees;
+    double *row;
+    matrix *norm_matrix;
 
-    /* get similarity matrix A */
-    sym_matrix = calculate_sym_matrix(data_points, N, d);
-    if (sym_matrix == NULL) { return NULL; } /* caller is the handler */
-    /* calculate array degrees, in which every entry is a row sum */
-    degrees = (double *)calloc(N, sizeof(double)); /* again for 0 initialization */
-    if (degrees == NULL) {
-        free_matrix(sym_matrix, N);
+    /* similarity matrix A, in the buffer that will hold W */
+    norm_matrix = calculate_sym_matrix(data_points);
+    if (norm_matrix == NULL) { return NULL; } /* caller is the handler */
+    /* square roots of the degrees (row sums), computed once per point */
+    sqrt_degrees = (double *)malloc(N * sizeof(double));
+    if (sqrt_degrees == NULL) {
+        free_matrix(norm_matrix);
         return NULL; 
     }
+    PROFILE_BEGIN("degrees");
+#ifdef _OPENMP
+#pragma omp parallel for private(j, row, row_sum) schedule(static)
+#endif
     for (i = 0; i < N; i++) {
-        for (j = 0; j < N; j++) { degrees[i] += sym_matrix[i][j]; }
-    }
-    /* allocate memory for W */
-    norm_matrix = (double **)malloc(N * sizeof(double *));
-    if (norm_matrix == NULL) {
-        free_matrix(sym_matrix, N);
-        free(degrees);
-        return NULL; 
+        row = MAT_ROW(norm_matrix, i);
+        row_sum = 0.0;
+        for (j = 0; j < N; j++) { row_sum += row[j]; }
+        sqrt_degrees[i] = sqrt(row_sum);
     }
+    PROFILE_END((double)N * N);
+    PROFILE_BEGIN("normalize");
+#ifdef _OPENMP
+#pragma omp parallel for private(j, row) schedule(static)
+#endif
     for (i = 0; i < N; i++) {
-        norm_matrix[i] = (double *)malloc(N * sizeof(double));
-        if (norm_matrix[i] == NULL) {
-            free_matrix(sym_matrix, N);
-            free(degrees);
-            free_matrix(norm_matrix, i);
-            return NULL; 
-        }
+        row = MAT_ROW(norm_matrix, i);
         /* to calculate entry i,j of W we simply calculate A_ij/(sqrt(degree_i) * sqrt(degree_j)) */
         for (j = 0; j < N; j++) {
-            if (degrees[i] == 0 || degrees[j] == 0) {
-                norm_matrix[i][j] = 0; /* avoid division by zero */
+            if (sqrt_degrees[i] == 0 || sqrt_degrees[j] == 0) {
+                row[j] = 0; /* avoid division by zero */
             }
             else {
-                norm_matrix[i][j] = sym_matrix[i][j] / (sqrt(degrees[i]) * sqrt(degrees[j]));
+                row[j] = row[j] / (sqrt_degrees[i] * sqrt_degrees[j]);
             }
         }
     }
-    free_matrix(sym_matrix, N); free(degrees); /* free un needed data */
+    PROFILE_END(2.0 * N * N);
+    free(sqrt_degrees);
     return norm_matrix;
 }
 /*
- * ========================================MAT_MULTIPLY========================================
- * helper method to multiply two matrixes A and B
+ * ========================================MAT_MULTIPLY_INTO=======================================
+ * helper method to multiply two matrixes A and B into a preallocated matrix C
+ * C must be of size rowsA x colsB and must not alias A or B
 */
-double** mat_multiply(double** A, double** B, int rowsA, int colsA, int colsB) {
-    double **return_matrix;
+void mat_multiply_into(const matrix *A, const matrix *B, matrix *C) {
     int i;
     int j;
     int k;
+    double sum;
 
-    /* allocation */
-    return_matrix = (double **)calloc(rowsA, sizeof(double *));
-    if (return_matrix == NULL) {
-        return NULL; /* caller is the handler */
-    }
-    for (i = 0; i < rowsA; i++) {
-        return_matrix[i] = (double *)calloc(colsB, sizeof(double));
-        if (return_matrix[i] == NULL) {
-            for (j = 0; j < i; j++) {
-                free(return_matrix[j]);
+#ifdef _OPENMP
+#pragma omp parallel for private(j, k, sum) schedule(static) if ((double)A->rows * A->cols * B->cols > 1e5)
+#endif
+    for (i = 0; i < A->rows; i++) {
+        for (j = 0; j < B->cols; j++) {
+            sum = 0.0;
+            for (k = 0; k < A->cols; k++) {
+                sum += MAT_AT(A, i, k) * MAT_AT(B, k, j);
             }
-            free(return_matrix);
-            return NULL; 
+            MAT_AT(C, i, j) = sum;
         }
     }
-    /* multiplication */
-    for (i = 0; i < rowsA; i++) {
-        for (j = 0; j < colsB; j++) {
-            for (k = 0; k < colsA; k++) {
-                return_matrix[i][j] += A[i][k] * B[k][j];
-            }
-        }
-    }
-    return return_matrix;
 }
 /*
- * ========================================MAT_TRANSPOSE===========================================
- * helper method to transpose a matrix A
+ * ========================================MAT_MULTIPLY========================================
+ * helper method to multiply two matrixes A and B
 */
-double** mat_transpose(double** A, int rows, int cols) {
-    double **return_matrix;
-    int i;
-    int j;
+matrix* mat_multiply(const matrix *A, const matrix *B) {
+    matrix *return_matrix;
 
     /* allocation */
-    return_matrix = (double **)malloc(cols * sizeof(double *)); /* rows and cols switch places */
+    return_matrix = matrix_alloc(A->rows, B->cols);
     if (return_matrix == NULL) {
         return NULL; /* caller is the handler */
     }
-    for (i = 0; i < cols; i++) {
-        return_matrix[i] = (double *)malloc(rows * sizeof(double));
-        if (return_matrix[i] == NULL) {
-            for (j = 0; j < i; j++) {
-                free(return_matrix[j]);
+    mat_multiply_into(A, B, return_matrix);
+    return return_matrix;
+}
+/*
+ * ==========================================MAT_GRAM==============================================
+ * helper method to calculate the k x k gram matrix H^T * H into a preallocated matrix
+ * walks H row by row so H^T is never materialized. every thread sums its band of rows into its
+ * own k*k row of partials (at least symnmf_max_threads() rows), the partials are then combined
+ * in thread order
+*/
+void mat_gram(const matrix *H, matrix *gram, matrix *partials) {
+    const int k = H->cols;
+    int i, a, b;
+    const double *row;
+    double *partial;
+
+    for (a = 0; a < k; a++) {
+        for (b = 0; b < k; b++) { MAT_AT(gram, a, b) = 0.0; }
+    }
+#ifdef _OPENMP
+#pragma omp parallel private(i, a, b, row, partial) num_threads(partials->rows) if (H->rows > 1000)
+#endif
+    {
+#ifdef _OPENMP
+        partial = MAT_ROW(partials, omp_get_thread_num());
+#else
+        partial = MAT_ROW(partials, 0);
+#endif
+        for (a = 0; a < k * k; a++) { partial[a] = 0.0; }
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (i = 0; i < H->rows; i++) {
+            row = MAT_ROW(H, i);
+            for (a = 0; a < k; a++) {
+                for (b = a; b < k; b++) { partial[a * k + b] += row[a] * row[b]; } /* upper triangle only */
             }
-            free(return_matrix);
-            return NULL;
         }
-    }
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            return_matrix[j][i] = A[i][j]; /* switch places */
+        for (a = 0; a < k; a++) { /* combine one gram row at a time, gram rows may be padded */
+            reduce_in_thread_order(partial + a * k, MAT_ROW(gram, a), k);
         }
     }
-    return return_matrix;
+    for (a = 0; a < k; a++) {
+        for (b = 0; b < a; b++) { MAT_AT(gram, a, b) = MAT_AT(gram, b, a); } /* mirror, the gram matrix is symmetric */
+    }
 }
 /*
  * =======================================FROBENIUS_NORM_SQUARED===================================
  * helper method to calculate the frobenius norm squared of two matrixes A and B
+ * per thread partial sums are combined in thread order, so the result is reproducible
 */
-double frobenius_norm_squared(double** A, double** B, int rows, int cols) {
+double frobenius_norm_squared(const matrix *A, const matrix *B) {
     double norm = 0.0;
+    double partial, diff;
     int i;
     int j;
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            norm += (A[i][j] - B[i][j]) * (A[i][j] - B[i][j]);
+#ifdef _OPENMP
+#pragma omp parallel private(i, j, partial, diff) if (A->rows > 1000)
+#endif
+    {
+        partial = 0.0;
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (i = 0; i < A->rows; i++) {
+            for (j = 0; j < A->cols; j++) {
+                diff = MAT_AT(A, i, j) - MAT_AT(B, i, j);
+                partial += diff * diff;
+            }
         }
+        reduce_in_thread_order(&partial, &norm, 1);
     }
     return norm;
 }
+/*
+ * ========================================W_OPERATOR_DENSE========================================
+ * exposes a dense N x N W to optimize_h_op(), the numerator goes through the blocked kernel in gemm.c
+*/
+static matrix* dense_workspace_alloc(const w_operator *op, int k) {
+    return gemm_pack_alloc(op->N, k);
+}
+static void dense_multiply(const w_operator *op, const matrix *H, matrix *out, matrix *workspace) {
+    gemm_tall_skinny((const matrix *)op->data, H, out, workspace);
+}
+static double dense_squared_norm(const w_operator *op) {
+    const matrix *W = (const matrix *)op->data;
+    double sum = 0.0;
+    int i, j;
+    for (i = 0; i < W->rows; i++) {
+        for (j = 0; j < W->cols; j++) { sum += MAT_AT(W, i, j) * MAT_AT(W, i, j); }
+    }
+    return sum;
+}
+void w_operator_dense(w_operator *op, const matrix *W) {
+    op->N = W->rows;
+    op->entries = (double)W->rows * W->cols;
+    op->data = W;
+    op->workspace_alloc = dense_workspace_alloc;
+    op->multiply = dense_multiply;
+    op->squared_norm = dense_squared_norm;
+}
+/*
+ * ========================================SYMNMF_DEFAULT_OPTIONS==================================
+ * the settings of the original algorithm: damped multiplicative updates with beta = 0.5, at most
+ * 300 iterations, converged once an update changes H by less than eps = 1e-4 (squared frobenius)
+*/
+void symnmf_default_options(symnmf_options *options) {
+    options->max_iter = 300;
+    options->eps = 1e-4;
+    options->beta = 0.5;
+    options->method = SYMNMF_METHOD_MU;
+    options->penalty = 0.0;
+    options->checkpoint = NULL;
+    options->checkpoint_every = SYMNMF_CHECKPOINT_EVERY;
+    options->resume = NULL;
+}
+/*
+ * ========================================SYMNMF_OPTIONS_VALID====================================
+ * whether optimize_h_run() accepts the options: max_iter >= 0, eps >= 0, 0 < beta <= 1, a known
+ * method and penalty >= 0, none of them NaN. the checkpoint fields are checked by the run itself
+ * returns 1 if they are valid, 0 otherwise
+*/
+int symnmf_options_valid(const symnmf_options *options) {
+    return options->max_iter >= 0 && options->eps >= 0 && options->beta > 0 && options->beta <= 1
+        && options->method >= SYMNMF_METHOD_MU && options->method <= SYMNMF_METHOD_HALS && options->penalty >= 0;
+}
+/*
+ * ========================================SYMNMF_METHOD_FROM_NAME=================================
+ * maps "mu", "momentum" and "hals" to their SYMNMF_METHOD_ values
+ * returns -1 for any other name
+*/
+int symnmf_method_from_name(const char *name) {
+    if (string_compare(name, "mu") == 1) { return SYMNMF_METHOD_MU; }
+    if (string_compare(name, "momentum") == 1) { return SYMNMF_METHOD_MOMENTUM; }
+    if (string_compare(name, "hals") == 1) { return SYMNMF_METHOD_HALS; }
+    return -1;
+}
+/*
+ * ========================================COPY_MATRIX_INTO========================================
+ * copies the entries of src into dst of the same shape, the strides may differ
+*/
+static void copy_matrix_into(const matrix *src, matrix *dst) {
+    int i, j;
+    for (i = 0; i < src->rows; i++) {
+        for (j = 0; j < src->cols; j++) { MAT_AT(dst, i, j) = MAT_AT(src, i, j); }
+    }
+}
+/*
+ * ========================================MULTIPLICATIVE_UPDATE===================================
+ * the damped update of the original algorithm, out = H .* (1 - beta + beta * numerator ./ denominator)
+ * with numerator W*H and denominator H*(H^T*H), entries with a zero denominator are kept
+*/
+static void multiplicative_update(const matrix *H, const matrix *numerator, const matrix *denominator, double beta, matrix *out) {
+    const int N = H->rows, k = H->cols;
+    int i, j;
+    const double *curr_row, *num_row, *den_row;
+    double *next_row;
+#ifdef _OPENMP
+#pragma omp parallel for private(j, curr_row, next_row, num_row, den_row) schedule(static) if (N > 1000)
+#endif
+    for (i = 0; i < N; i++) {
+        curr_row = MAT_ROW(H, i); next_row = MAT_ROW(out, i);
+        num_row = MAT_ROW(numerator, i); den_row = MAT_ROW(denominator, i);
+        for (j = 0; j < k; j++) {
+            if (den_row[j] == 0) { next_row[j] = curr_row[j]; } /* avoid division by zero */
+            else { next_row[j] = curr_row[j] * (1 - beta + beta * (num_row[j] / den_row[j])); }
+        }
+    }
+}
+/*
+ * ========================================EXTRAPOLATE=============================================
+ * the momentum step, out = next + gamma * (next - prev), kept at least MOMENTUM_FLOOR because a
+ * multiplicative update can never move an entry away from 0
+*/
+static void extrapolate(const matrix *next, const matrix *prev, double gamma, matrix *out) {
+    const int N = next->rows, k = next->cols;
+    int i, j;
+    double value;
+#ifdef _OPENMP
+#pragma omp parallel for private(j, value) schedule(static) if (N > 1000)
+#endif
+    for (i = 0; i < N; i++) {
+        for (j = 0; j < k; j++) {
+            value = MAT_AT(next, i, j) + gamma * (MAT_AT(next, i, j) - MAT_AT(prev, i, j));
+            MAT_AT(out, i, j) = value > MOMENTUM_FLOOR ? value : MOMENTUM_FLOOR;
+        }
+    }
+}
+/*
+ * ========================================ROWS_SUM================================================
+ * sums values over the processes of a row-partitioned run, nothing to do without a transport
+ * returns 1 on success, 0 if the transport failed
+*/
+static int rows_sum(transport *t, double *values, int count) {
+    return t == NULL || t->allreduce_sum(t, values, count);
+}
+/*
+ * ========================================ROWS_GRAM===============================================
+ * mat_gram() of H, summed over the row blocks of every process when there is a transport. the
+ * gram rows may be padded, so they are summed through the contiguous first row of partials
+ * returns 1 on success, 0 if the transport failed
+*/
+static int rows_gram(const matrix *H, matrix *gram, matrix *partials, transport *t) {
+    const int k = H->cols;
+    double *flat = MAT_ROW(partials, 0);
+    int a, b;
+    mat_gram(H, gram, partials);
+    if (t == NULL) { return 1; }
+    for (a = 0; a < k; a++) {
+        for (b = 0; b < k; b++) { flat[a * k + b] = MAT_AT(gram, a, b); }
+    }
+    if (!t->allreduce_sum(t, flat, k * k)) { return 0; }
+    for (a = 0; a < k; a++) {
+        for (b = 0; b < k; b++) { MAT_AT(gram, a, b) = flat[a * k + b]; }
+    }
+    return 1;
+}
+/*
+ * ========================================FIT_TERMS===============================================
+ * ||W - H*H^T||_F^2 - ||W||_F^2 = ||H^T*H||_F^2 - 2 tr(H^T*W*H) from the products an update has
+ * already formed (WH = W*H, gram = H^T*H), enough to compare two H against the same W. the trace
+ * runs over the rows of H, which are summed over the processes when there is a transport
+ * returns 1 on success, 0 if the transport failed
+*/
+static int fit_terms(const matrix *H, const matrix *WH, const matrix *gram, transport *t, double *fit) {
+    double trace = 0.0, gram_norm = 0.0;
+    int i, j;
+    for (i = 0; i < H->rows; i++) {
+        for (j = 0; j < H->cols; j++) { trace += MAT_AT(H, i, j) * MAT_AT(WH, i, j); }
+    }
+    if (!rows_sum(t, &trace, 1)) { return 0; }
+    for (i = 0; i < gram->rows; i++) {
+        for (j = 0; j < gram->cols; j++) { gram_norm += MAT_AT(gram, i, j) * MAT_AT(gram, i, j); }
+    }
+    *fit = gram_norm - 2 * trace;
+    return 1;
+}
+/*
+ * ========================================HALS_SWEEP==============================================
+ * one pass over the columns of X for min ||W - anchor*X^T||_F^2 + penalty * ||X - anchor||_F^2,
+ * X >= 0, with WA = W*anchor and gram = anchor^T*anchor. every column has the closed form
+ * x_j = max(0, (WA_j + penalty * a_j - sum_{l != j} x_l * gram_lj) / (gram_jj + penalty))
+ * which for row i only reads row i, so the rows are independent and split over threads
+*/
+static void hals_sweep(matrix *X, const matrix *WA, const matrix *gram, const matrix *anchor, double penalty) {
+    const int N = X->rows, k = X->cols;
+    int i, j, l;
+    double *x_row, value, scale;
+#ifdef _OPENMP
+#pragma omp parallel for private(j, l, x_row, value, scale) schedule(static) if (N > 1000)
+#endif
+    for (i = 0; i < N; i++) {
+        x_row = MAT_ROW(X, i);
+        for (j = 0; j < k; j++) {
+            scale = MAT_AT(gram, j, j) + penalty;
+            if (scale <= 0) { continue; } /* an all zero column with no penalty, nothing to fit */
+            value = MAT_AT(WA, i, j) + penalty * MAT_AT(anchor, i, j);
+            for (l = 0; l < k; l++) {
+                if (l != j) { value -= x_row[l] * MAT_AT(gram, l, j); }
+            }
+            x_row[j] = value > 0 ? value / scale : 0.0;
+        }
+    }
+}
+#ifdef SYMNMF_PROFILE
+/*
+ * ========================================ITERATION_FLOPS=========================================
+ * FLOP estimate of an iteration that formed the given number of W*H products, each with its
+ * gram matrix and H*gram (or hals sweep), plus the element wise work of the update
+*/
+static double iteration_flops(const w_operator *W, int k, int products) {
+    const double N = W->N;
+    return products * (2 * W->entries * k + N * k * (k + 1) + 2 * N * k * k) + 8 * N * k;
+}
+#endif
+/*
+ * ========================================HISTORY_PUSH============================================
+ * appends the residual of an iteration to the history a checkpoint keeps, doubling its capacity
+ * returns 1 on success, 0 if memory runs out
+*/
+static int history_push(double **history, int *capacity, int count, double residual) {
+    double *grown;
+    if (count == *capacity) {
+        grown = (double *)realloc(*history, (size_t)(*capacity > 0 ? 2 * *capacity : 64) * sizeof(double));
+        if (grown == NULL) { return 0; }
+        *history = grown;
+        *capacity = *capacity > 0 ? 2 * *capacity : 64;
+    }
+    (*history)[count] = residual;
+    return 1;
+}
+/*
+ * ========================================RESUME_MATCHES==========================================
+ * whether a checkpoint can continue a run of the given method from an H shaped like init_H
+*/
+static int resume_matches(const symnmf_checkpoint *c, const matrix *init_H, int method) {
+    return c->method == method && c->H->rows == init_H->rows && c->H->cols == init_H->cols
+        && (c->extra != NULL) == (method != SYMNMF_METHOD_MU)
+        && (c->extra == NULL || (c->extra->rows == init_H->rows && c->extra->cols == init_H->cols))
+        && c->iterations >= 0 && (c->iterations == 0 || c->history != NULL);
+}
 /*
  * ===========================================OPTIMIZE_H===========================================
- * this method does the core optimization of the algorithm, iteratively.
- * the matrix operations are left for the helper methods
+ * this method does the core optimization of the algorithm, iteratively, with the update rule
+ * chosen by options (NULL for symnmf_default_options()). the matrix operations are left for the
+ * helper methods. the N x N product H*H^T is never formed: denominators and fits go through the
+ * k x k gram matrix, and W*H comes from the operator W (dense, packed symmetric, ...)
+ *   mu: the damped multiplicative update, one product per iteration
+ *   momentum: the multiplicative update taken from an extrapolated point H + gamma * (H - H_prev).
+ *     gamma grows while the fit improves, and the extrapolation is dropped (a restart, one extra
+ *     product) and gamma shrinks as soon as the fit gets worse
+ *   hals: alternating nonnegative least squares on W ~ H*G^T with a penalty pulling G to H, both
+ *     halves solved column by column in closed form, two products per iteration
+ * all workspaces are allocated once before the loop. with OpenMP every step is split over rows
+ * and the reductions are combined in thread order, so a fixed thread count gives fixed results
+ * result->H is the last H even without convergence, with the number of iterations, whether the
+ * last change ||H_next - H||_F^2 (result->residual) dropped below eps, and how many products were formed
+ * with options->checkpoint the whole state of the loop is written every checkpoint_every
+ * iterations and once more at the end, and options->resume continues from such a state (init_H
+ * only gives the shape), so a run stopped and resumed ends exactly where an uninterrupted one does.
+ * the counts in result include the iterations and products before the resume
+ * returns 1 on success, 0 if the options or init_H are invalid, memory runs out or a checkpoint
+ * cannot be written. result->H is then NULL and result->status tells which
  */
-double** optimize_h(double** W, double** init_H, int N, int k) {
-    const int max_iter = 300;
-    const double eps = 1e-4;
-    const double beta = 0.5;
-    double **curr_H, **next_H, **curr_H_transpose, **denominator, **numerator, **temp_matrix;
-    int i, j, iter;
-    double curr_frobenius_norm;
+int optimize_h_run(const w_operator *W, const matrix *init_H, const symnmf_options *options, symnmf_result *result) {
+    return optimize_h_rows(W, init_H, options, NULL, result);
+}
+/*
+ * ===========================================OPTIMIZE_H_ROWS======================================
+ * optimize_h_run() on one block of rows of a run split over the processes of t (NULL for a single
+ * process): init_H and result->H are the rows of this process, and W multiplies them into the
+ * same rows of W*H (gathering the other blocks of H itself). every row-wise step stays local, the
+ * gram matrices, the trace of the momentum fit and the residual are summed over the processes,
+ * so every process takes the same decisions and stops at the same iteration. the sums run in a
+ * different order than in one process, the result matches it within rounding
+ * returns 0 also if the transport fails
+ */
+int optimize_h_rows(const w_operator *W, const matrix *init_H, const symnmf_options *options, transport *t, symnmf_result *result) {
+    const int N = init_H->rows, k = init_H->cols;
+    symnmf_options defaults;
+    matrix *curr_H, *next_H, *swap, *extra, *gram, *gram_partials, *denominator, *numerator, *workspace = NULL;
+    int i, iter, restarted = 0, ok = 1, saved = 0, history_capacity = 0;
+    double penalty = 0.0, gamma = MOMENTUM_GAMMA, gamma_max = 1.0, fit, last_fit = 0.0, *history = NULL;
+    symnmf_checkpoint state;
 
-    /* allocate memory for curr_H, next_H */
-    curr_H = (double **)malloc(N * sizeof(double *));
-    if (curr_H == NULL) { return NULL; }
+    if (options == NULL) { symnmf_default_options(&defaults); options = &defaults; }
+    result->H = NULL; result->iterations = 0; result->converged = 0; result->residual = 0.0; result->products = 0;
+    result->status = SYMNMF_STATUS_INVALID; result->errnum = 0;
+    if (!symnmf_options_valid(options) || k < 1) { return 0; }
+    if (t != NULL && (options->checkpoint != NULL || options->resume != NULL)) { return 0; } /* one process only */
+    if (options->resume != NULL && !resume_matches(options->resume, init_H, options->method)) { return 0; }
+    result->status = SYMNMF_STATUS_NO_MEMORY;
+    PROFILE_BEGIN("optimize");
+    /* allocate memory for curr_H, next_H and the per iteration workspaces, extra is the
+     * extrapolated point of momentum or G of hals */
+    curr_H = matrix_alloc(N, k);
+    next_H = matrix_alloc(N, k);
+    extra = options->method == SYMNMF_METHOD_MU ? NULL : matrix_alloc(N, k);
+    gram = matrix_alloc(k, k);
+    gram_partials = matrix_alloc(symnmf_max_threads(), k * k);
+    numerator = matrix_alloc(N, k);
+    denominator = matrix_alloc(N, k);
+    if (W->workspace_alloc != NULL) { workspace = W->workspace_alloc(W, k); }
+    if (curr_H == NULL || next_H == NULL || (options->method != SYMNMF_METHOD_MU && extra == NULL) || gram == NULL
+            || gram_partials == NULL || numerator == NULL || denominator == NULL || (W->workspace_alloc != NULL && workspace == NULL)) {
+        free_matrix(curr_H); free_matrix(next_H); free_matrix(extra); free_matrix(gram); free_matrix(gram_partials);
+        free_matrix(numerator); free_matrix(denominator); free_matrix(workspace);
+        PROFILE_END(0);
+        return 0; /* caller is the handler */
+    }
+    result->status = SYMNMF_STATUS_OK;
+    iter = 0;
+    if (options->resume != NULL) { /* the state of the loop after options->resume->iterations */
+        copy_matrix_into(options->resume->H, curr_H);
+        if (extra != NULL) { copy_matrix_into(options->resume->extra, extra); }
+        iter = options->resume->iterations;
+        result->products = options->resume->products;
+        gamma = options->resume->gamma; gamma_max = options->resume->gamma_max;
+        last_fit = options->resume->last_fit; penalty = options->resume->penalty;
+        if (iter > 0) {
+            result->residual = options->resume->history[iter - 1];
+            result->converged = result->residual < options->eps;
+        }
+        for (i = 0; ok && options->checkpoint != NULL && i < iter; i++) {
+            ok = history_push(&history, &history_capacity, i, options->resume->history[i]);
+        }
+        if (!ok) { result->status = SYMNMF_STATUS_NO_MEMORY; }
+    }
+    else {
+        copy_matrix_into(init_H, curr_H); /* copy initial H from the argument */
+        if (extra != NULL) { copy_matrix_into(init_H, extra); }
+        if (options->method == SYMNMF_METHOD_HALS) { /* the penalty in the units of H^T*H unless one is given */
+            ok = rows_gram(curr_H, gram, gram_partials, t);
+            for (iter = 0; iter < k; iter++) { penalty += MAT_AT(gram, iter, iter); }
+            penalty = options->penalty > 0 ? options->penalty : HALS_PENALTY * penalty / k;
+            iter = 0;
+        }
+    }
+    state.method = options->method; state.extra = extra; state.penalty = penalty;
+    /* optimization loop, every method turns curr_H into next_H */
+    for (; iter < options->max_iter && !result->converged && ok; iter++) {
+        if (options->method == SYMNMF_METHOD_MU) {
+            if (!(ok = rows_gram(curr_H, gram, gram_partials, t))) { break; } /* H^T*H, k x k */
+            mat_multiply_into(curr_H, gram, denominator); /* calculate denominator H*(H^T*H) */
+            W->multiply(W, curr_H, numerator, workspace); /* calculate numerator W*H */
+            result->products++;
+            multiplicative_update(curr_H, numerator, denominator, options->beta, next_H);
+        }
+        else if (options->method == SYMNMF_METHOD_MOMENTUM) {
+            for (restarted = 0; ; restarted = 1) { /* the update is taken from extra, the extrapolated H */
+                if (!(ok = rows_gram(extra, gram, gram_partials, t))) { break; }
+                mat_multiply_into(extra, gram, denominator);
+                W->multiply(W, extra, numerator, workspace);
+                result->products++;
+                if (!(ok = fit_terms(extra, numerator, gram, t, &fit))) { break; }
+                if (iter == 0 || restarted || fit <= last_fit) { break; }
+                copy_matrix_into(curr_H, extra); /* the extrapolation made the fit worse, restart from H */
+                gamma_max = gamma;
+                gamma /= MOMENTUM_SHRINK;
+            }
+            if (!ok) { break; }
+            if (!restarted && iter > 0) { /* the extrapolation paid off, take a longer one next time */
+                gamma = gamma * MOMENTUM_GROW < gamma_max ? gamma * MOMENTUM_GROW : gamma_max;
+                gamma_max = gamma_max * MOMENTUM_GROW_MAX < 1.0 ? gamma_max * MOMENTUM_GROW_MAX : 1.0;
+            }
+            last_fit = fit;
+            multiplicative_update(extra, numerator, denominator, options->beta, next_H);
+            extrapolate(next_H, curr_H, gamma, extra);
+        }
+        else { /* hals, G (extra) is fitted against H, then H against G */
+            if (!(ok = rows_gram(curr_H, gram, gram_partials, t))) { break; }
+            W->multiply(W, curr_H, numerator, workspace);
+            hals_sweep(extra, numerator, gram, curr_H, penalty);
+            if (!(ok = rows_gram(extra, gram, gram_partials, t))) { break; }
+            W->multiply(W, extra, numerator, workspace);
+            result->products += 2;
+            copy_matrix_into(curr_H, next_H);
+            hals_sweep(next_H, numerator, gram, extra, penalty);
+        }
+        result->residual = frobenius_norm_squared(next_H, curr_H); /* check convergence */
+        if (!(ok = rows_sum(t, &result->residual, 1))) { break; }
+        result->converged = result->residual < options->eps;
+        PROFILE_ITERATION(result->residual, iteration_flops(W, k, options->method == SYMNMF_METHOD_HALS || restarted ? 2 : 1));
+        swap = curr_H; curr_H = next_H; next_H = swap; /* next_H becomes the current H */
+        if (options->checkpoint == NULL) { continue; }
+        if (!(ok = history_push(&history, &history_capacity, iter, result->residual))) {
+            result->status = SYMNMF_STATUS_NO_MEMORY;
+            break;
+        }
+        saved = options->checkpoint_every > 0 && (iter + 1) % options->checkpoint_every == 0;
+        if (saved) {
+            state.iterations = iter + 1; state.products = result->products; state.H = curr_H; state.history = history;
+            state.gamma = gamma; state.gamma_max = gamma_max; state.last_fit = last_fit;
+            if (!(ok = checkpoint_write(options->checkpoint, &state))) { result->status = SYMNMF_STATUS_CHECKPOINT; result->errnum = errno; }
+        }
+    }
+    if (ok && options->checkpoint != NULL && !saved) { /* the final state, unless the last iteration saved it */
+        state.iterations = iter; state.products = result->products; state.H = curr_H; state.history = history;
+        state.gamma = gamma; state.gamma_max = gamma_max; state.last_fit = last_fit;
+        if (!(ok = checkpoint_write(options->checkpoint, &state))) { result->status = SYMNMF_STATUS_CHECKPOINT; result->errnum = errno; }
+    }
+    if (!ok && result->status == SYMNMF_STATUS_OK) { result->status = SYMNMF_STATUS_TRANSPORT; } /* the sums over t */
+    free(history);
+    free_matrix(next_H); free_matrix(extra); free_matrix(gram); free_matrix(gram_partials);
+    free_matrix(numerator); free_matrix(denominator); free_matrix(workspace);
+    result->iterations = iter;
+    result->H = ok ? curr_H : NULL;
+    if (!ok) { free_matrix(curr_H); }
+    PROFILE_END(iteration_flops(W, k, result->products) + 8.0 * N * k * (iter - 1));
+    return ok;
+}
+/*
+ * ===========================================OPTIMIZE_H_OP========================================
+ * optimize_h_run() with the default options that gives up without convergence, returns NULL in
+ * that case or if memory runs out
+ */
+matrix* optimize_h_op(const w_operator *W, const matrix *init_H) {
+    symnmf_result result;
+    if (!optimize_h_run(W, init_H, NULL, &result)) { return NULL; }
+    if (!result.converged) {
+        free_matrix(result.H);
+        return NULL;
+    }
+    return result.H;
+}
+/*
+ * ===========================================OPERATOR_MEAN========================================
+ * mean of the N^2 entries of W, the entries of W*1 summed in row order
+ * returns a negative value if memory runs out
+ */
+double operator_mean(const w_operator *W) {
+    matrix *ones, *row_sums, *workspace = NULL;
+    double sum = 0.0;
+    int i;
+
+    ones = matrix_alloc(W->N, 1);
+    row_sums = matrix_alloc(W->N, 1);
+    if (W->workspace_alloc != NULL) { workspace = W->workspace_alloc(W, 1); }
+    if (ones == NULL || row_sums == NULL || (W->workspace_alloc != NULL && workspace == NULL)) {
+        free_matrix(ones); free_matrix(row_sums); free_matrix(workspace);
+        return -1.0;
+    }
+    for (i = 0; i < W->N; i++) { MAT_AT(ones, i, 0) = 1.0; }
+    W->multiply(W, ones, row_sums, workspace);
+    for (i = 0; i < W->N; i++) { sum += MAT_AT(row_sums, i, 0); }
+    free_matrix(ones); free_matrix(row_sums); free_matrix(workspace);
+    return sum / ((double)W->N * W->N);
+}
+/*
+ * ===========================================SYMNMF_OBJECTIVE=====================================
+ * ||W - H*H^T||_F^2 without forming H*H^T, expanded as ||W||^2 - 2 tr(H^T*W*H) + ||H^T*H||^2
+ * w_squared_norm is ||W||_F^2 from W->squared_norm(), shared by every H of the same W
+ * returns a negative value if memory runs out
+ */
+double symnmf_objective(const w_operator *W, const matrix *H, double w_squared_norm) {
+    const int N = H->rows, k = H->cols;
+    matrix *WH, *gram, *partials, *workspace = NULL;
+    double trace = 0.0, gram_norm = 0.0, objective;
+    int i, j;
+
+    WH = matrix_alloc(N, k);
+    gram = matrix_alloc(k, k);
+    partials = matrix_alloc(symnmf_max_threads(), k * k);
+    if (W->workspace_alloc != NULL) { workspace = W->workspace_alloc(W, k); }
+    if (WH == NULL || gram == NULL || partials == NULL || (W->workspace_alloc != NULL && workspace == NULL)) {
+        free_matrix(WH); free_matrix(gram); free_matrix(partials); free_matrix(workspace);
+        return -1.0;
+    }
+    W->multiply(W, H, WH, workspace);
+    mat_gram(H, gram, partials);
     for (i = 0; i < N; i++) {
-        curr_H[i] = (double *)malloc(k * sizeof(double));
-        if (curr_H[i] == NULL) {
-            for (j = 0; j < i; j++) { free(curr_H[j]); }
-            free(curr_H); return NULL; } /* caller is the handler */
-        for (j = 0; j < k; j++) { curr_H[i][j] = init_H[i][j]; } /* copy initial H from the argument */
-    }
-    next_H = (double **)malloc(N * sizeof(double *));
-    if (next_H == NULL) { free_matrix(curr_H, N); return NULL; }
+        for (j = 0; j < k; j++) { trace += MAT_AT(H, i, j) * MAT_AT(WH, i, j); }
+    }
+    for (i = 0; i < k; i++) {
+        for (j = 0; j < k; j++) { gram_norm += MAT_AT(gram, i, j) * MAT_AT(gram, i, j); }
+    }
+    free_matrix(WH); free_matrix(gram); free_matrix(partials); free_matrix(workspace);
+    objective = w_squared_norm - 2 * trace + gram_norm;
+    return objective > 0 ? objective : 0.0; /* rounding can push a near perfect fit below 0 */
+}
+/*
+ * ===========================================SYMNMF_BATCH=========================================
+ * runs every (k, seed) job against the same read only W: H is initialized like init_h_uniform()
+ * from the mean of W, optimized with options (NULL for the defaults), and its objective and
+ * iteration count are stored in the job
+ * jobs run in parallel, one thread each, so a job gives the same result as a single threaded run
+ * whatever the batch. non converged jobs keep their last H with converged = 0
+ * returns 1 on success, 0 if memory runs out (the H of finished jobs are then freed)
+ */
+int symnmf_batch(const w_operator *W, symnmf_job *jobs, int job_count, const symnmf_options *options) {
+    const double mean = operator_mean(W);
+    const double w_squared_norm = W->squared_norm(W);
+    int t, ok = 1;
+    matrix *init_H;
+    symnmf_result result;
+
+    for (t = 0; t < job_count; t++) { jobs[t].H = NULL; }
+    if (mean < 0) { return 0; }
+#ifdef _OPENMP
+#pragma omp parallel for private(init_H, result) schedule(dynamic, 1) reduction(&& : ok) if (job_count > 1)
+#endif
+    for (t = 0; t < job_count; t++) {
+#ifdef _OPENMP
+        if (omp_in_parallel()) { symnmf_set_threads(1); } /* nested regions of the job stay single threaded */
+#endif
+        init_H = init_h_uniform(W->N, jobs[t].k, mean, jobs[t].seed);
+        if (init_H != NULL && optimize_h_run(W, init_H, options, &result)) {
+            jobs[t].H = result.H;
+            jobs[t].iterations = result.iterations;
+            jobs[t].converged = result.converged;
+        }
+        free_matrix(init_H);
+        if (jobs[t].H != NULL) { jobs[t].objective = symnmf_objective(W, jobs[t].H, w_squared_norm); }
+        ok = ok && jobs[t].H != NULL && jobs[t].objective >= 0;
+    }
+    if (!ok) {
+        for (t = 0; t < job_count; t++) { free_matrix(jobs[t].H); jobs[t].H = NULL; }
+    }
+    return ok;
+}
+/*
+ * ===========================================OPTIMIZE_H===========================================
+ * optimize_h_op() for a dense W
+ */
+matrix* optimize_h(const matrix *W, const matrix *init_H) {
+    w_operator op;
+    w_operator_dense(&op, W);
+    return optimize_h_op(&op, init_H);
+}
+/*
+ * ===========================================INIT_H_UNIFORM=======================================
+ * the initial N x k H of symnmf.py: entries uniform in [0, 2*sqrt(m/k)) where m is the mean of W,
+ * drawn row by row from MT19937 so the same seed gives numpy's np.random.uniform values
+ * returns NULL on failure, caller is the handler
+*/
+matrix* init_h_uniform(int N, int k, double mean, unsigned long seed) {
+    const double upper_bound = 2 * sqrt(mean / k);
+    mt_state rng;
+    matrix *H;
+    int i, j;
+
+    H = matrix_alloc(N, k);
+    if (H == NULL) { return NULL; }
+    mt_seed(&rng, seed);
     for (i = 0; i < N; i++) {
-        next_H[i] = (double *)malloc(k * sizeof(double));
-        if (next_H[i] == NULL) {
-            for (j = 0; j < i; j++) { free(next_H[j]); }
-            free(next_H); free_matrix(curr_H, N); return NULL; } 
-    }
-    /* optimization loop */
-    for (iter = 0; iter < max_iter; iter++) {
-        curr_H_transpose = mat_transpose(curr_H, N, k); /* get H^T, which is allocated in the helper method */
-        if (curr_H_transpose == NULL) { free_matrix(curr_H, N); free_matrix(next_H, N); return NULL; } 
-        temp_matrix = mat_multiply(curr_H, curr_H_transpose, N, k, N); /* calculate denominator */
-        if (temp_matrix == NULL) { free_matrix(curr_H, N); free_matrix(next_H, N); free_matrix(curr_H_transpose, k); return NULL; } 
-        denominator = mat_multiply(temp_matrix, curr_H, N, N, k);
-        if (denominator == NULL) { free_matrix(curr_H, N); free_matrix(next_H, N); free_matrix(curr_H_transpose, k); free_matrix(temp_matrix, N); return NULL; } 
-        free_matrix(temp_matrix, N); /* we dont need temp_matrix anymore */
-        numerator = mat_multiply(W, curr_H, N, N, k); /* calculate numerator */
-        if (numerator == NULL) { free_matrix(curr_H, N); free_matrix(next_H, N); free_matrix(curr_H_transpose, k); free_matrix(denominator, N); return NULL; } 
-        for (i = 0; i < N; i++) { /* update next_H */
-            for (j = 0; j < k; j++) {
-                if (denominator[i][j] == 0) { next_H[i][j] = curr_H[i][j]; } /* avoid division by zero */
-                else { next_H[i][j] = curr_H[i][j] * (1 - beta + beta * (numerator[i][j] / denominator[i][j])); }
-            }
+        for (j = 0; j < k; j++) { MAT_AT(H, i, j) = upper_bound * mt_next_double(&rng); }
+    }
+    return H;
+}
+/*
+ * ===========================================ARGMAX_LABELS========================================
+ * the cluster of each point, the index of the largest entry in its row of H (the first on ties,
+ * like numpy's argmax), as an N x 1 matrix
+ * returns NULL on failure, caller is the handler
+*/
+matrix* argmax_labels(const matrix *H) {
+    matrix *labels;
+    int i, j, best;
+
+    labels = matrix_alloc(H->rows, 1);
+    if (labels == NULL) { return NULL; }
+    for (i = 0; i < H->rows; i++) {
+        for (best = 0, j = 1; j < H->cols; j++) {
+            if (MAT_AT(H, i, j) > MAT_AT(H, i, best)) { best = j; }
         }
-        curr_frobenius_norm = frobenius_norm_squared(next_H, curr_H, N, k); /* check convergence */
-        if (curr_frobenius_norm < eps) { free_matrix(curr_H, N); free_matrix(curr_H_transpose, k); free_matrix(denominator, N); free_matrix(numerator, N); return next_H; } /* converged */
-        for (i = 0; i < N; i++) { /* swap curr_H and next_H if no convergence */
-            for (j = 0; j < k; j++) { curr_H[i][j] = next_H[i][j]; }
+        MAT_AT(labels, i, 0) = best;
+    }
+    return labels;
+}
+#ifndef SYMNMF_NO_MAIN /* the program, left out when a test brings its own main() */
+/*
+ * ===========================================RUN_SYMNMF_OPERATOR==================================
+ * H initialized from the mean of W with the given seed, then optimized against the operator
+ * returns NULL on failure or no convergence, caller is the handler
+*/
+static matrix* run_symnmf_operator(const w_operator *W, double mean, int k, unsigned long seed, const symnmf_options *options) {
+    matrix *init_H;
+    symnmf_result result;
+    if (mean < 0) { return NULL; } /* operator_mean() ran out of memory */
+    PROFILE_BEGIN("init_h");
+    init_H = init_h_uniform(W->N, k, mean, seed);
+    PROFILE_END(2.0 * W->N * k);
+    if (init_H == NULL) { return NULL; }
+    if (!optimize_h_run(W, init_H, options, &result)) { result.H = NULL; }
+    free_matrix(init_H);
+    if (result.H != NULL && !result.converged) {
+        free_matrix(result.H);
+        return NULL;
+    }
+    return result.H;
+}
+/*
+ * ===========================================RUN_SYMNMF===========================================
+ * the whole algorithm on the points, W = norm (packed), H initialized from the mean of W with the
+ * given seed, then optimized. single stores W as float (half the memory), H and every sum stay double
+ * tile > 0 stores no W at all, it is regenerated in tile x tile blocks for every product
+ * returns NULL on failure or no convergence, caller is the handler
+*/
+static matrix* run_symnmf(const matrix *data_points, int k, unsigned long seed, int single, int tile, const symnmf_options *options) {
+    packed_matrix *W = NULL;
+    packed_matrix_f32 *W_f32 = NULL;
+    tiled_w *W_tiled = NULL;
+    w_operator W_operator;
+    matrix *optimized_H = NULL;
+
+    if (tile > 0) {
+        W_tiled = tiled_w_create(data_points, tile);
+        if (W_tiled != NULL) {
+            w_operator_tiled(&W_operator, W_tiled);
+            optimized_H = run_symnmf_operator(&W_operator, operator_mean(&W_operator), k, seed, options);
+        }
+    }
+    else if (single) {
+        W_f32 = calculate_norm_packed_f32(data_points);
+        if (W_f32 != NULL) {
+            w_operator_packed_f32(&W_operator, W_f32);
+            optimized_H = run_symnmf_operator(&W_operator, packed_mean_f32(W_f32), k, seed, options);
         }
-        for (i = 0; i < N; i++) { /* reset next_H for the next iteration */
-            for (j = 0; j < k; j++) { next_H[i][j] = 0.0; }
+    }
+    else {
+        W = calculate_norm_packed(data_points);
+        if (W != NULL) {
+            w_operator_packed(&W_operator, W);
+            optimized_H = run_symnmf_operator(&W_operator, packed_mean(W), k, seed, options);
         }
-        free_matrix(curr_H_transpose, k); free_matrix(denominator, N); free_matrix(numerator, N); /* free intermediate matrices */
     }
-    free_matrix(curr_H, N); free_matrix(next_H, N); /* if we reach here, we did not converge - then we should free curr_H, next_H and return*/
-    return NULL; 
+    free_packed(W);
+    free_packed_f32(W_f32);
+    free_tiled_w(W_tiled);
+    return optimized_H;
+}
+/*
+ * ===========================================RUN_SYMNMF_NYSTROM===================================
+ * the algorithm on the low-rank approximation of W from the given number of landmarks, sampled
+ * with the seed of H (NYSTROM_UNIFORM or NYSTROM_KMEANSPP). with report the relative error against
+ * the exact W goes to stderr, which costs O(N^2) memory
+ * returns NULL on failure, no convergence or landmarks > N, caller is the handler
+*/
+static matrix* run_symnmf_nystrom(const matrix *data_points, int k, unsigned long seed, int landmarks, int sampling, int report, const symnmf_options *options) {
+    nystrom_w *W;
+    w_operator W_operator;
+    matrix *optimized_H = NULL;
+    double error = 0.0;
+
+    W = nystrom_create(data_points, landmarks, sampling, seed);
+    if (W == NULL) { return NULL; }
+    if (report) {
+        error = nystrom_error(W, data_points);
+        if (error < 0 || fprintf(stderr, "nystrom: %d landmarks, rank %d, relative error %.6e\n", W->landmarks, W->rank, error) < 0) {
+            free_nystrom(W);
+            return NULL;
+        }
+    }
+    w_operator_nystrom(&W_operator, W);
+    optimized_H = run_symnmf_operator(&W_operator, operator_mean(&W_operator), k, seed, options);
+    free_nystrom(W);
+    return optimized_H;
+}
+/*
+ * ===========================================RUN_SYMNMF_KNN=======================================
+ * the algorithm on the sparse W of the nearest neighbor graph (csr), like the knn goal of
+ * symnmf.py: H is initialized from the mean of the stored entries summed in csr order, the rest are 0
+ * returns NULL on failure or no convergence, caller is the handler
+*/
+static matrix* run_symnmf_knn(const matrix *data_points, int k, unsigned long seed, int neighbors, double radius, const symnmf_options *options) {
+    csr_matrix *W;
+    w_operator W_operator;
+    matrix *optimized_H;
+    double sum = 0.0;
+    size_t p;
+
+    PROFILE_BEGIN("knn");
+    W = calculate_knn_norm(data_points, neighbors, radius);
+    PROFILE_END(PROFILE_PAIRS(data_points->rows) * 3.0 * data_points->cols);
+    if (W == NULL) { return NULL; }
+    for (p = 0; p < W->nnz; p++) { sum += W->val[p]; }
+    w_operator_csr(&W_operator, W);
+    optimized_H = run_symnmf_operator(&W_operator, sum / ((double)W->n * W->n), k, seed, options);
+    free_csr(W);
+    return optimized_H;
+}
+/*
+ * ===========================================RUN_SYMNMF_MAPPED====================================
+ * the algorithm on a W stored in a binary matrix file (norm -o), the file is mapped and read in
+ * place by every product instead of being loaded, so W may be larger than memory
+ * returns NULL on failure, no convergence or k >= N, caller is the handler
+*/
+static matrix* run_symnmf_mapped(const char *file_name, int k, unsigned long seed, const symnmf_options *options) {
+    const char *message;
+    matfile_mapping *mapping;
+    w_operator W_operator;
+    matrix *optimized_H = NULL;
+
+    mapping = matfile_map(file_name, &message);
+    if (mapping == NULL) { fprintf(stderr, "%s: %s\n", file_name, message); return NULL; }
+    if (mapping->layout == MATFILE_LAYOUT_PACKED && k < mapping->packed.n) {
+        w_operator_packed(&W_operator, &mapping->packed);
+        optimized_H = run_symnmf_operator(&W_operator, packed_mean(&mapping->packed), k, seed, options);
+    }
+    else if (mapping->layout == MATFILE_LAYOUT_DENSE && mapping->dense.rows == mapping->dense.cols && k < mapping->dense.rows) {
+        w_operator_dense(&W_operator, &mapping->dense);
+        optimized_H = run_symnmf_operator(&W_operator, operator_mean(&W_operator), k, seed, options);
+    }
+    matfile_unmap(mapping);
+    return optimized_H;
+}
+/*
+ * ===========================================PRINT_LABELS=========================================
+ * one label per line, returns 1 on success, 0 if the output could not be written
+*/
+static int print_labels(const matrix *labels) {
+    int i;
+    for (i = 0; i < labels->rows; i++) {
+        if (printf("%d\n", (int)MAT_AT(labels, i, 0)) < 0) { return 0; }
+    }
+    return 1;
+}
+/*
+ * ===========================================OUTPUT_SYMNMF========================================
+ * writes the result of the symnmf goal: H, or its labels with want_labels, printed or to output
+ * returns 1 on success, 0 if the output could not be written, -1 if there is nothing to write
+*/
+static int output_symnmf(const matrix *H, int want_labels, const char *output) {
+    matrix *labels = NULL;
+    int written;
+    if (H == NULL) { return -1; }
+    if (want_labels) {
+        labels = argmax_labels(H);
+        if (labels == NULL) { return -1; }
+    }
+    if (output != NULL) { written = matfile_write(output, want_labels ? labels : H); }
+    else if (want_labels) { written = print_labels(labels); }
+    else { written = print_matrix(H); }
+    free_matrix(labels);
+    return written;
+}
+/*
+ * ========================================PARSE_POSITIVE_INT======================================
+ * parses a strictly positive decimal integer command line value
+ * returns 1 on success, 0 if the string is not a positive integer
+*/
+int parse_positive_int(const char *str, int *value) {
+    char *end;
+    long parsed = strtol(str, &end, 10);
+    if (end == str || *end != '\0' || parsed <= 0 || parsed > 1000000000L) { return 0; }
+    *value = (int)parsed;
+    return 1;
+}
+/*
+ * ========================================PARSE_POSITIVE_DOUBLE===================================
+ * parses a strictly positive floating point command line value
+ * returns 1 on success, 0 if the string is not a positive number
+*/
+int parse_positive_double(const char *str, double *value) {
+    char *end;
+    double parsed = strtod(str, &end);
+    if (end == str || *end != '\0' || !(parsed > 0) || parsed > HUGE_VAL / 2) { return 0; }
+    *value = parsed;
+    return 1;
+}
+/*
+ * ========================================PARSE_SEED==============================================
+ * parses a seed in [0, 2^32), the range np.random.seed accepts
+ * returns 1 on success, 0 otherwise
+*/
+int parse_seed(const char *str, unsigned long *value) {
+    char *end;
+    unsigned long parsed;
+    if (*str < '0' || *str > '9') { return 0; } /* strtoul would accept a sign */
+    errno = 0;
+    parsed = strtoul(str, &end, 10);
+    if (end == str || *end != '\0' || errno != 0 || parsed > 0xffffffffUL) { return 0; }
+    *value = parsed;
+    return 1;
+}
+/*
+ * ========================================PRINT_SINGLE============================================
+ * the sym or norm goal with W stored as float, printed like the double goals print
+ * returns 1 on success, 0 if the output could not be written, -1 if W could not be computed
+*/
+static int print_single(const char *goal, const matrix *data_points) {
+    packed_matrix_f32 *W;
+    int written;
+    if (string_compare(goal, "sym") == 1) { W = calculate_sym_packed_f32(data_points); }
+    else { W = calculate_norm_packed_f32(data_points); }
+    if (W == NULL) { return -1; }
+    written = print_packed_f32(W);
+    free_packed_f32(W);
+    return written;
+}
+/*
+ * ========================================LOAD_POINTS=============================================
+ * reads the input points, binary matrix files are recognized by their magic, anything else is csv
+ * the reason of a failure goes to stderr unless quiet, returns NULL on failure, caller is the handler
+*/
+static matrix* load_points(const char *file_name, int quiet) {
+    const char *message;
+    csv_error load_error;
+    matrix *points;
+
+    if (matfile_is_binary(file_name)) {
+        PROFILE_BEGIN("parse");
+        points = matfile_read(file_name, &message);
+        PROFILE_END(0);
+        if (points == NULL && !quiet) { fprintf(stderr, "%s: %s\n", file_name, message); }
+        return points;
+    }
+    PROFILE_BEGIN("parse");
+    points = csv_load(file_name, &load_error);
+    PROFILE_END(0);
+    if (points == NULL && quiet) { return NULL; }
+    if (points == NULL && load_error.line > 0) {
+        fprintf(stderr, "%s:%lu:%lu: %s\n", file_name, (unsigned long)load_error.line, (unsigned long)load_error.column, load_error.message);
+    }
+    else if (points == NULL) { fprintf(stderr, "%s: %s\n", file_name, load_error.message); }
+    return points;
+}
+/*
+ * ===========================================RUN_SYMNMF_DISTRIBUTED===============================
+ * the algorithm split over procs processes of this machine (transport.c), each owning a block of
+ * rows of W and H. the processes are forked before anything runs in parallel, then each one loads
+ * the points itself as it would on a machine of its own. every process initializes the whole H
+ * with the seed and keeps its rows, the final H is gathered on all of them
+ * *rank tells the caller which process it is in, only rank 0 reports errors and prints
+ * returns NULL on failure or no convergence, caller is the handler
+*/
+static matrix* run_symnmf_distributed(const char *file_name, int k, unsigned long seed, int procs, const symnmf_options *options, int *rank) {
+    transport *t;
+    matrix *data_points, *init_H = NULL, own_H, *optimized_H = NULL;
+    distributed_w *W = NULL;
+    w_operator W_operator;
+    symnmf_result result;
+
+    *rank = 0;
+    t = transport_shm_spawn(procs);
+    if (t == NULL) { return NULL; }
+    *rank = t->rank;
+    data_points = load_points(file_name, t->rank != 0);
+    if (data_points != NULL && k < data_points->rows) { W = distributed_create(data_points, t); }
+    if (W != NULL) {
+        PROFILE_BEGIN("init_h");
+        init_H = init_h_uniform(W->N, k, W->mean, seed);
+        PROFILE_END(2.0 * W->N * k);
+    }
+    if (init_H != NULL) {
+        own_H = distributed_own_rows(W, init_H);
+        w_operator_distributed(&W_operator, W);
+        if (optimize_h_rows(&W_operator, &own_H, options, t, &result)) {
+            if (result.converged) { optimized_H = distributed_gather(W, result.H); }
+            free_matrix(result.H);
+        }
+    }
+    free_matrix(init_H); free_distributed(W); free_matrix(data_points);
+    t->close(t); /* a process that failed early closes its socket, which fails the others too */
+    return optimized_H;
+}
+/*
+ * ===========================================WRITE_PROFILE========================================
+ * writes the JSON of profile.c to the file given with -j, "-" for stderr, nothing without -j
+ * returns 1 on success, 0 if the file cannot be written
+*/
+static int write_profile(const char *file_name) {
+    FILE *file;
+    int ok;
+    if (file_name == NULL) { return 1; }
+    if (string_compare(file_name, "-") == 1) { return profile_write_json(stderr); }
+    file = fopen(file_name, "w");
+    if (file == NULL) { return 0; }
+    ok = profile_write_json(file);
+    return fclose(file) == 0 && ok;
 }
 /*
  * ================================================================================================
@@ -379,45 +1265,177 @@ double** optimize_h(double** W, double** init_H, int N, int k) {
  * ================================================================================================
 */
 int main(int argc, char *argv[]) {
-    char *goal; char *filename; int N = 0; int d = 0; double **data_points = NULL; double **sym_matrix = NULL; double **ddg_matrix = NULL; double **norm_matrix = NULL;
-    if (argc != 3) { printf("An Error Has Occurred\n"); return 1; }
-    goal = argv[1]; filename = argv[2];
-    data_points = read_data_points(filename, &N, &d); if (data_points == NULL) { printf("An Error Has Occurred\n"); return 1; }
-    if (string_compare(goal, "sym") == 1) {
-        sym_matrix = calculate_sym_matrix(data_points, N, d);
+    char *goal; char *filename; matrix *data_points = NULL; packed_matrix *sym_matrix = NULL; matrix *ddg_matrix = NULL; packed_matrix *norm_matrix = NULL;
+    matrix *optimized_H = NULL;
+    tiled_w *tiled_matrix = NULL;
+    const char *output = NULL; /* -o <file>, binary output instead of printing */
+    const char *profile = NULL; /* -j <file>, JSON of the stage timings */
+    int arg, written = 1, threads = 0, neighbors = 0, k = 0, want_labels = 0, single = 0, tile = 0, mapped = 0, tuned = 0, sparse = 0;
+    int landmarks = 0, sampling = NYSTROM_UNIFORM, report = 0; /* -L, -K and -E, approximate W of the symnmf goal */
+    int procs = 0, rank = 0; /* -p, the symnmf goal split over processes */
+    int resume = 0, method_given = 0, every_given = 0; /* -R, -m and -C */
+    symnmf_checkpoint *resumed = NULL;
+    symnmf_options options; /* -i, -e, -b, -m, -c and -C of the symnmf goal */
+    unsigned long seed = 1234; /* the np.random.seed of symnmf.py */
+    double radius = 0;
+    symnmf_default_options(&options);
+    for (arg = 1; arg < argc && argv[arg][0] == '-'; arg += 2) { /* options come before the goal */
+        if (string_compare(argv[arg], "-l") == 1) { want_labels = 1; arg--; continue; } /* -l, symnmf goal prints labels, takes no value */
+        if (string_compare(argv[arg], "-f") == 1) { single = 1; arg--; continue; } /* -f, float W for sym, norm and symnmf */
+        if (string_compare(argv[arg], "-w") == 1) { mapped = 1; arg--; continue; } /* -w, symnmf goal reads W itself from the file */
+        if (string_compare(argv[arg], "-E") == 1) { report = 1; arg--; continue; } /* -E, error of the -L or -K approximation to stderr */
+        if (string_compare(argv[arg], "-R") == 1) { resume = tuned = 1; arg--; continue; } /* -R, symnmf continues from the -c file */
+        if (arg + 1 == argc) { break; }
+        if (string_compare(argv[arg], "-t") == 1 && parse_positive_int(argv[arg + 1], &threads)) { continue; } /* -t <threads> */
+        if (string_compare(argv[arg], "-n") == 1 && parse_positive_int(argv[arg + 1], &neighbors)) { continue; } /* -n <neighbors>, knn goal */
+        if (string_compare(argv[arg], "-r") == 1 && parse_positive_double(argv[arg + 1], &radius)) { continue; } /* -r <radius>, knn goal */
+        if (string_compare(argv[arg], "-o") == 1) { output = argv[arg + 1]; continue; } /* -o <file>, sym, ddg, norm and symnmf */
+        if (string_compare(argv[arg], "-s") == 1 && parse_seed(argv[arg + 1], &seed)) { continue; } /* -s <seed>, symnmf goal */
+        if (string_compare(argv[arg], "-T") == 1 && parse_positive_int(argv[arg + 1], &tile)) { continue; } /* -T <tile>, W not stored */
+        if (string_compare(argv[arg], "-j") == 1) { profile = argv[arg + 1]; continue; } /* -j <file.json>, any goal */
+        if (string_compare(argv[arg], "-L") == 1 && parse_positive_int(argv[arg + 1], &landmarks)) { sampling = NYSTROM_UNIFORM; continue; } /* -L <m>, uniform landmarks */
+        if (string_compare(argv[arg], "-K") == 1 && parse_positive_int(argv[arg + 1], &landmarks)) { sampling = NYSTROM_KMEANSPP; continue; } /* -K <m>, k-means++ landmarks */
+        if (string_compare(argv[arg], "-p") == 1 && parse_positive_int(argv[arg + 1], &procs)) { continue; } /* -p <procs>, row blocks of symnmf */
+        tuned = 1; /* the rest tune the symnmf goal */
+        if (string_compare(argv[arg], "-i") == 1 && parse_positive_int(argv[arg + 1], &options.max_iter)) { continue; } /* -i <max_iter> */
+        if (string_compare(argv[arg], "-e") == 1 && parse_positive_double(argv[arg + 1], &options.eps)) { continue; } /* -e <eps> */
+        if (string_compare(argv[arg], "-b") == 1 && parse_positive_double(argv[arg + 1], &options.beta)) { continue; } /* -b <beta> */
+        if (string_compare(argv[arg], "-m") == 1 && (options.method = symnmf_method_from_name(argv[arg + 1])) >= 0) { method_given = 1; continue; } /* -m mu|momentum|hals */
+        if (string_compare(argv[arg], "-c") == 1) { options.checkpoint = argv[arg + 1]; continue; } /* -c <file>, checkpoints of symnmf */
+        if (string_compare(argv[arg], "-C") == 1 && parse_positive_int(argv[arg + 1], &options.checkpoint_every)) { every_given = 1; continue; } /* -C <iterations> */
+        printf("An Error Has Occurred\n"); return 1; /* unknown option */
+    }
+    if (arg < argc && (string_compare(argv[arg], "symnmf") == 1 || string_compare(argv[arg], "knn") == 1)) { /* symnmf|knn <k> <file> */
+        if (argc - arg != 3 || !parse_positive_int(argv[arg + 1], &k)) { printf("An Error Has Occurred\n"); return 1; }
+        goal = argv[arg]; filename = argv[arg + 2];
+        sparse = string_compare(goal, "knn") == 1;
+    }
+    else {
+        if (argc - arg != 2) { printf("An Error Has Occurred\n"); return 1; }
+        goal = argv[arg]; filename = argv[arg + 1];
+    }
+    if ((tile > 0 || mapped) && (single || (k == 0 && (mapped || string_compare(goal, "norm") != 1 || output != NULL)))) {
+        printf("An Error Has Occurred\n"); return 1; /* -T is for norm (printed) and symnmf, -w for symnmf */
+    }
+    if (tuned && k == 0) { printf("An Error Has Occurred\n"); return 1; } /* -i, -e, -b, -m, -c, -C and -R are for symnmf and knn */
+    if ((neighbors > 0 || radius > 0) && !sparse) { printf("An Error Has Occurred\n"); return 1; } /* -n and -r build the W of knn */
+    if (sparse && (tile > 0 || single || mapped || landmarks > 0 || report || procs > 0)) {
+        printf("An Error Has Occurred\n"); return 1; /* knn has its own sparse W */
+    }
+    if ((resume || every_given) && options.checkpoint == NULL) { printf("An Error Has Occurred\n"); return 1; } /* -R and -C need -c */
+    if ((landmarks > 0 || report) && (k == 0 || landmarks == 0 || tile > 0 || single || mapped)) {
+        printf("An Error Has Occurred\n"); return 1; /* -L and -K replace W of the symnmf goal, -E needs one of them */
+    }
+    if (procs > 0 && (k == 0 || tile > 0 || single || mapped || landmarks > 0 || options.checkpoint != NULL)) {
+        printf("An Error Has Occurred\n"); return 1; /* -p splits the W of the symnmf goal, checkpoints are of one process */
+    }
+    if (resume) { /* the method of the checkpoint unless -m names one, which must then match */
+        resumed = checkpoint_read(options.checkpoint, NULL);
+        if (resumed == NULL) { printf("An Error Has Occurred\n"); return 1; }
+        options.resume = resumed;
+        if (!method_given) { options.method = resumed->method; }
+    }
+    symnmf_set_threads(threads);
+    if (procs > 0) { /* the cores are shared between the processes unless -t says otherwise */
+        if (threads == 0) { symnmf_set_threads(symnmf_max_threads() / procs > 0 ? symnmf_max_threads() / procs : 1); }
+        optimized_H = run_symnmf_distributed(filename, k, seed, procs, &options, &rank);
+        if (rank != 0) { /* the other processes end here, rank 0 prints */
+            written = optimized_H != NULL;
+            free_matrix(optimized_H);
+            return written ? 0 : 1;
+        }
+        written = output_symnmf(optimized_H, want_labels, output);
+        free_matrix(optimized_H);
+        if (written != 1 || !write_profile(profile)) { printf("An Error Has Occurred\n"); return 1; }
+        return 0;
+    }
+    if (mapped) { /* the file is a binary W, streamed from disk by every product */
+        optimized_H = tile == 0 ? run_symnmf_mapped(filename, k, seed, &options) : NULL;
+        written = output_symnmf(optimized_H, want_labels, output);
+        free_matrix(optimized_H);
+        free_checkpoint(resumed);
+        if (written != 1 || !write_profile(profile)) { printf("An Error Has Occurred\n"); return 1; }
+        return 0;
+    }
+    data_points = load_points(filename, 0);
+    if (data_points == NULL) { printf("An Error Has Occurred\n"); free_checkpoint(resumed); return 1; }
+    if (tile == 0 && !single && landmarks == 0 && (string_compare(goal, "symnmf") == 1 || (string_compare(goal, "norm") == 1 && output == NULL))
+            && tiled_preferred(data_points->rows, data_points->cols, symnmf_max_threads())) {
+        tile = TILED_DEFAULT_TILE; /* W would not fit in memory, or regenerating it is faster than reading it */
+    }
+    if (single && output == NULL && (string_compare(goal, "sym") == 1 || string_compare(goal, "norm") == 1)) {
+        written = print_single(goal, data_points); /* binary files hold doubles, so -f prints only */
+        if (written == -1) {
+            printf("An Error Has Occurred\n");
+            free_matrix(data_points);
+            return 1;
+        }
+    }
+    else if (string_compare(goal, "sym") == 1 && !single) {
+        sym_matrix = calculate_sym_packed(data_points); /* A and W are symmetric, only the upper triangle is stored */
         if (sym_matrix == NULL) {
             printf("An Error Has Occurred\n");
-            free_matrix(data_points, N);
+            free_matrix(data_points);
             return 1;
         }
-        print_matrix(sym_matrix, N, N);
-        free_matrix(sym_matrix, N);
+        if (output != NULL) { written = matfile_write_packed(output, sym_matrix); }
+        else { written = print_packed(sym_matrix); }
+        free_packed(sym_matrix);
     }
     else if (string_compare(goal, "ddg") == 1) {
-        ddg_matrix = calculate_ddg_matrix(data_points, N, d);
+        ddg_matrix = calculate_ddg_matrix(data_points);
         if (ddg_matrix == NULL) {
             printf("An Error Has Occurred\n");
-            free_matrix(data_points, N);
+            free_matrix(data_points);
+            return 1;
+        }
+        if (output != NULL) { written = matfile_write(output, ddg_matrix); } /* N x 1 degrees */
+        else { written = print_diagonal(ddg_matrix); } /* D is printed densely but only its diagonal is stored */
+        free_matrix(ddg_matrix);
+    }
+    else if (string_compare(goal, "norm") == 1 && tile > 0) {
+        tiled_matrix = tiled_w_create(data_points, tile); /* rows of W are generated as they are printed */
+        if (tiled_matrix == NULL) {
+            printf("An Error Has Occurred\n");
+            free_matrix(data_points);
             return 1;
         }
-        print_matrix(ddg_matrix, N, N);
-        free_matrix(ddg_matrix, N);
+        written = print_tiled(tiled_matrix);
+        free_tiled_w(tiled_matrix);
     }
-    else if (string_compare(goal, "norm") == 1) {
-        norm_matrix = calculate_norm_matrix(data_points, N, d);
+    else if (string_compare(goal, "norm") == 1 && !single) {
+        norm_matrix = calculate_norm_packed(data_points);
         if (norm_matrix == NULL) {
             printf("An Error Has Occurred\n");
-            free_matrix(data_points, N);
+            free_matrix(data_points);
+            return 1;
+        }
+        if (output != NULL) { written = matfile_write_packed(output, norm_matrix); }
+        else { written = print_packed(norm_matrix); }
+        free_packed(norm_matrix);
+    }
+    else if ((string_compare(goal, "symnmf") == 1 || sparse) && k < data_points->rows) {
+        if (sparse) { optimized_H = run_symnmf_knn(data_points, k, seed, neighbors > 0 || radius > 0 ? neighbors : KNN_DEFAULT_NEIGHBORS, radius, &options); }
+        else if (landmarks > 0) { optimized_H = run_symnmf_nystrom(data_points, k, seed, landmarks, sampling, report, &options); }
+        else { optimized_H = run_symnmf(data_points, k, seed, single, tile, &options); }
+        written = output_symnmf(optimized_H, want_labels, output);
+        free_matrix(optimized_H);
+        free_checkpoint(resumed);
+        if (written == -1) {
+            printf("An Error Has Occurred\n");
+            free_matrix(data_points);
             return 1;
         }
-        print_matrix(norm_matrix, N, N);
-        free_matrix(norm_matrix, N);
     }
     else {
         printf("An Error Has Occurred\n");
+        free_matrix(data_points);
+        free_checkpoint(resumed);
         return 1; /* invalid goal */
     }
     /* free allocated memory */
-    free_matrix(data_points, N); /* free original matrix */
+    free_matrix(data_points); /* free original matrix */
+    if (!written || !write_profile(profile)) { printf("An Error Has Occurred\n"); return 1; }
     return 0;
 }
+#endif
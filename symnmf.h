@@ -1,8 +1,140 @@
-double** calculate_sym_matrix(double **data_points, int N, int d);
-double** calculate_ddg_matrix(double **data_points, int N, int d);
-double** calculate_norm_matrix(double **data_points, int N, int d);
-double** optimize_h(double** W, double** init_H, int N, int k);
-void free_matrix(double **matrix, int N);
+#include <stddef.h>
+
+/*
+ * contiguous row-major matrix, the header and the payload live in a single allocation.
+ * rows at least MATRIX_ALIGNMENT bytes wide are padded to `stride` doubles so that every
+ * row starts on a MATRIX_ALIGNMENT boundary, narrow matrices (points, H) stay dense
+ */
+#define MATRIX_ALIGNMENT 64
+typedef struct {
+    int rows;
+    int cols;
+    int stride;   /* distance in doubles between the starts of two consecutive rows */
+    double *data; /* first element of row 0, aligned to MATRIX_ALIGNMENT */
+} matrix;
+#define MAT_ROW(m, i) ((m)->data + (size_t)(i) * (size_t)(m)->stride)
+#define MAT_AT(m, i, j) (MAT_ROW(m, i)[j])
+
+/*
+ * the affinity W as optimize_h sees it: only the products W*H are needed, so each storage
+ * format supplies them through multiply(). workspace_alloc (NULL if none is needed) returns the
+ * scratch space multiply() uses for an H with k columns, optimize_h allocates it once per run
+ */
+typedef struct w_operator {
+    int N;
+    double entries;   /* entries of W one product reads, for FLOP estimates */
+    const void *data; /* the storage behind the operator, owned by the caller */
+    matrix* (*workspace_alloc)(const struct w_operator *op, int k);
+    void (*multiply)(const struct w_operator *op, const matrix *H, matrix *out, matrix *workspace);
+    double (*squared_norm)(const struct w_operator *op); /* ||W||_F^2 */
+} w_operator;
+
+/*
+ * the collectives of a row-partitioned run, where each of `size` processes owns a block of rows
+ * of W and H. allreduce_sum() replaces values with their element-wise sum over every process,
+ * the same bits on each of them. allgather() completes `all` in place: process r fills the rows
+ * [starts[r], starts[r + 1]) of `width` doubles each, and afterwards every process holds all of
+ * them. every process must make the same calls with the same sizes, in the same order
+ * both return 1 on success, 0 if the transport failed (a process died or memory ran out)
+ */
+typedef struct transport {
+    int rank;
+    int size;
+    void *data; /* state of the backend */
+    int (*allreduce_sum)(struct transport *t, double *values, int count);
+    int (*allgather)(struct transport *t, double *all, const int *starts, int width);
+    void (*close)(struct transport *t); /* frees the transport, on rank 0 after the other processes ended */
+} transport;
+
+/* update rules of optimize_h_run() */
+#define SYMNMF_METHOD_MU 0       /* damped multiplicative updates, the original algorithm */
+#define SYMNMF_METHOD_MOMENTUM 1 /* multiplicative updates from an extrapolated H, restarted when the fit worsens */
+#define SYMNMF_METHOD_HALS 2     /* penalized alternating least squares, solved column by column */
+
+/*
+ * what optimize_h_run() needs to continue a run after the given number of iterations: H, the
+ * extrapolated H of momentum or G of hals, the scalars of their step rules, and the residual of
+ * every iteration so far. with the same W, options and thread count the continued run ends
+ * exactly like one that was never interrupted
+ */
+typedef struct {
+    int method;       /* a SYMNMF_METHOD_ value */
+    int iterations;   /* iterations done, history holds as many residuals */
+    int products;     /* W*H products formed so far */
+    matrix *H;
+    matrix *extra;    /* NULL for mu */
+    double gamma;     /* momentum: extrapolation weight, its cap and the last fit */
+    double gamma_max;
+    double last_fit;
+    double penalty;   /* hals */
+    double *history;  /* NULL when iterations is 0 */
+} symnmf_checkpoint;
+
+#define SYMNMF_CHECKPOINT_EVERY 10 /* default iterations between two checkpoints */
+
+/* how optimize_h_run() iterates, symnmf_default_options() gives the original algorithm */
+typedef struct {
+    int max_iter;   /* counts the iterations before a resume too */
+    double eps;     /* converged once ||H_next - H||_F^2 < eps */
+    double beta;    /* damping of the multiplicative updates (mu, momentum) */
+    int method;     /* a SYMNMF_METHOD_ value */
+    double penalty; /* weight of ||G - H||_F^2 in hals, 0 picks one from the scale of init_H */
+    const char *checkpoint;           /* file the state is saved to, NULL for none */
+    int checkpoint_every;             /* iterations between two saves, <= 0 saves only at the end */
+    const symnmf_checkpoint *resume;  /* state to continue from instead of init_H, NULL to start */
+} symnmf_options;
+
+/* why optimize_h_run() failed, result->status */
+#define SYMNMF_STATUS_OK 0
+#define SYMNMF_STATUS_INVALID 1    /* the options or the shape of init_H, nothing ran */
+#define SYMNMF_STATUS_NO_MEMORY 2
+#define SYMNMF_STATUS_CHECKPOINT 3 /* the checkpoint file could not be written */
+#define SYMNMF_STATUS_TRANSPORT 4  /* another process of the run failed */
+
+/* what optimize_h_run() ends with, H is owned by the caller */
+typedef struct {
+    matrix *H;       /* the last H, also when it did not converge */
+    int iterations;
+    int converged;
+    double residual; /* ||H_next - H||_F^2 of the last iteration */
+    int products;    /* W*H products formed, the cost of a run */
+    int status;      /* a SYMNMF_STATUS_ value, SYMNMF_STATUS_OK unless the run failed */
+    int errnum;      /* errno of a SYMNMF_STATUS_CHECKPOINT failure, 0 if none was set */
+} symnmf_result;
+
+/* one (k, seed) run of symnmf_batch(), H is owned by the caller afterwards */
+typedef struct {
+    int k;
+    unsigned long seed;
+    matrix *H;
+    double objective; /* ||W - H*H^T||_F^2 */
+    int iterations;
+    int converged;
+} symnmf_job;
+
+matrix* matrix_alloc(int rows, int cols);
+void free_matrix(matrix *m);
+matrix* calculate_sym_matrix(const matrix *data_points);
+matrix* calculate_ddg_matrix(const matrix *data_points); /* N x 1, the diagonal of D */
+matrix* calculate_norm_matrix(const matrix *data_points);
+matrix* optimize_h(const matrix *W, const matrix *init_H);
+matrix* mat_multiply(const matrix *A, const matrix *B); /* the naive product, gemm_test.c checks gemm.c against it */
+matrix* optimize_h_op(const w_operator *W, const matrix *init_H);
+int optimize_h_run(const w_operator *W, const matrix *init_H, const symnmf_options *options, symnmf_result *result);
+int optimize_h_rows(const w_operator *W, const matrix *init_H, const symnmf_options *options, transport *t, symnmf_result *result);
+void symnmf_default_options(symnmf_options *options);
+int symnmf_options_valid(const symnmf_options *options);
+int symnmf_method_from_name(const char *name);
+double symnmf_objective(const w_operator *W, const matrix *H, double w_squared_norm);
+double operator_mean(const w_operator *W);
+int symnmf_batch(const w_operator *W, symnmf_job *jobs, int job_count, const symnmf_options *options);
+void w_operator_dense(w_operator *op, const matrix *W);
+matrix* init_h_uniform(int N, int k, double mean, unsigned long seed);
+matrix* argmax_labels(const matrix *H);
+double squared_euclidean_distance(const double *vec1, const double *vec2, int d);
+int print_matrix(const matrix *m);
+void symnmf_set_threads(int n);
+int symnmf_max_threads(void);
 
 /* C API methods, ifdef block in order to expose only if <Python.h> is included */
 #ifdef PY_SSIZE_T_CLEAN
@@ -10,5 +142,21 @@ void free_matrix(double **matrix, int N);
 PyObject* sym_capi(PyObject *self, PyObject *args);
 PyObject* ddg_capi(PyObject *self, PyObject *args);
 PyObject* norm_capi(PyObject *self, PyObject *args);
-PyObject* symnmf_capi(PyObject *self, PyObject *args);
+PyObject* norm_packed_capi(PyObject *self, PyObject *args);
+PyObject* symnmf_capi(PyObject *self, PyObject *args, PyObject *kwargs);
+PyObject* resume_capi(PyObject *self, PyObject *args, PyObject *kwargs);
+PyObject* load_checkpoint_capi(PyObject *self, PyObject *args);
+PyObject* knn_capi(PyObject *self, PyObject *args);
+PyObject* symnmf_csr_capi(PyObject *self, PyObject *args, PyObject *kwargs);
+PyObject* symnmf_tiled_capi(PyObject *self, PyObject *args, PyObject *kwargs);
+PyObject* symnmf_mapped_capi(PyObject *self, PyObject *args, PyObject *kwargs);
+PyObject* load_csv_capi(PyObject *self, PyObject *args);
+PyObject* load_capi(PyObject *self, PyObject *args);
+PyObject* save_capi(PyObject *self, PyObject *args);
+PyObject* batch_capi(PyObject *self, PyObject *args, PyObject *kwargs);
+PyObject* profile_capi(PyObject *self, PyObject *args);
+PyObject* kmeans_capi(PyObject *self, PyObject *args);
+PyObject* silhouette_capi(PyObject *self, PyObject *args);
+PyObject* incremental_capi(PyObject *self, PyObject *args);
+PyObject* nystrom_capi(PyObject *self, PyObject *args, PyObject *kwargs);
 #endif
@@ -12,16 +12,32 @@ def print_matrix(mat):
     for row in mat:
         print(','.join(['%.4f' % num for num in row]))
 
+'''
+==========================================PRINT_DIAGONAL=========================================
+prints the diagonal matrix with the given diagonal in the print_matrix format, row by row
+'''
+def print_diagonal(diagonal):
+    zeros = ['%.4f' % 0.0] * len(diagonal)
+    for i, value in enumerate(diagonal):
+        zeros[i] = '%.4f' % value
+        print(','.join(zeros))
+        zeros[i] = '%.4f' % 0.0
+
 '''
 ===========================================INIT_H===============================================
 this method initializes the H matrix for the symnmf algorithm
 '''
 def init_H(W, k):
-    m = np.array(W).mean() #convert to numpy array and get average cleanly
+    return init_H_from_mean(W.mean(), W.N, k) # W is a symnmf.Packed, its mean is taken in C
+
+'''
+=======================================INIT_H_FROM_MEAN=========================================
+same initialization given only the mean m of W, used for the sparse W where no dense copy exists
+'''
+def init_H_from_mean(m, N, k):
     upper_bound = 2 * np.sqrt(m/k)
-    N = len(W)
     init_H = np.random.uniform(low=0, high=upper_bound, size=(N,k)) # a random matrix of size Nxk with values in the legal interval
-    return init_H.tolist() #return as python matrix
+    return init_H # the C module reads the numpy array in place
 
 '''
 =================================================================================================
@@ -33,26 +49,33 @@ def main():
     k = int(sys.argv[1])
     goal = sys.argv[2]
     file_name = sys.argv[3]
+    neighbors = int(sys.argv[4]) if len(sys.argv) > 4 else 10 # only used by the knn goal
     
-    # parse the points into a python matrix using numpy's loadtxt
-    np_array = np.loadtxt(file_name, delimiter = ',')
-    data_points = np_array.tolist()
+    # parse the points with the C loader, the Matrix it returns is passed back without copying
+    data_points = symnmf.load_csv(file_name)
     
     # call the c module
     if goal == 'sym':
         res = symnmf.sym(data_points)
         print_matrix(res)
     elif goal == 'ddg':
-        res = symnmf.ddg(data_points)
-        print_matrix(res)
+        res = symnmf.ddg(data_points) # only the diagonal of D is returned
+        print_diagonal(res)
     elif goal == 'norm':
         res = symnmf.norm(data_points)
         print_matrix(res)
     elif goal == 'symnmf':
-        W = symnmf.norm(data_points)  
+        W = symnmf.norm_packed(data_points) # upper triangle only, half the memory of norm
         initial_H = init_H(W, k)        
         optimized_H = symnmf.symnmf(W, initial_H)  
         print_matrix(optimized_H)
+    elif goal == 'knn':
+        # sparse W from the nearest neighbor graph, kept in csr form (row_ptr, col, val)
+        W_csr = symnmf.knn(data_points, neighbors)
+        N = len(data_points)
+        initial_H = init_H_from_mean(sum(W_csr[2]) / (N * N), N, k) # entries outside the csr are 0
+        optimized_H = symnmf.symnmf_csr(W_csr, initial_H)
+        print_matrix(optimized_H)
         
     
 if __name__ == "__main__":
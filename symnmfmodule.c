@@ -1,12 +1,39 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <errno.h>
+#include <string.h>
 #include "symnmf.h"
+#include "packed.h"
+#include "sparse.h"
+#include "csv.h"
+#include "matfile.h"
+#include "tiled.h"
+#include "cluster.h"
+#include "incremental.h"
+#include "nystrom.h"
+#include "profile.h"
 
 static PyMethodDef symnmf_methods[] = {
-    {"sym", (PyCFunction)sym_capi, METH_VARARGS, "calculate similarity matrix A"},
-    {"ddg", (PyCFunction)ddg_capi, METH_VARARGS, "calculate diagonal degree matrix D"},
-    {"norm", (PyCFunction)norm_capi, METH_VARARGS, "calculates normalized similarity matrix W"},
-    {"symnmf", (PyCFunction)symnmf_capi, METH_VARARGS, "execute symnmf algorithm"},
+    {"sym", (PyCFunction)sym_capi, METH_VARARGS, "sym(points[, threads]) calculate similarity matrix A"},
+    {"ddg", (PyCFunction)ddg_capi, METH_VARARGS, "ddg(points[, threads]) calculate the diagonal of the degree matrix D"},
+    {"norm", (PyCFunction)norm_capi, METH_VARARGS, "norm(points[, threads]) calculates normalized similarity matrix W"},
+    {"norm_packed", (PyCFunction)norm_packed_capi, METH_VARARGS, "norm_packed(points[, threads]) W in packed storage as a symnmf.Packed, half the memory of norm(), for symnmf, resume and batch"},
+    {"symnmf", (PyCFunction)(void (*)(void))symnmf_capi, METH_VARARGS | METH_KEYWORDS, "symnmf(W, init_H[, threads], *, max_iter=300, eps=1e-4, beta=0.5, method='mu', penalty=0, info=False, checkpoint=None, checkpoint_every=10) execute symnmf algorithm, info returns (H, iterations, residual, converged)"},
+    {"resume", (PyCFunction)(void (*)(void))resume_capi, METH_VARARGS | METH_KEYWORDS, "resume(W, checkpoint[, threads], *, max_iter=300, eps=1e-4, beta=0.5, info=False, checkpoint_every=10) continue the symnmf run saved in the checkpoint file, which keeps being updated"},
+    {"load_checkpoint", (PyCFunction)load_checkpoint_capi, METH_VARARGS, "load_checkpoint(file_name) the state saved by a symnmf run with checkpoint as a dict"},
+    {"knn", (PyCFunction)knn_capi, METH_VARARGS, "knn(points, neighbors[, radius[, threads]]) sparse W as a (row_ptr, col, val) csr tuple"},
+    {"symnmf_csr", (PyCFunction)(void (*)(void))symnmf_csr_capi, METH_VARARGS | METH_KEYWORDS, "symnmf_csr(W_csr, init_H[, threads], **symnmf keywords) execute symnmf algorithm on a sparse W"},
+    {"symnmf_tiled", (PyCFunction)(void (*)(void))symnmf_tiled_capi, METH_VARARGS | METH_KEYWORDS, "symnmf_tiled(points, init_H[, tile[, threads]], **symnmf keywords) execute symnmf algorithm without storing W, it is regenerated in tiles"},
+    {"symnmf_mapped", (PyCFunction)(void (*)(void))symnmf_mapped_capi, METH_VARARGS | METH_KEYWORDS, "symnmf_mapped(file_name, init_H[, threads], **symnmf keywords) execute symnmf algorithm on a W file read through a memory mapping"},
+    {"load_csv", (PyCFunction)load_csv_capi, METH_VARARGS, "load_csv(file_name[, threads]) read comma separated points into a Matrix"},
+    {"load", (PyCFunction)load_capi, METH_VARARGS, "load(file_name) read a binary matrix file into a Matrix"},
+    {"save", (PyCFunction)save_capi, METH_VARARGS, "save(file_name, matrix[, packed]) write a binary matrix file"},
+    {"profile", (PyCFunction)profile_capi, METH_VARARGS, "profile([reset]) stages and iterations recorded by a SYMNMF_PROFILE build as a dict, reset clears them afterwards"},
+    {"kmeans", (PyCFunction)kmeans_capi, METH_VARARGS, "kmeans(points, k[, max_iter[, eps[, threads]]]) labels of kmeans.find_kmeans_labels as a one dimensional Matrix"},
+    {"silhouette", (PyCFunction)silhouette_capi, METH_VARARGS, "silhouette(points, labels[, threads]) mean silhouette coefficient of the labels, euclidean distances"},
+    {"incremental", (PyCFunction)incremental_capi, METH_VARARGS, "incremental(points[, threads]) W of the points as a symnmf.Incremental, which new points can extend"},
+    {"nystrom", (PyCFunction)(void (*)(void))nystrom_capi, METH_VARARGS | METH_KEYWORDS, "nystrom(points, landmarks[, threads], *, sampling='uniform', seed=1234) low-rank W from sampled landmark points as a symnmf.Nystrom"},
+    {"batch", (PyCFunction)(void (*)(void))batch_capi, METH_VARARGS | METH_KEYWORDS, "batch(W, jobs[, threads], *, max_iter=300, eps=1e-4, beta=0.5, method='mu', penalty=0) run symnmf for every (k, seed) job on one W, returns (H, objective, iterations, converged) per job"},
     {NULL, NULL, 0, NULL} 
 };
 static struct PyModuleDef symnmfmodule = {
@@ -16,8 +43,49 @@ static struct PyModuleDef symnmfmodule = {
     -1,
     symnmf_methods
 };
+static int default_threads = 1; /* runtime default captured at import, used when threads is omitted */
+static PyTypeObject MatrixType; /* symnmf.Matrix, defined below with its buffer protocol */
+static int matrix_type_ready(void);
+static PyTypeObject PackedType; /* symnmf.Packed, the packed W of symnmf.norm_packed() */
+static int packed_type_ready(void);
+static PyTypeObject IncrementalType; /* symnmf.Incremental, the state of symnmf.incremental() */
+static int incremental_type_ready(void);
+static PyTypeObject NystromType; /* symnmf.Nystrom, the factor of symnmf.nystrom() */
+static int nystrom_type_ready(void);
 PyMODINIT_FUNC PyInit_symnmf(void) {
-    return PyModule_Create(&symnmfmodule);
+    PyObject *module;
+    default_threads = symnmf_max_threads();
+    if (!matrix_type_ready() || !packed_type_ready() || !incremental_type_ready() || !nystrom_type_ready()) { return NULL; }
+    module = PyModule_Create(&symnmfmodule);
+    if (module == NULL) { return NULL; }
+    Py_INCREF(&MatrixType);
+    if (PyModule_AddObject(module, "Matrix", (PyObject *)&MatrixType) < 0) {
+        Py_DECREF(&MatrixType); Py_DECREF(module);
+        return NULL;
+    }
+    Py_INCREF(&PackedType);
+    if (PyModule_AddObject(module, "Packed", (PyObject *)&PackedType) < 0) {
+        Py_DECREF(&PackedType); Py_DECREF(module);
+        return NULL;
+    }
+    Py_INCREF(&IncrementalType);
+    if (PyModule_AddObject(module, "Incremental", (PyObject *)&IncrementalType) < 0) {
+        Py_DECREF(&IncrementalType); Py_DECREF(module);
+        return NULL;
+    }
+    Py_INCREF(&NystromType);
+    if (PyModule_AddObject(module, "Nystrom", (PyObject *)&NystromType) < 0) {
+        Py_DECREF(&NystromType); Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
+/*
+ * ===============================================USE_THREADS============================================
+ * applies the optional threads argument of a call to the calling thread, 0 means the default
+*/
+static void use_threads(int threads) {
+    symnmf_set_threads(threads > 0 ? threads : default_threads);
 }
 
 /*
@@ -25,232 +93,1724 @@ PyMODINIT_FUNC PyInit_symnmf(void) {
  * similarly to how we read input, this function takes python objects and builds the c matrix 
  * to reduce code repetition since a lot of functions in the module need this conversion
 */
-static double** py_to_c_matrix(PyObject* python_points_list, int *N, int *d) {
-    double **data_points;
+static matrix* py_to_c_matrix(PyObject* python_points_list) {
+    matrix *data_points;
+    PyObject *point, *py_coord;
+    double *row;
+    int N, d;
     int i, j;
     double c_coord;
 
-    if (!PyList_Check(python_points_list)) {
+    if (!PyList_Check(python_points_list) || PyList_Size(python_points_list) == 0) {
         PyErr_SetString(PyExc_TypeError, "An Error Has Occurred");
         return NULL;
     }
     /* parse number of points and their dimention */
-    *N = PyList_Size(python_points_list);
-    *d = PyList_Size(PyList_GetItem(python_points_list, 0)); /* length of first vector */
+    N = PyList_Size(python_points_list);
+    d = PyList_Size(PyList_GetItem(python_points_list, 0)); /* length of first vector */
+    if (d < 0) { return NULL; } /* error is raised by parsing function */
 
-    /* now we build a C 2D array with the python object */
-    data_points = (double **)malloc(*N * sizeof(double *));
+    /* now we build a single contiguous C matrix with the python object */
+    data_points = matrix_alloc(N, d);
     if (data_points == NULL) {
         PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
         return NULL; /* caller is the handler */
     }
-    for (i = 0; i < *N; i++) {
-        data_points[i] = (double *)malloc(*d * sizeof(double));
-        if (data_points[i] == NULL) {
-            for (j = 0; j < i; j++) { free(data_points[j]); }
-            free(data_points);
-            PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
-            return NULL; 
-        }
-        PyObject *point = PyList_GetItem(python_points_list, i);
-        if (point == NULL) { free_matrix(data_points, *N); return NULL; } /* error is raised by parsing function */
-        for (j = 0; j < *d; j++) {
-            PyObject *py_coord = PyList_GetItem(point, j);
-            if (py_coord == NULL) { free_matrix(data_points, *N); return NULL; } /* error is raised by parsing function */
+    for (i = 0; i < N; i++) {
+        point = PyList_GetItem(python_points_list, i);
+        if (point == NULL) { free_matrix(data_points); return NULL; } /* error is raised by parsing function */
+        row = MAT_ROW(data_points, i);
+        for (j = 0; j < d; j++) {
+            py_coord = PyList_GetItem(point, j);
+            if (py_coord == NULL) { free_matrix(data_points); return NULL; } /* error is raised by parsing function */
             c_coord = PyFloat_AsDouble(py_coord); /* actual conversion */
             /* if PyFloat() returns -1.0 then parsing has failed but we also need to consider that the coordinate itself can be -1.0 */
-            if (c_coord == -1.0 && PyErr_Occurred()) { free_matrix(data_points, *N); return NULL; } /* error is raised by parsing function */
-            data_points[i][j] = c_coord;
+            if (c_coord == -1.0 && PyErr_Occurred()) { free_matrix(data_points); return NULL; } /* error is raised by parsing function */
+            row[j] = c_coord;
         }
     }
     return data_points;
 }
 /*
- * =======================================C_TO_PY_MATRIX============================================
- * this function converts a C matrix back to a python object
+ * ===============================================PY_TO_PACKED_MATRIX====================================
+ * builds a packed symmetric C matrix from a square python list of lists, W is symmetric so only
+ * the entries on and above the diagonal are read
 */
-static PyObject* c_to_py_matrix(double **matrix, int N, int d) {
-    int i;
-    int j;
-    PyObject *py_matrix;
-    PyObject *py_row;
-    PyObject *py_coord;
+static packed_matrix* list_to_packed(PyObject* python_matrix) {
+    packed_matrix *packed;
+    PyObject *py_row, *py_value;
+    double *row;
+    int N;
+    int i, j;
+    double c_value;
 
-    py_matrix = PyList_New(N);
-    if (py_matrix == NULL) {
+    if (!PyList_Check(python_matrix) || PyList_Size(python_matrix) == 0) {
+        PyErr_SetString(PyExc_TypeError, "An Error Has Occurred");
+        return NULL;
+    }
+    N = PyList_Size(python_matrix);
+    packed = packed_alloc(N);
+    if (packed == NULL) {
         PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
-        /* no need to dereference anything here */
-        return NULL; /* error is raised by parsing function */
+        return NULL;
     }
     for (i = 0; i < N; i++) {
-        py_row = PyList_New(d);
-        if (py_row == NULL) {
-            PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
-            Py_DECREF(py_matrix); /* dereference the matrix */
-            return NULL; 
+        py_row = PyList_GetItem(python_matrix, i);
+        if (py_row == NULL) { free_packed(packed); return NULL; } /* error is raised by parsing function */
+        if (!PyList_Check(py_row) || PyList_Size(py_row) != N) { /* W must be square */
+            free_packed(packed);
+            PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+            return NULL;
         }
-        for (j = 0; j < d; j++) {
-            py_coord = PyFloat_FromDouble(matrix[i][j]);
-            if (py_coord == NULL) {
-                PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
-                Py_DECREF(py_row); /* dereference the row we created */
-                Py_DECREF(py_matrix);
-                return NULL;
-            }
-            PyList_SetItem(py_row, j, py_coord); /* put the i,j coordinate in the current python row */
+        row = PACKED_ROW(packed, i);
+        for (j = i; j < N; j++) {
+            py_value = PyList_GetItem(py_row, j);
+            c_value = PyFloat_AsDouble(py_value);
+            if (c_value == -1.0 && PyErr_Occurred()) { free_packed(packed); return NULL; } /* error is raised by parsing function */
+            row[j - i] = c_value;
+        }
+    }
+    return packed;
+}
+static packed_matrix* py_to_packed_matrix(PyObject* python_matrix) {
+    packed_matrix *packed;
+    PROFILE_BEGIN("py_to_c");
+    packed = list_to_packed(python_matrix);
+    PROFILE_END(0);
+    return packed;
+}
+/*
+ * ===============================================MATRIX_OBJECT==========================================
+ * symnmf.Matrix owns a C matrix and exposes its rows through the buffer protocol, so numpy.asarray()
+ * wraps the C allocation without copying. a vector (the degrees) is exposed as one dimensional.
+ * it is also a read only sequence of rows for code that iterates it like the old list of lists
+*/
+typedef struct {
+    PyObject_HEAD
+    matrix *m;
+    int ndim;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+} MatrixObject;
+
+static void Matrix_dealloc(MatrixObject *self) {
+    free_matrix(self->m);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+static int Matrix_getbuffer(MatrixObject *self, Py_buffer *view, int flags) {
+    const int contiguous = self->m->stride == self->m->cols || self->m->rows <= 1;
+    if (!contiguous && ((flags & PyBUF_STRIDES) != PyBUF_STRIDES || (flags & PyBUF_ANY_CONTIGUOUS) == PyBUF_ANY_CONTIGUOUS
+                        || (flags & PyBUF_C_CONTIGUOUS) == PyBUF_C_CONTIGUOUS || (flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS)) {
+        PyErr_SetString(PyExc_BufferError, "rows are padded, the consumer must accept strides");
+        view->obj = NULL;
+        return -1;
+    }
+    view->obj = (PyObject *)self;
+    Py_INCREF(self);
+    view->buf = self->m->data;
+    view->len = (Py_ssize_t)self->m->rows * self->m->cols * (Py_ssize_t)sizeof(double);
+    view->readonly = 0;
+    view->itemsize = sizeof(double);
+    view->format = (flags & PyBUF_FORMAT) ? "d" : NULL;
+    view->ndim = self->ndim;
+    view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+static Py_ssize_t Matrix_length(MatrixObject *self) {
+    return self->m->rows;
+}
+static PyObject* Matrix_item(MatrixObject *self, Py_ssize_t i) {
+    PyObject *py_row, *py_value;
+    int j;
+    if (i < 0 || i >= self->m->rows) {
+        PyErr_SetString(PyExc_IndexError, "row index out of range");
+        return NULL;
+    }
+    if (self->ndim == 1) { return PyFloat_FromDouble(MAT_AT(self->m, i, 0)); }
+    py_row = PyList_New(self->m->cols);
+    if (py_row == NULL) { return NULL; }
+    for (j = 0; j < self->m->cols; j++) {
+        py_value = PyFloat_FromDouble(MAT_AT(self->m, i, j));
+        if (py_value == NULL) { Py_DECREF(py_row); return NULL; }
+        PyList_SET_ITEM(py_row, j, py_value);
+    }
+    return py_row;
+}
+static PyObject* Matrix_tolist(MatrixObject *self, PyObject *unused) {
+    PyObject *py_list, *py_item;
+    Py_ssize_t i;
+    py_list = PyList_New(self->m->rows);
+    if (py_list == NULL) { return NULL; }
+    for (i = 0; i < self->m->rows; i++) {
+        py_item = Matrix_item(self, i);
+        if (py_item == NULL) { Py_DECREF(py_list); return NULL; }
+        PyList_SET_ITEM(py_list, i, py_item);
+    }
+    return py_list;
+}
+static PyObject* Matrix_get_shape(MatrixObject *self, void *closure) {
+    if (self->ndim == 1) { return Py_BuildValue("(n)", self->shape[0]); }
+    return Py_BuildValue("(nn)", self->shape[0], self->shape[1]);
+}
+static PyBufferProcs Matrix_as_buffer = {
+    (getbufferproc)Matrix_getbuffer,
+    NULL
+};
+static PySequenceMethods Matrix_as_sequence = {
+    (lenfunc)Matrix_length, NULL, NULL, (ssizeargfunc)Matrix_item
+};
+static PyMethodDef Matrix_methods[] = {
+    {"tolist", (PyCFunction)Matrix_tolist, METH_NOARGS, "copy the matrix into a list of lists"},
+    {NULL, NULL, 0, NULL}
+};
+static PyGetSetDef Matrix_getset[] = {
+    {"shape", (getter)Matrix_get_shape, NULL, "shape of the matrix", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+static PyTypeObject MatrixType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "symnmf.Matrix",
+};
+static int matrix_type_ready(void) {
+    MatrixType.tp_basicsize = sizeof(MatrixObject);
+    MatrixType.tp_dealloc = (destructor)Matrix_dealloc;
+    MatrixType.tp_as_sequence = &Matrix_as_sequence;
+    MatrixType.tp_as_buffer = &Matrix_as_buffer;
+    MatrixType.tp_flags = Py_TPFLAGS_DEFAULT;
+    MatrixType.tp_doc = "C owned float64 matrix, exposed through the buffer protocol";
+    MatrixType.tp_methods = Matrix_methods;
+    MatrixType.tp_getset = Matrix_getset;
+    return PyType_Ready(&MatrixType) == 0;
+}
+/*
+ * ===============================================MATRIX_TO_PY===========================================
+ * hands a C matrix over to a new symnmf.Matrix, which frees it when python is done with it
+ * the matrix is freed here if the object cannot be created
+*/
+static PyObject* matrix_to_py(matrix *m, int ndim) {
+    MatrixObject *obj;
+    PROFILE_BEGIN("c_to_py");
+    obj = PyObject_New(MatrixObject, &MatrixType);
+    PROFILE_END(0);
+    if (obj == NULL) {
+        free_matrix(m);
+        return NULL; /* error is raised by python */
+    }
+    obj->m = m;
+    obj->ndim = ndim;
+    obj->shape[0] = m->rows;
+    obj->shape[1] = m->cols;
+    obj->strides[0] = (Py_ssize_t)m->stride * (Py_ssize_t)sizeof(double);
+    obj->strides[1] = sizeof(double);
+    return (PyObject *)obj;
+}
+/*
+ * ===============================================PACKED_OBJECT==========================================
+ * symnmf.Packed owns a packed symmetric W, the upper triangle only, half the memory of the dense
+ * Matrix of norm(). it has no buffer: symnmf(), resume() and batch() run on the packed storage
+ * directly, mean() gives the mean entry for the initial H and tolist() the dense rows
+*/
+typedef struct {
+    PyObject_HEAD
+    packed_matrix *W;
+} PackedObject;
+
+static void Packed_dealloc(PackedObject *self) {
+    free_packed(self->W);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+static PyObject* Packed_mean(PackedObject *self, PyObject *unused) {
+    double mean;
+    Py_BEGIN_ALLOW_THREADS
+    mean = packed_mean(self->W);
+    Py_END_ALLOW_THREADS
+    return PyFloat_FromDouble(mean);
+}
+static PyObject* Packed_tolist(PackedObject *self, PyObject *unused) {
+    PyObject *py_list, *py_row, *py_value;
+    int i, j;
+    py_list = PyList_New(self->W->n);
+    if (py_list == NULL) { return NULL; }
+    for (i = 0; i < self->W->n; i++) {
+        py_row = PyList_New(self->W->n);
+        if (py_row == NULL) { Py_DECREF(py_list); return NULL; }
+        PyList_SET_ITEM(py_list, i, py_row);
+        for (j = 0; j < self->W->n; j++) {
+            py_value = PyFloat_FromDouble(PACKED_AT(self->W, i, j));
+            if (py_value == NULL) { Py_DECREF(py_list); return NULL; }
+            PyList_SET_ITEM(py_row, j, py_value);
+        }
+    }
+    return py_list;
+}
+static PyObject* Packed_get_size(PackedObject *self, void *closure) {
+    return PyLong_FromLong(self->W->n);
+}
+static PyMethodDef Packed_methods[] = {
+    {"mean", (PyCFunction)Packed_mean, METH_NOARGS, "mean() mean of the N^2 entries of W, for the initial H"},
+    {"tolist", (PyCFunction)Packed_tolist, METH_NOARGS, "copy W into a dense list of lists"},
+    {NULL, NULL, 0, NULL}
+};
+static PyGetSetDef Packed_getset[] = {
+    {"N", (getter)Packed_get_size, NULL, "number of points, W is N x N", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+static PyTypeObject PackedType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "symnmf.Packed",
+};
+static int packed_type_ready(void) {
+    PackedType.tp_basicsize = sizeof(PackedObject);
+    PackedType.tp_dealloc = (destructor)Packed_dealloc;
+    PackedType.tp_flags = Py_TPFLAGS_DEFAULT;
+    PackedType.tp_doc = "symmetric W stored as its upper triangle, see symnmf.norm_packed()";
+    PackedType.tp_methods = Packed_methods;
+    PackedType.tp_getset = Packed_getset;
+    return PyType_Ready(&PackedType) == 0;
+}
+/*
+ * ===============================================INPUT_MATRIX===========================================
+ * a matrix argument as the C core sees it. anything exporting a 2D float64 buffer whose rows are
+ * contiguous (numpy arrays, symnmf.Matrix) is read in place through a view, lists of lists are
+ * converted with py_to_c_matrix() as a slower fallback
+ * the buffer stays exported until release, so the array cannot be resized or freed while the
+ * computation runs without the GIL
+*/
+typedef struct {
+    matrix view;     /* what the C core reads, rows of the python buffer or of owned */
+    matrix *owned;   /* list input converted to C, NULL for buffer input */
+    Py_buffer buffer;
+    int has_buffer;
+} input_matrix;
+
+/* 1 if a buffer format is the native single value type code ('d' for float64, 'f' for float32) */
+static int is_native_format(const char *format, char code) {
+    const int one = 1;
+    if (format == NULL) { return 0; } /* NULL means unsigned bytes */
+    if (format[0] == '@' || format[0] == '=' || (format[0] == '<' && *(const char *)&one == 1)) { format++; }
+    return format[0] == code && format[1] == '\0';
+}
+static int input_matrix_view(PyObject *obj, input_matrix *in) {
+    Py_buffer *b = &in->buffer;
+    in->owned = NULL;
+    in->has_buffer = 0;
+    if (!PyList_Check(obj) && PyObject_CheckBuffer(obj)) {
+        if (PyObject_GetBuffer(obj, b, PyBUF_STRIDES | PyBUF_FORMAT) != 0) { return 0; } /* error is raised by python */
+        in->has_buffer = 1;
+        if (b->ndim != 2 || b->itemsize != sizeof(double) || !is_native_format(b->format, 'd') || b->shape[0] == 0
+                || b->shape[0] > 2147483647 || b->shape[1] > 2147483647 || b->strides[1] != (Py_ssize_t)sizeof(double)
+                || b->strides[0] % (Py_ssize_t)sizeof(double) != 0 || (b->shape[0] > 1 && b->strides[0] < b->shape[1] * (Py_ssize_t)sizeof(double))) {
+            PyBuffer_Release(b);
+            in->has_buffer = 0;
+            PyErr_SetString(PyExc_TypeError, "expected a 2D float64 array with contiguous rows");
+            return 0;
+        }
+        in->view.rows = (int)b->shape[0];
+        in->view.cols = (int)b->shape[1];
+        in->view.stride = b->shape[0] > 1 ? (int)(b->strides[0] / (Py_ssize_t)sizeof(double)) : (int)b->shape[1];
+        in->view.data = (double *)b->buf;
+        return 1;
+    }
+    in->owned = py_to_c_matrix(obj);
+    if (in->owned == NULL) { return 0; } /* error is raised by parsing function */
+    in->view = *in->owned;
+    return 1;
+}
+static int input_matrix_acquire(PyObject *obj, input_matrix *in) {
+    int acquired;
+    PROFILE_BEGIN("py_to_c");
+    acquired = input_matrix_view(obj, in);
+    PROFILE_END(0);
+    return acquired;
+}
+static void input_matrix_release(input_matrix *in) {
+    if (in->has_buffer) { PyBuffer_Release(&in->buffer); in->has_buffer = 0; }
+    free_matrix(in->owned);
+    in->owned = NULL;
+}
+/*
+ * ===============================================IS_FLOAT32_BUFFER======================================
+ * 1 if obj exports a float32 buffer, W given like this is kept in single precision
+*/
+static int is_float32_buffer(PyObject *obj) {
+    Py_buffer b;
+    int single;
+    if (PyList_Check(obj) || PyTuple_Check(obj) || !PyObject_CheckBuffer(obj)) { return 0; }
+    if (PyObject_GetBuffer(obj, &b, PyBUF_STRIDES | PyBUF_FORMAT) != 0) { PyErr_Clear(); return 0; } /* reported by the dense path */
+    single = b.itemsize == sizeof(float) && is_native_format(b.format, 'f');
+    PyBuffer_Release(&b);
+    return single;
+}
+/*
+ * ===============================================PY_TO_PACKED_F32=======================================
+ * copies the upper triangle of a square 2D float32 buffer (any strides) into float packed storage,
+ * a quarter of the memory of a dense float64 W. returns NULL with a python error set on failure
+*/
+static packed_matrix_f32* py_to_packed_f32(PyObject *obj) {
+    packed_matrix_f32 *packed = NULL;
+    Py_buffer b;
+    const char *src;
+    float *row;
+    int N, i, j;
+
+    if (PyObject_GetBuffer(obj, &b, PyBUF_STRIDES | PyBUF_FORMAT) != 0) { return NULL; } /* error is raised by python */
+    if (b.ndim != 2 || b.itemsize != sizeof(float) || !is_native_format(b.format, 'f')
+            || b.shape[0] == 0 || b.shape[0] != b.shape[1] || b.shape[0] > 2147483647) {
+        PyBuffer_Release(&b);
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    N = (int)b.shape[0];
+    PROFILE_BEGIN("py_to_c");
+    packed = packed_alloc_f32(N);
+    if (packed != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        for (i = 0; i < N; i++) {
+            src = (const char *)b.buf + (Py_ssize_t)i * b.strides[0];
+            row = PACKED_ROW(packed, i);
+            for (j = i; j < N; j++) { row[j - i] = *(const float *)(src + (Py_ssize_t)j * b.strides[1]); }
         }
-        PyList_SetItem(py_matrix, i, py_row); /* put the completed row in the python matrix */
+        Py_END_ALLOW_THREADS
     }
-    return py_matrix;
+    PROFILE_END(0);
+    PyBuffer_Release(&b);
+    if (packed == NULL) { PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred"); }
+    return packed;
+}
+/*
+ * ========================================POINTS_CAPI==============================================
+ * shared body of sym_capi, ddg_capi and norm_capi: parse (points[, threads]), run the given
+ * calculation on the points and return the result as a symnmf.Matrix
+*/
+static PyObject* points_capi(PyObject *args, matrix* (*calculate)(const matrix *), int ndim) {
+    PyObject *python_points;
+    int threads = 0;
+    input_matrix data_points;
+    matrix *result;
+
+    /* parse the python object */
+    if (!PyArg_ParseTuple(args, "O|i", &python_points, &threads)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    use_threads(threads);
+    /* view of the points, a numpy array is read in place */
+    if (!input_matrix_acquire(python_points, &data_points)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    Py_BEGIN_ALLOW_THREADS /* the C core touches no python objects, other threads may run meanwhile */
+    result = calculate(&data_points.view);
+    Py_END_ALLOW_THREADS
+    input_matrix_release(&data_points); /* we dont need the data points anymore */
+    if (result == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
+        return NULL;
+    }
+    return matrix_to_py(result, ndim); /* the C allocation becomes the python buffer */
 }
 /*
  * ========================================SYM_CAPI=================================================
  * this function is the C API for calling calculate_sym_matrix from python
 */
 PyObject* sym_capi(PyObject *self, PyObject *args) {
-    PyObject *python_points_list;
-    int N;
-    int d;
-    double **data_points;
-    double **sym_matrix;
-    PyObject *py_return_matrix;
+    return points_capi(args, calculate_sym_matrix, 2);
+}
+/*
+ * ========================================DDG_CAPI=================================================
+ * this function is the C API for calling calculate_ddg_matrix from python
+ * only the diagonal of D is returned, as a one dimensional Matrix of the N degrees
+*/
+PyObject* ddg_capi(PyObject *self, PyObject *args) {
+    return points_capi(args, calculate_ddg_matrix, 1);
+}
+/*
+ * ========================================NORM_CAPI=================================================
+ * this function is the C API for calling calculate_norm_matrix from python
+*/
+PyObject* norm_capi(PyObject *self, PyObject *args) {
+    return points_capi(args, calculate_norm_matrix, 2);
+}
+/*
+ * ========================================NORM_PACKED_CAPI==========================================
+ * norm(points[, threads]) computed by calculate_norm_packed() and kept packed in a symnmf.Packed
+*/
+PyObject* norm_packed_capi(PyObject *self, PyObject *args) {
+    PyObject *python_points;
+    int threads = 0;
+    input_matrix data_points;
+    packed_matrix *W;
+    PackedObject *obj;
+
+    if (!PyArg_ParseTuple(args, "O|i", &python_points, &threads)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    use_threads(threads);
+    if (!input_matrix_acquire(python_points, &data_points)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    Py_BEGIN_ALLOW_THREADS
+    W = calculate_norm_packed(&data_points.view);
+    Py_END_ALLOW_THREADS
+    input_matrix_release(&data_points);
+    if (W == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
+        return NULL;
+    }
+    obj = PyObject_New(PackedObject, &PackedType);
+    if (obj == NULL) {
+        free_packed(W);
+        return NULL; /* error is raised by python */
+    }
+    obj->W = W;
+    return (PyObject *)obj;
+}
+/*
+ * ========================================PARSE_METHOD============================================
+ * sets options->method from the method keyword, None keeps the default
+ * returns 1 on success, 0 with a ValueError for an unknown name
+*/
+static int parse_method(const char *name, symnmf_options *options) {
+    if (name == NULL) { return 1; }
+    options->method = symnmf_method_from_name(name);
+    if (options->method < 0) {
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return 0;
+    }
+    return 1;
+}
+/*
+ * ========================================RESULT_TO_PY============================================
+ * what symnmf returns for an optimize_h_run() that returned ok: H, or (H, iterations, residual,
+ * converged) with info. without info a run that did not converge raises RuntimeError. a failed
+ * run raises ValueError for invalid options and MemoryError if memory ran out
+*/
+static PyObject* result_to_py(int ok, symnmf_result *result, int info) {
+    if (!ok) {
+        PyErr_SetString(result->status == SYMNMF_STATUS_INVALID ? PyExc_ValueError
+            : result->status == SYMNMF_STATUS_NO_MEMORY ? PyExc_MemoryError : PyExc_RuntimeError, "An Error Has Occurred");
+        return NULL;
+    }
+    if (!result->converged && !info) {
+        free_matrix(result->H);
+        PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+        return NULL;
+    }
+    /* hand H over to python without copying */
+    if (info) {
+        return Py_BuildValue("(NidO)", matrix_to_py(result->H, 2), result->iterations, result->residual, result->converged ? Py_True : Py_False);
+    }
+    return matrix_to_py(result->H, 2);
+}
+/*
+ * ========================================OPTIMIZE_TO_PY==========================================
+ * optimize_h_run() without the GIL and its result for python as result_to_py() gives it. a
+ * checkpoint that could not be written raises OSError with the errno of the write
+*/
+static PyObject* optimize_to_py(const w_operator *W, const matrix *init_H, const symnmf_options *options, int info) {
+    symnmf_result result;
+    int ok;
+
+    Py_BEGIN_ALLOW_THREADS
+    ok = optimize_h_run(W, init_H, options, &result);
+    Py_END_ALLOW_THREADS
+    if (!ok && result.status == SYMNMF_STATUS_CHECKPOINT) {
+        if (result.errnum == ENOMEM) { return PyErr_NoMemory(); }
+        if (result.errnum == 0) {
+            PyErr_Format(PyExc_OSError, "%s: the checkpoint could not be written", options->checkpoint);
+            return NULL;
+        }
+        errno = result.errnum;
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, options->checkpoint);
+        return NULL;
+    }
+    return result_to_py(ok, &result, info);
+}
+/*
+ * ========================================OPTIMIZE_ON_PY_W========================================
+ * optimize_h_run() on a python W: a symnmf.Packed and a buffer are read in place, a list of lists
+ * is copied into packed storage (upper triangle only), which halves its C memory. a float32 buffer
+ * is copied into float packed storage, H and the sums of the update stay float64. python_init_H is
+ * NULL when options->resume holds the state to continue from
+*/
+static PyObject* optimize_on_py_w(PyObject *python_W_matrix, PyObject *python_init_H, const symnmf_options *options, int info) {
+    packed_matrix *W_packed = NULL;
+    packed_matrix_f32 *W_single = NULL;
+    input_matrix W_dense;
+    w_operator W_operator;
+    input_matrix init_H;
+    PyObject *py_H;
+
+    /* W as an operator over the python buffer or over a packed copy of the list */
+    W_dense.has_buffer = 0; W_dense.owned = NULL;
+    if (PyObject_TypeCheck(python_W_matrix, &PackedType)) { /* the call holds a reference, W outlives the run */
+        w_operator_packed(&W_operator, ((PackedObject *)python_W_matrix)->W);
+    }
+    else if (PyList_Check(python_W_matrix)) {
+        W_packed = py_to_packed_matrix(python_W_matrix);
+        if (W_packed == NULL) { return NULL; } /* error is raised by parsing function */
+        w_operator_packed(&W_operator, W_packed);
+    }
+    else if (is_float32_buffer(python_W_matrix)) {
+        W_single = py_to_packed_f32(python_W_matrix);
+        if (W_single == NULL) { return NULL; }
+        w_operator_packed_f32(&W_operator, W_single);
+    }
+    else {
+        if (!input_matrix_acquire(python_W_matrix, &W_dense)) { return NULL; }
+        w_operator_dense(&W_operator, &W_dense.view);
+    }
+    /* initial H, read in place when it is a buffer, a resumed run takes the shape of its H */
+    init_H.has_buffer = 0; init_H.owned = NULL;
+    if (python_init_H == NULL) { init_H.view = *options->resume->H; }
+    else if (!input_matrix_acquire(python_init_H, &init_H)) {
+        free_packed(W_packed); free_packed_f32(W_single); input_matrix_release(&W_dense);
+        return NULL;
+    }
+    if (init_H.view.rows != W_operator.N || (W_dense.has_buffer && W_dense.view.cols != W_dense.view.rows)) { /* shapes must agree */
+        free_packed(W_packed); free_packed_f32(W_single); input_matrix_release(&W_dense); input_matrix_release(&init_H);
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    
+    /* use optimize_h to execute the algorithm */
+    py_H = optimize_to_py(&W_operator, &init_H.view, options, info);
+    free_packed(W_packed); free_packed_f32(W_single); input_matrix_release(&W_dense); input_matrix_release(&init_H);
+    return py_H;
+}
+/* 
+ * ========================================SYMNMF_CAPI=============================================
+ * this function executes symnmf algorithm taking W matrix and initial H as parameters
+ * the keywords are the fields of symnmf_options. a run that does not converge raises like a failed
+ * one unless info is set, which returns the last H with (H, iterations, residual, converged).
+ * with checkpoint the state is saved to that file every checkpoint_every iterations and at the end
+*/
+PyObject* symnmf_capi(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"W", "init_H", "threads", "max_iter", "eps", "beta", "method", "penalty", "info", "checkpoint",
+        "checkpoint_every", NULL};
+    PyObject* python_W_matrix;
+    PyObject* python_init_H;
+    int threads = 0, info = 0;
+    const char *method = NULL;
+    symnmf_options options;
 
     /* parse the python object */
-    if (!PyArg_ParseTuple(args, "O", &python_points_list)) {
+    symnmf_default_options(&options);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|i$iddzdpzi", keywords, &python_W_matrix, &python_init_H, &threads,
+            &options.max_iter, &options.eps, &options.beta, &method, &options.penalty, &info, &options.checkpoint,
+            &options.checkpoint_every)) {
         return NULL; /* error is raised by parsing function */
     }
-    /* convert python object to C matrix using the helper method */
-    data_points = py_to_c_matrix(python_points_list, &N, &d);
-    if (data_points == NULL) {
+    if (!parse_method(method, &options)) { return NULL; }
+    use_threads(threads);
+    return optimize_on_py_w(python_W_matrix, python_init_H, &options, info);
+}
+/*
+ * ========================================READ_CHECKPOINT=========================================
+ * checkpoint_read() with the error raised, OSError if the file cannot be opened
+*/
+static symnmf_checkpoint* read_checkpoint(const char *file_name) {
+    const char *message = NULL;
+    symnmf_checkpoint *c;
+
+    Py_BEGIN_ALLOW_THREADS
+    c = checkpoint_read(file_name, &message);
+    Py_END_ALLOW_THREADS
+    if (c == NULL) {
+        if (message != NULL && strcmp(message, "cannot open file") == 0) { PyErr_SetFromErrnoWithFilename(PyExc_OSError, file_name); }
+        else { PyErr_Format(PyExc_ValueError, "%s: %s", file_name, message); }
+    }
+    return c;
+}
+/*
+ * ========================================RESUME_CAPI=============================================
+ * continues the run saved in the checkpoint file with the same W and the method of the file, and
+ * keeps saving to it. max_iter counts the iterations before the checkpoint too, so the same
+ * max_iter and eps end where the uninterrupted run ends, with the same H
+*/
+PyObject* resume_capi(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"W", "checkpoint", "threads", "max_iter", "eps", "beta", "info", "checkpoint_every", NULL};
+    PyObject *python_W_matrix, *py_H;
+    int threads = 0, info = 0;
+    symnmf_options options;
+    symnmf_checkpoint *resumed;
+
+    symnmf_default_options(&options);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Os|i$iddpi", keywords, &python_W_matrix, &options.checkpoint, &threads,
+            &options.max_iter, &options.eps, &options.beta, &info, &options.checkpoint_every)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    use_threads(threads);
+    resumed = read_checkpoint(options.checkpoint);
+    if (resumed == NULL) { return NULL; }
+    options.resume = resumed;
+    options.method = resumed->method;
+    py_H = optimize_on_py_w(python_W_matrix, NULL, &options, info);
+    free_checkpoint(resumed);
+    return py_H;
+}
+/*
+ * ========================================LOAD_CHECKPOINT_CAPI====================================
+ * the state saved in a checkpoint file as a dict, H and extra (G of hals, the extrapolated point
+ * of momentum, None for mu) as Matrix objects and the residual of every iteration as a list
+*/
+PyObject* load_checkpoint_capi(PyObject *self, PyObject *args) {
+    static const char *method_names[] = {"mu", "momentum", "hals"};
+    const char *file_name;
+    symnmf_checkpoint *c;
+    PyObject *history, *item, *py_extra, *py_dict;
+    int i;
+
+    if (!PyArg_ParseTuple(args, "s", &file_name)) {
         return NULL; /* error is raised by parsing function */
     }
-    /* calculate the symmetric matrix */
-    sym_matrix = calculate_sym_matrix(data_points, N, d);
-    free_matrix(data_points, N); /* we dont need the data points anymore */
-    if (sym_matrix == NULL) {
+    c = read_checkpoint(file_name);
+    if (c == NULL) { return NULL; }
+    history = PyList_New(c->iterations);
+    for (i = 0; history != NULL && i < c->iterations; i++) {
+        item = PyFloat_FromDouble(c->history[i]);
+        if (item == NULL) { Py_CLEAR(history); break; }
+        PyList_SET_ITEM(history, i, item);
+    }
+    if (history == NULL) { free_checkpoint(c); return NULL; }
+    /* hand H and extra over to python without copying */
+    if (c->extra != NULL) { py_extra = matrix_to_py(c->extra, 2); }
+    else { Py_INCREF(Py_None); py_extra = Py_None; }
+    py_dict = Py_BuildValue("{s:s,s:i,s:i,s:N,s:N,s:N,s:d,s:d,s:d,s:d}", "method", method_names[c->method],
+        "iterations", c->iterations, "products", c->products, "H", matrix_to_py(c->H, 2), "extra", py_extra,
+        "history", history, "gamma", c->gamma, "gamma_max", c->gamma_max, "last_fit", c->last_fit, "penalty", c->penalty);
+    c->H = NULL; c->extra = NULL;
+    free_checkpoint(c);
+    return py_dict;
+}
+/*
+ * ========================================C_TO_PY_CSR=============================================
+ * converts a csr matrix to a python (row_ptr, col, val) tuple of flat lists
+*/
+static PyObject* csr_to_lists(const csr_matrix *m) {
+    PyObject *row_ptr, *col, *val, *item;
+    size_t p;
+    int i;
+
+    row_ptr = PyList_New(m->n + 1);
+    col = PyList_New((Py_ssize_t)m->nnz);
+    val = PyList_New((Py_ssize_t)m->nnz);
+    if (row_ptr == NULL || col == NULL || val == NULL) {
+        Py_XDECREF(row_ptr); Py_XDECREF(col); Py_XDECREF(val);
         PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
-        return NULL; 
+        return NULL;
+    }
+    for (i = 0; i <= m->n; i++) {
+        item = PyLong_FromSize_t(m->row_ptr[i]);
+        if (item == NULL) { Py_DECREF(row_ptr); Py_DECREF(col); Py_DECREF(val); return NULL; }
+        PyList_SET_ITEM(row_ptr, i, item);
+    }
+    for (p = 0; p < m->nnz; p++) {
+        item = PyLong_FromLong(m->col[p]);
+        if (item == NULL) { Py_DECREF(row_ptr); Py_DECREF(col); Py_DECREF(val); return NULL; }
+        PyList_SET_ITEM(col, (Py_ssize_t)p, item);
+        item = PyFloat_FromDouble(m->val[p]);
+        if (item == NULL) { Py_DECREF(row_ptr); Py_DECREF(col); Py_DECREF(val); return NULL; }
+        PyList_SET_ITEM(val, (Py_ssize_t)p, item);
     }
-    /* convert the C matrix to a python object */
-    py_return_matrix = c_to_py_matrix(sym_matrix, N, N);
-    free_matrix(sym_matrix, N); /* we dont need the symetric matrix anymore */
-    if (py_return_matrix == NULL) {
+    return Py_BuildValue("(NNN)", row_ptr, col, val); /* steals the three references */
+}
+static PyObject* c_to_py_csr(const csr_matrix *m) {
+    PyObject *lists;
+    PROFILE_BEGIN("c_to_py");
+    lists = csr_to_lists(m);
+    PROFILE_END(0);
+    return lists;
+}
+/*
+ * ========================================PY_TO_CSR===============================================
+ * converts a python (row_ptr, col, val) tuple back to a csr matrix, checking its structure
+*/
+static csr_matrix* lists_to_csr(PyObject *py_csr) {
+    PyObject *row_ptr, *col, *val;
+    csr_matrix *m;
+    Py_ssize_t n, nnz, p;
+    size_t offset;
+    long index;
+    int i;
+
+    if (!PyArg_ParseTuple(py_csr, "O!O!O!", &PyList_Type, &row_ptr, &PyList_Type, &col, &PyList_Type, &val)) {
         return NULL; /* error is raised by parsing function */
     }
-    return py_return_matrix; 
+    n = PyList_Size(row_ptr) - 1;
+    nnz = PyList_Size(col);
+    if (n < 0 || n > 2147483647 || PyList_Size(val) != nnz) {
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    m = csr_alloc((int)n, (size_t)nnz);
+    if (m == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
+        return NULL;
+    }
+    for (i = 0; i <= (int)n; i++) {
+        offset = PyLong_AsSize_t(PyList_GET_ITEM(row_ptr, i));
+        if (PyErr_Occurred() || offset > (size_t)nnz || (i > 0 && offset < m->row_ptr[i - 1]) || (i == 0 && offset != 0)) {
+            free_csr(m);
+            if (!PyErr_Occurred()) { PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); }
+            return NULL;
+        }
+        m->row_ptr[i] = offset;
+    }
+    if (m->row_ptr[n] != (size_t)nnz) { free_csr(m); PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); return NULL; }
+    for (p = 0; p < nnz; p++) {
+        index = PyLong_AsLong(PyList_GET_ITEM(col, p));
+        m->val[p] = PyFloat_AsDouble(PyList_GET_ITEM(val, p));
+        if (PyErr_Occurred() || index < 0 || index >= (long)n) {
+            free_csr(m);
+            if (!PyErr_Occurred()) { PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); }
+            return NULL;
+        }
+        m->col[p] = (int)index;
+    }
+    return m;
+}
+static csr_matrix* py_to_csr(PyObject *py_csr) {
+    csr_matrix *m;
+    PROFILE_BEGIN("py_to_c");
+    m = lists_to_csr(py_csr);
+    PROFILE_END(0);
+    return m;
 }
 /*
- * ========================================DDG_CAPI=================================================
- * this function is the C API for calling calculate_ddg_matrix from python
- * it is almost identical to the sym_capi function but calls calculate_ddg_matrix instead of calculate_sym_matrix
+ * ========================================KNN_CAPI================================================
+ * this function is the C API for calling calculate_knn_norm from python
 */
-PyObject* ddg_capi(PyObject *self, PyObject *args) {
+PyObject* knn_capi(PyObject *self, PyObject *args) {
     PyObject *python_points_list;
-    int N;
-    int d;
-    double **data_points;
-    double **ddg_matrix;
-    PyObject *py_return_matrix;
+    int neighbors;
+    double radius = 0.0;
+    int threads = 0;
+    input_matrix data_points;
+    csr_matrix *knn_matrix;
+    PyObject *py_return;
 
-    /* parse the python object */
-    if (!PyArg_ParseTuple(args, "O", &python_points_list)) {
+    if (!PyArg_ParseTuple(args, "Oi|di", &python_points_list, &neighbors, &radius, &threads)) {
         return NULL; /* error is raised by parsing function */
     }
-    /* convert python object to C matrix using the helper method */
-    data_points = py_to_c_matrix(python_points_list, &N, &d);
-    if (data_points == NULL) {
+    if (neighbors < 0 || radius < 0 || (neighbors == 0 && radius == 0)) {
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    use_threads(threads);
+    if (!input_matrix_acquire(python_points_list, &data_points)) {
         return NULL; /* error is raised by parsing function */
     }
-    /* calculate the degree matrix */
-    ddg_matrix = calculate_ddg_matrix(data_points, N, d);
-    free_matrix(data_points, N); /* we dont need the data points anymore */
-    if (ddg_matrix == NULL) {
+    Py_BEGIN_ALLOW_THREADS
+    PROFILE_BEGIN("knn");
+    knn_matrix = calculate_knn_norm(&data_points.view, neighbors, radius);
+    PROFILE_END(PROFILE_PAIRS(data_points.view.rows) * 3.0 * data_points.view.cols);
+    Py_END_ALLOW_THREADS
+    input_matrix_release(&data_points);
+    if (knn_matrix == NULL) {
         PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
-        return NULL; 
+        return NULL;
     }
-    /* convert the C matrix to a python object */
-    py_return_matrix = c_to_py_matrix(ddg_matrix, N, N);
-    free_matrix(ddg_matrix, N); /* we dont need the degree matrix anymore */
-    if (py_return_matrix == NULL) {
+    py_return = c_to_py_csr(knn_matrix);
+    free_csr(knn_matrix);
+    return py_return;
+}
+/*
+ * ========================================SYMNMF_CSR_CAPI=========================================
+ * this function executes symnmf algorithm on a sparse W in the (row_ptr, col, val) form of knn()
+ * the keywords are those of symnmf()
+*/
+PyObject* symnmf_csr_capi(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"W_csr", "init_H", "threads", "max_iter", "eps", "beta", "method", "penalty", "info", "checkpoint",
+        "checkpoint_every", NULL};
+    PyObject *python_W_csr;
+    PyObject *python_init_H;
+    PyObject *py_H;
+    int threads = 0, info = 0;
+    const char *method = NULL;
+    symnmf_options options;
+    csr_matrix *W_matrix;
+    w_operator W_operator;
+    input_matrix init_H;
+
+    symnmf_default_options(&options);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O|i$iddzdpzi", keywords, &PyTuple_Type, &python_W_csr, &python_init_H, &threads,
+            &options.max_iter, &options.eps, &options.beta, &method, &options.penalty, &info, &options.checkpoint,
+            &options.checkpoint_every)) {
         return NULL; /* error is raised by parsing function */
     }
-    return py_return_matrix; 
+    if (!parse_method(method, &options)) { return NULL; }
+    use_threads(threads);
+    W_matrix = py_to_csr(python_W_csr);
+    if (W_matrix == NULL) { return NULL; } /* error is raised by parsing function */
+    if (!input_matrix_acquire(python_init_H, &init_H)) { free_csr(W_matrix); return NULL; }
+    if (init_H.view.rows != W_matrix->n) { /* shapes must agree */
+        free_csr(W_matrix); input_matrix_release(&init_H);
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    w_operator_csr(&W_operator, W_matrix);
+    py_H = optimize_to_py(&W_operator, &init_H.view, &options, info);
+    free_csr(W_matrix);
+    input_matrix_release(&init_H);
+    return py_H;
 }
 /*
- * ========================================NORM_CAPI=================================================
- * this function is the C API for calling calculate_norm_matrix from python
- * it is almost identical to the sym_capi function but calls calculate_norm_matrix instead of calculate_sym_matrix
+ * ========================================SYMNMF_TILED_CAPI=======================================
+ * this function executes symnmf algorithm on the points without storing W: every product
+ * regenerates W in tile x tile blocks (tile 0 or missing picks the default), the memory is
+ * O(N*k + tile^2) per thread and the result matches symnmf(norm(points), init_H) with the
+ * same keywords
 */
-PyObject* norm_capi(PyObject *self, PyObject *args) {
-    PyObject *python_points_list;
-    int N;
-    int d;
-    double **data_points;
-    double **norm_matrix;
-    PyObject *py_return_matrix;
+PyObject* symnmf_tiled_capi(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"points", "init_H", "tile", "threads", "max_iter", "eps", "beta", "method", "penalty", "info",
+        "checkpoint", "checkpoint_every", NULL};
+    PyObject *python_points, *python_init_H, *py_H;
+    int tile = 0, threads = 0, info = 0;
+    const char *method = NULL;
+    symnmf_options options;
+    input_matrix data_points, init_H;
+    tiled_w *W_tiled;
+    w_operator W_operator;
 
-    /* parse the python object */
-    if (!PyArg_ParseTuple(args, "O", &python_points_list)) {
+    symnmf_default_options(&options);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|ii$iddzdpzi", keywords, &python_points, &python_init_H, &tile, &threads,
+            &options.max_iter, &options.eps, &options.beta, &method, &options.penalty, &info, &options.checkpoint,
+            &options.checkpoint_every)) {
         return NULL; /* error is raised by parsing function */
     }
-    /* convert python object to C matrix using the helper method */
-    data_points = py_to_c_matrix(python_points_list, &N, &d);
-    if (data_points == NULL) {
+    if (!parse_method(method, &options)) { return NULL; }
+    use_threads(threads);
+    if (!input_matrix_acquire(python_points, &data_points)) { return NULL; }
+    if (!input_matrix_acquire(python_init_H, &init_H)) { input_matrix_release(&data_points); return NULL; }
+    if (init_H.view.rows != data_points.view.rows || tile < 0) { /* shapes must agree */
+        input_matrix_release(&data_points); input_matrix_release(&init_H);
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    W_tiled = tiled_w_create(&data_points.view, tile);
+    Py_END_ALLOW_THREADS
+    if (W_tiled == NULL) {
+        input_matrix_release(&data_points); input_matrix_release(&init_H);
+        PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
+        return NULL;
+    }
+    w_operator_tiled(&W_operator, W_tiled);
+    py_H = optimize_to_py(&W_operator, &init_H.view, &options, info);
+    free_tiled_w(W_tiled);
+    input_matrix_release(&data_points); input_matrix_release(&init_H);
+    return py_H;
+}
+/*
+ * ========================================SYMNMF_MAPPED_CAPI======================================
+ * this function executes symnmf algorithm on a W saved as a binary matrix file (save() or norm -o),
+ * the file is memory mapped and read in place by every product, so W may be larger than memory
+ * the keywords are those of symnmf()
+*/
+PyObject* symnmf_mapped_capi(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"file_name", "init_H", "threads", "max_iter", "eps", "beta", "method", "penalty", "info",
+        "checkpoint", "checkpoint_every", NULL};
+    const char *file_name, *message = NULL, *method = NULL;
+    PyObject *python_init_H, *py_H;
+    int threads = 0, info = 0, N;
+    symnmf_options options;
+    matfile_mapping *mapping;
+    w_operator W_operator;
+    input_matrix init_H;
+
+    symnmf_default_options(&options);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|i$iddzdpzi", keywords, &file_name, &python_init_H, &threads,
+            &options.max_iter, &options.eps, &options.beta, &method, &options.penalty, &info, &options.checkpoint,
+            &options.checkpoint_every)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    if (!parse_method(method, &options)) { return NULL; }
+    use_threads(threads);
+    Py_BEGIN_ALLOW_THREADS
+    mapping = matfile_map(file_name, &message);
+    Py_END_ALLOW_THREADS
+    if (mapping == NULL) {
+        PyErr_Format(PyExc_OSError, "%s: %s", file_name, message);
+        return NULL;
+    }
+    if (mapping->layout == MATFILE_LAYOUT_PACKED) { w_operator_packed(&W_operator, &mapping->packed); }
+    else { w_operator_dense(&W_operator, &mapping->dense); }
+    N = mapping->layout == MATFILE_LAYOUT_PACKED ? mapping->packed.n : mapping->dense.rows;
+    if (!input_matrix_acquire(python_init_H, &init_H)) { matfile_unmap(mapping); return NULL; }
+    if (init_H.view.rows != N || (mapping->layout == MATFILE_LAYOUT_DENSE && mapping->dense.cols != N)) { /* shapes must agree */
+        matfile_unmap(mapping); input_matrix_release(&init_H);
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    py_H = optimize_to_py(&W_operator, &init_H.view, &options, info);
+    matfile_unmap(mapping);
+    input_matrix_release(&init_H);
+    return py_H;
+}
+/*
+ * ========================================LOAD_CSV_CAPI===========================================
+ * this function is the C API for calling csv_load from python, the points come back as a Matrix
+ * malformed input raises ValueError naming the line and column, an unreadable file raises OSError
+*/
+PyObject* load_csv_capi(PyObject *self, PyObject *args) {
+    const char *file_name;
+    int threads = 0;
+    csv_error error;
+    matrix *points;
+
+    if (!PyArg_ParseTuple(args, "s|i", &file_name, &threads)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    use_threads(threads);
+    Py_BEGIN_ALLOW_THREADS
+    PROFILE_BEGIN("parse");
+    points = csv_load(file_name, &error);
+    PROFILE_END(0);
+    Py_END_ALLOW_THREADS
+    if (points == NULL) {
+        if (error.line > 0) {
+            PyErr_Format(PyExc_ValueError, "%s:%zu:%zu: %s", file_name, error.line, error.column, error.message);
+        }
+        else if (error.errnum == ENOMEM) { PyErr_NoMemory(); }
+        else if (error.errnum != 0) {
+            errno = error.errnum;
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, file_name);
+        }
+        else { PyErr_Format(PyExc_ValueError, "%s: %s", file_name, error.message); }
+        return NULL;
+    }
+    return matrix_to_py(points, 2);
+}
+/*
+ * ========================================LOAD_CAPI===============================================
+ * this function is the C API for calling matfile_read from python, a packed file comes back dense
+*/
+PyObject* load_capi(PyObject *self, PyObject *args) {
+    const char *file_name;
+    const char *message = NULL;
+    matrix *loaded;
+
+    if (!PyArg_ParseTuple(args, "s", &file_name)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    Py_BEGIN_ALLOW_THREADS
+    PROFILE_BEGIN("parse");
+    loaded = matfile_read(file_name, &message);
+    PROFILE_END(0);
+    Py_END_ALLOW_THREADS
+    if (loaded == NULL) {
+        if (message != NULL && strcmp(message, "cannot open file") == 0) { PyErr_SetFromErrnoWithFilename(PyExc_OSError, file_name); }
+        else { PyErr_Format(PyExc_ValueError, "%s: %s", file_name, message); }
+        return NULL;
+    }
+    return matrix_to_py(loaded, 2);
+}
+/*
+ * ========================================SAVE_CAPI===============================================
+ * this function is the C API for calling matfile_write from python
+ * with packed set the matrix must be square and only its upper triangle is written
+*/
+PyObject* save_capi(PyObject *self, PyObject *args) {
+    const char *file_name;
+    PyObject *python_matrix;
+    int packed = 0, written, i, j;
+    input_matrix m;
+    packed_matrix *triangle = NULL;
+
+    if (!PyArg_ParseTuple(args, "sO|p", &file_name, &python_matrix, &packed)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    if (!input_matrix_acquire(python_matrix, &m)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    if (packed) {
+        triangle = m.view.rows == m.view.cols ? packed_alloc(m.view.rows) : NULL;
+        if (triangle == NULL) {
+            input_matrix_release(&m);
+            PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+            return NULL;
+        }
+        for (i = 0; i < m.view.rows; i++) {
+            for (j = i; j < m.view.cols; j++) { PACKED_ROW(triangle, i)[j - i] = MAT_AT(&m.view, i, j); }
+        }
+    }
+    Py_BEGIN_ALLOW_THREADS
+    written = triangle != NULL ? matfile_write_packed(file_name, triangle) : matfile_write(file_name, &m.view);
+    Py_END_ALLOW_THREADS
+    free_packed(triangle);
+    input_matrix_release(&m);
+    if (!written) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, file_name);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+/*
+ * ========================================BATCH_CAPI==============================================
+ * this function is the C API for calling symnmf_batch from python
+ * W is a symnmf.Packed, a buffer (dense, or float packed storage for float32), a list of lists
+ * (copied into packed storage) or a csr tuple as returned by knn, jobs is a sequence of (k, seed) pairs, the keywords
+ * are the symnmf_options of every job. returns a list with one (H, objective, iterations, converged)
+ * tuple per job, in job order
+*/
+PyObject* batch_capi(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"W", "jobs", "threads", "max_iter", "eps", "beta", "method", "penalty", NULL};
+    PyObject *python_W_matrix, *python_jobs, *python_job, *py_result, *py_H, *py_item;
+    int threads = 0, ok, t, job_count;
+    const char *method = NULL;
+    symnmf_options options;
+    packed_matrix *W_packed = NULL;
+    packed_matrix_f32 *W_single = NULL;
+    csr_matrix *W_csr = NULL;
+    input_matrix W_dense;
+    w_operator W_operator;
+    symnmf_job *jobs;
+
+    symnmf_default_options(&options);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|i$iddzd", keywords, &python_W_matrix, &python_jobs, &threads,
+            &options.max_iter, &options.eps, &options.beta, &method, &options.penalty)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    if (!parse_method(method, &options)) { return NULL; }
+    if (!symnmf_options_valid(&options)) { /* checked once here, a failed job would read as out of memory */
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    use_threads(threads);
+    python_jobs = PySequence_Fast(python_jobs, "jobs must be a sequence of (k, seed) pairs");
+    if (python_jobs == NULL) { return NULL; }
+    job_count = (int)PySequence_Fast_GET_SIZE(python_jobs);
+    jobs = (symnmf_job *)calloc(job_count > 0 ? (size_t)job_count : 1, sizeof(symnmf_job));
+    if (jobs == NULL) { Py_DECREF(python_jobs); return PyErr_NoMemory(); }
+    for (t = 0; t < job_count; t++) {
+        python_job = PySequence_Fast_GET_ITEM(python_jobs, t);
+        if (!PyArg_ParseTuple(python_job, "ik", &jobs[t].k, &jobs[t].seed) || jobs[t].k < 1) {
+            if (!PyErr_Occurred()) { PyErr_SetString(PyExc_ValueError, "An Error Has Occurred"); }
+            free(jobs); Py_DECREF(python_jobs);
+            return NULL;
+        }
+    }
+    Py_DECREF(python_jobs);
+    /* W as an operator over the python buffer, a packed copy of the list or the csr arrays */
+    W_dense.has_buffer = 0; W_dense.owned = NULL;
+    if (PyObject_TypeCheck(python_W_matrix, &PackedType)) {
+        w_operator_packed(&W_operator, ((PackedObject *)python_W_matrix)->W);
+    }
+    else if (PyList_Check(python_W_matrix)) {
+        W_packed = py_to_packed_matrix(python_W_matrix);
+        if (W_packed == NULL) { free(jobs); return NULL; } /* error is raised by parsing function */
+        w_operator_packed(&W_operator, W_packed);
+    }
+    else if (PyTuple_Check(python_W_matrix)) {
+        W_csr = py_to_csr(python_W_matrix);
+        if (W_csr == NULL) { free(jobs); return NULL; }
+        w_operator_csr(&W_operator, W_csr);
+    }
+    else if (is_float32_buffer(python_W_matrix)) {
+        W_single = py_to_packed_f32(python_W_matrix);
+        if (W_single == NULL) { free(jobs); return NULL; }
+        w_operator_packed_f32(&W_operator, W_single);
+    }
+    else {
+        if (!input_matrix_acquire(python_W_matrix, &W_dense)) { free(jobs); return NULL; }
+        if (W_dense.view.rows != W_dense.view.cols) {
+            input_matrix_release(&W_dense); free(jobs);
+            PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+            return NULL;
+        }
+        w_operator_dense(&W_operator, &W_dense.view);
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    ok = symnmf_batch(&W_operator, jobs, job_count, &options);
+    Py_END_ALLOW_THREADS
+    free_packed(W_packed); free_packed_f32(W_single); free_csr(W_csr); input_matrix_release(&W_dense);
+    if (!ok) {
+        free(jobs);
+        PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
+        return NULL;
+    }
+    /* hand every H over to python, the list owns them from here */
+    py_result = PyList_New(job_count);
+    for (t = 0; t < job_count; t++) {
+        py_H = py_result != NULL ? matrix_to_py(jobs[t].H, 2) : NULL;
+        if (py_result == NULL) { free_matrix(jobs[t].H); continue; }
+        py_item = py_H != NULL ? Py_BuildValue("(NdiO)", py_H, jobs[t].objective, jobs[t].iterations, jobs[t].converged ? Py_True : Py_False) : NULL;
+        if (py_item == NULL) { Py_CLEAR(py_result); continue; } /* the remaining H are still freed */
+        PyList_SET_ITEM(py_result, t, py_item);
+    }
+    free(jobs);
+    return py_result;
+}
+/*
+ * ========================================KMEANS_CAPI=============================================
+ * kmeans(points, k[, max_iter[, eps[, threads]]]), the labels of kmeans.find_kmeans_labels with
+ * the same defaults, computed by kmeans_labels(), as a one dimensional Matrix of N labels
+*/
+PyObject* kmeans_capi(PyObject *self, PyObject *args) {
+    PyObject *python_points;
+    int k, max_iter = KMEANS_DEFAULT_ITER, threads = 0;
+    double eps = KMEANS_DEFAULT_EPS;
+    input_matrix data_points;
+    matrix *labels;
+
+    if (!PyArg_ParseTuple(args, "Oi|idi", &python_points, &k, &max_iter, &eps, &threads)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    if (k < 1 || max_iter < 1 || !(eps >= 0)) {
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    use_threads(threads);
+    if (!input_matrix_acquire(python_points, &data_points)) {
         return NULL; /* error is raised by parsing function */
     }
-    /* calculate the degree matrix */
-    norm_matrix = calculate_norm_matrix(data_points, N, d);
-    free_matrix(data_points, N); /* we dont need the data points anymore */
-    if (norm_matrix == NULL) {
+    if (k > data_points.view.rows) {
+        input_matrix_release(&data_points);
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    labels = kmeans_labels(&data_points.view, k, max_iter, eps);
+    Py_END_ALLOW_THREADS
+    input_matrix_release(&data_points);
+    if (labels == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
+        return NULL;
+    }
+    return matrix_to_py(labels, 1);
+}
+/*
+ * ========================================PY_TO_LABELS============================================
+ * copies a sequence of N cluster labels (a list, a numpy array, a Matrix of labels) into an
+ * N x 1 matrix, silhouette_score() checks that they are integers
+ * returns NULL with a python error set on failure
+*/
+static matrix* py_to_labels(PyObject *python_labels, int N) {
+    PyObject *sequence;
+    matrix *labels;
+    int i;
+
+    sequence = PySequence_Fast(python_labels, "An Error Has Occurred");
+    if (sequence == NULL) { return NULL; } /* error is raised by python */
+    if (PySequence_Fast_GET_SIZE(sequence) != N) {
+        Py_DECREF(sequence);
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    labels = matrix_alloc(N, 1);
+    if (labels == NULL) {
+        Py_DECREF(sequence);
         PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
-        return NULL; 
+        return NULL;
+    }
+    for (i = 0; i < N; i++) {
+        MAT_AT(labels, i, 0) = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(sequence, i)); /* numpy integers convert too */
+        if (MAT_AT(labels, i, 0) == -1.0 && PyErr_Occurred()) {
+            Py_DECREF(sequence); free_matrix(labels);
+            return NULL; /* error is raised by parsing function */
+        }
+    }
+    Py_DECREF(sequence);
+    return labels;
+}
+/*
+ * ========================================SILHOUETTE_CAPI=========================================
+ * silhouette(points, labels[, threads]), the score sklearn's silhouette_score gives, computed by
+ * silhouette_score(). labels are integers in [0, N), with 2 to N - 1 distinct values
+*/
+PyObject* silhouette_capi(PyObject *self, PyObject *args) {
+    PyObject *python_points, *python_labels;
+    int threads = 0, status;
+    input_matrix data_points;
+    matrix *labels;
+    double score = 0.0;
+
+    if (!PyArg_ParseTuple(args, "OO|i", &python_points, &python_labels, &threads)) {
+        return NULL; /* error is raised by parsing function */
     }
-    /* convert the C matrix to a python object */
-    py_return_matrix = c_to_py_matrix(norm_matrix, N, N);
-    free_matrix(norm_matrix, N); /* we dont need the normalized matrix anymore */
-    if (py_return_matrix == NULL) {
+    use_threads(threads);
+    if (!input_matrix_acquire(python_points, &data_points)) {
         return NULL; /* error is raised by parsing function */
     }
-    return py_return_matrix; 
+    labels = py_to_labels(python_labels, data_points.view.rows);
+    if (labels == NULL) {
+        input_matrix_release(&data_points);
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    status = silhouette_score(&data_points.view, labels, &score);
+    Py_END_ALLOW_THREADS
+    input_matrix_release(&data_points);
+    free_matrix(labels);
+    if (status != 1) {
+        PyErr_SetString(status == 0 ? PyExc_MemoryError : PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    return PyFloat_FromDouble(score);
 }
-/* 
- * ========================================SYMNMF_CAPI=============================================
- * this function executes symnmf algorithm taking W matrix and initial H as parameters
+/*
+ * ========================================INCREMENTAL_OBJECT======================================
+ * symnmf.Incremental owns an incremental_w: the points so far, A and the degrees. extend() adds
+ * points, extend_h() grows the previous H into a warm start and symnmf() optimizes against W.
+ * the C work runs without the GIL, busy makes a concurrent call on the same object raise
 */
-PyObject* symnmf_capi(PyObject *self, PyObject *args) {
-    PyObject* python_W_matrix;
-    PyObject* python_init_H;
-    int N, d;
-    int N_H; /* place holder for py_to_c output */
-    int k; 
-    double **W_matrix;
-    double **init_H;
-    double **optimized_H;
-    PyObject* py_return_matrix;
+typedef struct {
+    PyObject_HEAD
+    incremental_w *W;
+    int busy;
+} IncrementalObject;
 
-    /* parse the python object */
-    if (!PyArg_ParseTuple(args, "OO", &python_W_matrix, &python_init_H)) {
+static void Incremental_dealloc(IncrementalObject *self) {
+    free_incremental(self->W);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+/*
+ * marks the object busy, returns 0 with a RuntimeError if another call is using it. call it before
+ * reading self->W: extend() replaces the points while the GIL is released
+*/
+static int incremental_enter(IncrementalObject *self) {
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+        return 0;
+    }
+    self->busy = 1;
+    return 1;
+}
+/*
+ * ========================================INCREMENTAL_EXTEND_PY===================================
+ * extend(new_points[, threads]): appends the points, computing only the kernel entries that
+ * involve them, and renormalizes W. the points must have the dimension of the first ones
+*/
+static PyObject* Incremental_extend(IncrementalObject *self, PyObject *args) {
+    PyObject *python_points;
+    int threads = 0, ok;
+    input_matrix new_points;
+
+    if (!PyArg_ParseTuple(args, "O|i", &python_points, &threads)) {
         return NULL; /* error is raised by parsing function */
     }
-    /* convert W matrix to C */
-    W_matrix = py_to_c_matrix(python_W_matrix, &N, &d);
-    if (W_matrix == NULL) { return NULL; } /* error is raised by parsing function */
-    
-    /* convert initial H matrix to C */
-    init_H = py_to_c_matrix(python_init_H, &N_H, &k);
-    if (init_H == NULL) { free_matrix(W_matrix, N); return NULL; }
-    
-    /* use optimize_h to execute the algorithm */
-    optimized_H = optimize_h(W_matrix, init_H, N, k);
-    free_matrix(W_matrix, N);
-    free_matrix(init_H, N_H);
-    if (optimized_H == NULL) {
+    use_threads(threads);
+    if (!incremental_enter(self)) { return NULL; }
+    if (!input_matrix_acquire(python_points, &new_points)) {
+        self->busy = 0;
+        return NULL; /* error is raised by parsing function */
+    }
+    if (new_points.view.cols != self->W->points->cols) {
+        self->busy = 0;
+        input_matrix_release(&new_points);
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    ok = incremental_extend(self->W, &new_points.view);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+    input_matrix_release(&new_points);
+    if (!ok) {
+        PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+/*
+ * ========================================INCREMENTAL_EXTEND_H_PY=================================
+ * extend_h(H): the H of the first H.shape[0] points grown to every point, the new rows are the
+ * similarity weighted average of the old ones
+*/
+static PyObject* Incremental_extend_h(IncrementalObject *self, PyObject *args) {
+    PyObject *python_H;
+    input_matrix H;
+    matrix *grown;
+
+    if (!PyArg_ParseTuple(args, "O", &python_H)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    if (!incremental_enter(self)) { return NULL; }
+    if (!input_matrix_acquire(python_H, &H)) {
+        self->busy = 0;
+        return NULL; /* error is raised by parsing function */
+    }
+    if (H.view.rows > self->W->points->rows) {
+        self->busy = 0;
+        input_matrix_release(&H);
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    grown = incremental_extend_h(self->W, &H.view);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+    input_matrix_release(&H);
+    if (grown == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
+        return NULL;
+    }
+    return matrix_to_py(grown, 2);
+}
+/*
+ * ========================================INCREMENTAL_SYMNMF_PY===================================
+ * symnmf(init_H[, threads], *, max_iter, eps, beta, method, penalty, info): symnmf.symnmf()
+ * against the W of every point so far, init_H usually comes from extend_h()
+*/
+static PyObject* Incremental_symnmf(IncrementalObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"init_H", "threads", "max_iter", "eps", "beta", "method", "penalty", "info", NULL};
+    PyObject *python_init_H;
+    int threads = 0, info = 0, ok;
+    const char *method = NULL;
+    symnmf_options options;
+    symnmf_result result;
+    w_operator W_operator;
+    input_matrix init_H;
+
+    symnmf_default_options(&options);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i$iddzdp", keywords, &python_init_H, &threads,
+            &options.max_iter, &options.eps, &options.beta, &method, &options.penalty, &info)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    if (!parse_method(method, &options)) { return NULL; }
+    use_threads(threads);
+    if (!incremental_enter(self)) { return NULL; }
+    if (!input_matrix_acquire(python_init_H, &init_H)) {
+        self->busy = 0;
+        return NULL; /* error is raised by parsing function */
+    }
+    if (init_H.view.rows != self->W->points->rows) {
+        self->busy = 0;
+        input_matrix_release(&init_H);
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    w_operator_scaled(&W_operator, &self->W->W);
+    Py_BEGIN_ALLOW_THREADS
+    ok = optimize_h_run(&W_operator, &init_H.view, &options, &result);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+    input_matrix_release(&init_H);
+    return result_to_py(ok, &result, info);
+}
+/*
+ * ========================================INCREMENTAL_NORM_PY=====================================
+ * norm(): the dense W of every point so far, what symnmf.norm() gives for all of them
+*/
+static PyObject* Incremental_norm(IncrementalObject *self, PyObject *args) {
+    int threads = 0;
+    matrix *norm;
+
+    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    use_threads(threads);
+    if (!incremental_enter(self)) { return NULL; }
+    Py_BEGIN_ALLOW_THREADS
+    norm = incremental_norm(self->W);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+    if (norm == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
+        return NULL;
+    }
+    return matrix_to_py(norm, 2);
+}
+/* N, raises while another call is extending the points */
+static PyObject* Incremental_get_size(IncrementalObject *self, void *closure) {
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "An Error Has Occurred");
+        return NULL;
+    }
+    return PyLong_FromLong(self->W->points->rows);
+}
+static PyMethodDef Incremental_methods[] = {
+    {"extend", (PyCFunction)Incremental_extend, METH_VARARGS, "extend(new_points[, threads]) append points, only their kernel entries are computed"},
+    {"extend_h", (PyCFunction)Incremental_extend_h, METH_VARARGS, "extend_h(H) grow the H of the earlier points into a warm start for every point"},
+    {"symnmf", (PyCFunction)(void (*)(void))Incremental_symnmf, METH_VARARGS | METH_KEYWORDS, "symnmf(init_H[, threads], *, max_iter=300, eps=1e-4, beta=0.5, method='mu', penalty=0, info=False) execute symnmf algorithm on the W of every point"},
+    {"norm", (PyCFunction)Incremental_norm, METH_VARARGS, "norm([threads]) the normalized similarity matrix W of every point"},
+    {NULL, NULL, 0, NULL}
+};
+static PyGetSetDef Incremental_getset[] = {
+    {"N", (getter)Incremental_get_size, NULL, "number of points so far", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+static PyTypeObject IncrementalType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "symnmf.Incremental",
+};
+static int incremental_type_ready(void) {
+    IncrementalType.tp_basicsize = sizeof(IncrementalObject);
+    IncrementalType.tp_dealloc = (destructor)Incremental_dealloc;
+    IncrementalType.tp_flags = Py_TPFLAGS_DEFAULT;
+    IncrementalType.tp_doc = "points, similarity matrix and degrees of a growing data set, see symnmf.incremental()";
+    IncrementalType.tp_methods = Incremental_methods;
+    IncrementalType.tp_getset = Incremental_getset;
+    return PyType_Ready(&IncrementalType) == 0;
+}
+/*
+ * ========================================INCREMENTAL_CAPI========================================
+ * incremental(points[, threads]), a symnmf.Incremental holding a copy of the points, their A and
+ * their degrees
+*/
+PyObject* incremental_capi(PyObject *self, PyObject *args) {
+    PyObject *python_points;
+    int threads = 0;
+    input_matrix data_points;
+    incremental_w *W;
+    IncrementalObject *obj;
+
+    if (!PyArg_ParseTuple(args, "O|i", &python_points, &threads)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    use_threads(threads);
+    if (!input_matrix_acquire(python_points, &data_points)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    Py_BEGIN_ALLOW_THREADS
+    W = incremental_create(&data_points.view);
+    Py_END_ALLOW_THREADS
+    input_matrix_release(&data_points);
+    if (W == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
+        return NULL;
+    }
+    obj = PyObject_New(IncrementalObject, &IncrementalType);
+    if (obj == NULL) {
+        free_incremental(W);
+        return NULL; /* error is raised by python */
+    }
+    obj->W = W;
+    obj->busy = 0;
+    return (PyObject *)obj;
+}
+/*
+ * ========================================NYSTROM_OBJECT==========================================
+ * symnmf.Nystrom owns a nystrom_w: the N x rank factor and the inverse square roots of the
+ * approximate degrees. it never changes after nystrom() builds it, so calls can share it freely
+*/
+typedef struct {
+    PyObject_HEAD
+    nystrom_w *W;
+} NystromObject;
+
+static void Nystrom_dealloc(NystromObject *self) {
+    free_nystrom(self->W);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+/*
+ * ========================================NYSTROM_SYMNMF_PY=======================================
+ * symnmf(init_H[, threads], *, max_iter, eps, beta, method, penalty, info): symnmf.symnmf()
+ * against the approximate W, every product costs O(N * rank * k)
+*/
+static PyObject* Nystrom_symnmf(NystromObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"init_H", "threads", "max_iter", "eps", "beta", "method", "penalty", "info", NULL};
+    PyObject *python_init_H;
+    int threads = 0, info = 0, ok;
+    const char *method = NULL;
+    symnmf_options options;
+    symnmf_result result;
+    w_operator W_operator;
+    input_matrix init_H;
+
+    symnmf_default_options(&options);
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i$iddzdp", keywords, &python_init_H, &threads,
+            &options.max_iter, &options.eps, &options.beta, &method, &options.penalty, &info)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    if (!parse_method(method, &options)) { return NULL; }
+    use_threads(threads);
+    if (!input_matrix_acquire(python_init_H, &init_H)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    if (init_H.view.rows != self->W->factor->rows) {
+        input_matrix_release(&init_H);
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    w_operator_nystrom(&W_operator, self->W);
+    Py_BEGIN_ALLOW_THREADS
+    ok = optimize_h_run(&W_operator, &init_H.view, &options, &result);
+    Py_END_ALLOW_THREADS
+    input_matrix_release(&init_H);
+    return result_to_py(ok, &result, info);
+}
+/*
+ * ========================================NYSTROM_MEAN_PY=========================================
+ * mean([threads]): the mean entry of the approximate W, what np.mean(W) gives for the initial H
+*/
+static PyObject* Nystrom_mean(NystromObject *self, PyObject *args) {
+    int threads = 0;
+    w_operator W_operator;
+    double mean;
+
+    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    use_threads(threads);
+    w_operator_nystrom(&W_operator, self->W);
+    Py_BEGIN_ALLOW_THREADS
+    mean = operator_mean(&W_operator);
+    Py_END_ALLOW_THREADS
+    if (mean < 0) {
+        PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
+        return NULL;
+    }
+    return PyFloat_FromDouble(mean);
+}
+/*
+ * ========================================NYSTROM_ERROR_PY========================================
+ * error(points[, threads]): ||W - W~||_F / ||W||_F against the exact W of the points the object
+ * was built from, which is computed for the comparison and needs its O(N^2) memory
+*/
+static PyObject* Nystrom_error(NystromObject *self, PyObject *args) {
+    PyObject *python_points;
+    int threads = 0;
+    input_matrix data_points;
+    double error;
+
+    if (!PyArg_ParseTuple(args, "O|i", &python_points, &threads)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    use_threads(threads);
+    if (!input_matrix_acquire(python_points, &data_points)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    if (data_points.view.rows != self->W->factor->rows) {
+        input_matrix_release(&data_points);
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    error = nystrom_error(self->W, &data_points.view);
+    Py_END_ALLOW_THREADS
+    input_matrix_release(&data_points);
+    if (error < 0) {
         PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
         return NULL;
     }
-    /* convert H back to python and return it */
-    py_return_matrix = c_to_py_matrix(optimized_H, N, k);
-    free_matrix(optimized_H, N);
-    if (py_return_matrix == NULL) { return NULL; } /* error is raised by parsing function */
-    return py_return_matrix; 
+    return PyFloat_FromDouble(error);
+}
+static PyObject* Nystrom_get_size(NystromObject *self, void *closure) {
+    return PyLong_FromLong(self->W->factor->rows);
+}
+static PyObject* Nystrom_get_landmarks(NystromObject *self, void *closure) {
+    return PyLong_FromLong(self->W->landmarks);
+}
+static PyObject* Nystrom_get_rank(NystromObject *self, void *closure) {
+    return PyLong_FromLong(self->W->rank);
+}
+static PyMethodDef Nystrom_methods[] = {
+    {"symnmf", (PyCFunction)(void (*)(void))Nystrom_symnmf, METH_VARARGS | METH_KEYWORDS, "symnmf(init_H[, threads], *, max_iter=300, eps=1e-4, beta=0.5, method='mu', penalty=0, info=False) execute symnmf algorithm on the approximate W"},
+    {"mean", (PyCFunction)Nystrom_mean, METH_VARARGS, "mean([threads]) mean entry of the approximate W, for the initial H"},
+    {"error", (PyCFunction)Nystrom_error, METH_VARARGS, "error(points[, threads]) relative Frobenius error against the exact W of the points, O(N^2) memory"},
+    {NULL, NULL, 0, NULL}
+};
+static PyGetSetDef Nystrom_getset[] = {
+    {"N", (getter)Nystrom_get_size, NULL, "number of points", NULL},
+    {"landmarks", (getter)Nystrom_get_landmarks, NULL, "landmark points sampled", NULL},
+    {"rank", (getter)Nystrom_get_rank, NULL, "rank of the approximation, at most landmarks", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+static PyTypeObject NystromType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "symnmf.Nystrom",
+};
+static int nystrom_type_ready(void) {
+    NystromType.tp_basicsize = sizeof(NystromObject);
+    NystromType.tp_dealloc = (destructor)Nystrom_dealloc;
+    NystromType.tp_flags = Py_TPFLAGS_DEFAULT;
+    NystromType.tp_doc = "low-rank approximation of W from landmark points, see symnmf.nystrom()";
+    NystromType.tp_methods = Nystrom_methods;
+    NystromType.tp_getset = Nystrom_getset;
+    return PyType_Ready(&NystromType) == 0;
+}
+/*
+ * ========================================NYSTROM_CAPI============================================
+ * nystrom(points, landmarks[, threads], *, sampling, seed), a symnmf.Nystrom of the points.
+ * sampling is 'uniform' or 'kmeans++', seed drives it like the seed of the native program
+*/
+PyObject* nystrom_capi(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"points", "landmarks", "threads", "sampling", "seed", NULL};
+    PyObject *python_points;
+    int landmarks, threads = 0, sampling;
+    const char *sampling_name = "uniform";
+    unsigned long seed = 1234; /* the np.random.seed of symnmf.py */
+    input_matrix data_points;
+    nystrom_w *W;
+    NystromObject *obj;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oi|i$sk", keywords, &python_points, &landmarks, &threads, &sampling_name, &seed)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    if (strcmp(sampling_name, "uniform") == 0) { sampling = NYSTROM_UNIFORM; }
+    else if (strcmp(sampling_name, "kmeans++") == 0) { sampling = NYSTROM_KMEANSPP; }
+    else {
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    use_threads(threads);
+    if (!input_matrix_acquire(python_points, &data_points)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    if (landmarks < 1 || landmarks > data_points.view.rows) {
+        input_matrix_release(&data_points);
+        PyErr_SetString(PyExc_ValueError, "An Error Has Occurred");
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    W = nystrom_create(&data_points.view, landmarks, sampling, seed);
+    Py_END_ALLOW_THREADS
+    input_matrix_release(&data_points);
+    if (W == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "An Error Has Occurred");
+        return NULL;
+    }
+    obj = PyObject_New(NystromObject, &NystromType);
+    if (obj == NULL) {
+        free_nystrom(W);
+        return NULL; /* error is raised by python */
+    }
+    obj->W = W;
+    return (PyObject *)obj;
+}
+/*
+ * ========================================PROFILE_CAPI============================================
+ * returns what profile.c recorded as a dict shaped like the JSON of the native program:
+ * {"enabled": bool, "stages": {name: {"calls", "seconds", "bytes", "flops"}},
+ *  "iterations": {"seconds": [...], "residual": [...], "flops": [...]}}
+ * with reset (default false) the recorded stages and iterations are cleared afterwards
+*/
+PyObject* profile_capi(PyObject *self, PyObject *args) {
+    static const char *series[3] = {"seconds", "residual", "flops"};
+    PyObject *py_profile, *py_stages, *py_iterations, *py_item;
+    const profile_stage *stage;
+    profile_snapshot *snapshot;
+    int reset = 0, s, i, ok;
+
+    if (!PyArg_ParseTuple(args, "|p", &reset)) {
+        return NULL; /* error is raised by parsing function */
+    }
+    snapshot = profile_snapshot_take(reset); /* threads still running without the GIL may record meanwhile */
+    if (snapshot == NULL) { return PyErr_NoMemory(); }
+    py_stages = PyDict_New();
+    py_iterations = PyDict_New();
+    ok = py_stages != NULL && py_iterations != NULL;
+    for (s = 0; ok && s < snapshot->stage_count; s++) {
+        stage = &snapshot->stages[s];
+        py_item = Py_BuildValue("{s:l,s:d,s:d,s:d}", "calls", stage->calls, "seconds", stage->seconds, "bytes", stage->bytes, "flops", stage->flops);
+        ok = py_item != NULL && PyDict_SetItemString(py_stages, stage->name, py_item) == 0;
+        Py_XDECREF(py_item);
+    }
+    for (s = 0; ok && s < 3; s++) {
+        py_item = PyList_New(snapshot->iteration_count);
+        ok = py_item != NULL && PyDict_SetItemString(py_iterations, series[s], py_item) == 0;
+        for (i = 0; ok && i < snapshot->iteration_count; i++) {
+            PyList_SET_ITEM(py_item, i, PyFloat_FromDouble(snapshot->iterations[3 * i + s]));
+            ok = PyList_GET_ITEM(py_item, i) != NULL;
+        }
+        Py_XDECREF(py_item);
+    }
+    profile_snapshot_free(snapshot);
+    py_profile = ok ? Py_BuildValue("{s:O,s:O,s:O}", "enabled", PROFILE_ENABLED ? Py_True : Py_False, "stages", py_stages, "iterations", py_iterations) : NULL;
+    Py_XDECREF(py_stages); Py_XDECREF(py_iterations);
+    return py_profile;
 }
@@ -0,0 +1,418 @@
+#define _POSIX_C_SOURCE 200112L /* sysconf */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "symnmf.h"
+#include "gemm.h"
+#include "packed.h"
+#include "tiled.h"
+#include "output.h"
+#include "profile.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#define TILED_SYSCONF
+#include <unistd.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TILED_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * exp(x) for x <= 0 as 2^n * p(r): n = round(x / ln 2), r = x - n ln 2 in two steps (ln2_hi has
+ * trailing zero bits, so n * ln2_hi is exact) and p the degree 13 Taylor polynomial of e^r, whose
+ * truncation error is below 1e-17 for |r| <= ln 2 / 2. p is evaluated by Estrin's scheme, pairs
+ * of terms combined with r^2, r^4 and r^8, so the dependency chain is 4 steps deep instead of 13.
+ * below EXP_MIN the result would be subnormal and is taken as 0. accurate to a few ulp, the vector
+ * kernels fuse the multiply-adds, so they may differ from the scalar one in the last bit
+*/
+#define EXP_MIN -708.0
+#define EXP_LOG2E 1.4426950408889634074
+#define EXP_LN2_HI 6.93147180369123816490e-01
+#define EXP_LN2_LO 1.90821492927058770002e-10
+#define EXP_SHIFTER 6755399441055744.0 /* 1.5 * 2^52, adding it rounds to an integer */
+
+static const double exp_coefficients[14] = { /* 1/i! */
+    1.0, 1.0, 1.0 / 2.0, 1.0 / 6.0, 1.0 / 24.0, 1.0 / 120.0, 1.0 / 720.0, 1.0 / 5040.0, 1.0 / 40320.0,
+    1.0 / 362880.0, 1.0 / 3628800.0, 1.0 / 39916800.0, 1.0 / 479001600.0, 1.0 / 6227020800.0
+};
+
+static double exp_nonpositive(double x) {
+    const double *a = exp_coefficients;
+    double t, n, r, r2, r4, p03, p47, p811, p1213;
+    if (!(x > EXP_MIN)) { return 0.0; }
+    t = x * EXP_LOG2E + EXP_SHIFTER;
+    n = t - EXP_SHIFTER;
+    r = (x - n * EXP_LN2_HI) - n * EXP_LN2_LO;
+    r2 = r * r; r4 = r2 * r2;
+    p03 = (a[0] + a[1] * r) + (a[2] + a[3] * r) * r2;
+    p47 = (a[4] + a[5] * r) + (a[6] + a[7] * r) * r2;
+    p811 = (a[8] + a[9] * r) + (a[10] + a[11] * r) * r2;
+    p1213 = a[12] + a[13] * r;
+    return ldexp((p03 + p47 * r4) + (p811 + p1213 * r4) * (r4 * r4), (int)n);
+}
+/*
+ * ========================================TILED_ENTRY=============================================
+ * W_ij = A_ij/(sqrt(degree_i) * sqrt(degree_j)), entry by entry
+*/
+static double tiled_entry(const tiled_w *W, int i, int j) {
+    const int N = W->points->rows, d = W->points->cols;
+    const double *x = MAT_ROW(W->points, i);
+    double dist = 0.0, diff;
+    int c;
+    if (i == j) { return 0.0; } /* same point */
+    for (c = 0; c < d; c++) {
+        diff = x[c] - W->columns[(size_t)c * N + j];
+        dist += diff * diff;
+    }
+    return exp_nonpositive(dist * -0.5) * (W->inv_sqrt_degrees[i] * W->inv_sqrt_degrees[j]);
+}
+/*
+ * ========================================FILL_ROW_SCALAR=========================================
+ * row[j] = W_ij for j0 <= j < j1 (row is indexed by j), portable version
+*/
+static void fill_row_scalar(const tiled_w *W, int i, int j0, int j1, double *row) {
+    int j;
+    for (j = j0; j < j1; j++) { row[j] = tiled_entry(W, i, j); }
+}
+#ifdef TILED_X86
+/*
+ * ========================================FILL_ROW_AVX2===========================================
+ * fill_row_scalar() four entries at a time, distance, exp and scaling stay in registers, the
+ * last partial group goes through masked loads and stores, so every entry takes the same path
+*/
+__attribute__((target("avx2,fma")))
+static __m256d exp_avx2(__m256d x) {
+    const double *a = exp_coefficients;
+    const __m256d shifter = _mm256_set1_pd(EXP_SHIFTER);
+    __m256d t, n, r, r2, r4, p03, p47, p811, p1213, p;
+    t = _mm256_fmadd_pd(x, _mm256_set1_pd(EXP_LOG2E), shifter);
+    n = _mm256_sub_pd(t, shifter);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(EXP_LN2_LO), _mm256_fnmadd_pd(n, _mm256_set1_pd(EXP_LN2_HI), x));
+    r2 = _mm256_mul_pd(r, r); r4 = _mm256_mul_pd(r2, r2);
+    p03 = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_set1_pd(a[3]), r, _mm256_set1_pd(a[2])), r2, _mm256_fmadd_pd(_mm256_set1_pd(a[1]), r, _mm256_set1_pd(a[0])));
+    p47 = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_set1_pd(a[7]), r, _mm256_set1_pd(a[6])), r2, _mm256_fmadd_pd(_mm256_set1_pd(a[5]), r, _mm256_set1_pd(a[4])));
+    p811 = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_set1_pd(a[11]), r, _mm256_set1_pd(a[10])), r2, _mm256_fmadd_pd(_mm256_set1_pd(a[9]), r, _mm256_set1_pd(a[8])));
+    p1213 = _mm256_fmadd_pd(_mm256_set1_pd(a[13]), r, _mm256_set1_pd(a[12]));
+    p = _mm256_fmadd_pd(_mm256_fmadd_pd(p1213, r4, p811), _mm256_mul_pd(r4, r4), _mm256_fmadd_pd(p47, r4, p03));
+    /* 2^n: the low bits of t hold n, shifted into the exponent field */
+    p = _mm256_mul_pd(p, _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(_mm256_castpd_si256(t), _mm256_set1_epi64x(1023)), 52)));
+    return _mm256_and_pd(p, _mm256_cmp_pd(x, _mm256_set1_pd(EXP_MIN), _CMP_GT_OQ));
+}
+__attribute__((target("avx2,fma")))
+static void fill_row_avx2(const tiled_w *W, int i, int j0, int j1, double *row) {
+    const int N = W->points->rows, d = W->points->cols;
+    const double *x = MAT_ROW(W->points, i);
+    const __m256d inv_i = _mm256_set1_pd(W->inv_sqrt_degrees[i]);
+    const __m256i lanes = _mm256_set_epi64x(3, 2, 1, 0);
+    __m256d dist, diff;
+    __m256i mask;
+    int j, c;
+
+    for (j = j0; j < j1; j += 4) {
+        mask = _mm256_cmpgt_epi64(_mm256_set1_epi64x(j1 - j), lanes); /* lanes past j1 are off */
+        dist = _mm256_setzero_pd();
+        for (c = 0; c < d; c++) {
+            diff = _mm256_sub_pd(_mm256_set1_pd(x[c]), _mm256_maskload_pd(W->columns + (size_t)c * N + j, mask));
+            dist = _mm256_fmadd_pd(diff, diff, dist);
+        }
+        dist = exp_avx2(_mm256_mul_pd(dist, _mm256_set1_pd(-0.5)));
+        _mm256_maskstore_pd(row + j, mask, _mm256_mul_pd(dist, _mm256_mul_pd(inv_i, _mm256_maskload_pd(W->inv_sqrt_degrees + j, mask))));
+    }
+    if (i >= j0 && i < j1) { row[i] = 0.0; } /* same point */
+}
+/*
+ * ========================================FILL_ROW_AVX512=========================================
+ * fill_row_avx2() eight entries at a time, the tail through mask registers
+*/
+__attribute__((target("avx512f")))
+static __m512d exp_avx512(__m512d x) {
+    const double *a = exp_coefficients;
+    const __m512d shifter = _mm512_set1_pd(EXP_SHIFTER);
+    __m512d t, n, r, r2, r4, p03, p47, p811, p1213, p;
+    t = _mm512_fmadd_pd(x, _mm512_set1_pd(EXP_LOG2E), shifter);
+    n = _mm512_sub_pd(t, shifter);
+    r = _mm512_fnmadd_pd(n, _mm512_set1_pd(EXP_LN2_LO), _mm512_fnmadd_pd(n, _mm512_set1_pd(EXP_LN2_HI), x));
+    r2 = _mm512_mul_pd(r, r); r4 = _mm512_mul_pd(r2, r2);
+    p03 = _mm512_fmadd_pd(_mm512_fmadd_pd(_mm512_set1_pd(a[3]), r, _mm512_set1_pd(a[2])), r2, _mm512_fmadd_pd(_mm512_set1_pd(a[1]), r, _mm512_set1_pd(a[0])));
+    p47 = _mm512_fmadd_pd(_mm512_fmadd_pd(_mm512_set1_pd(a[7]), r, _mm512_set1_pd(a[6])), r2, _mm512_fmadd_pd(_mm512_set1_pd(a[5]), r, _mm512_set1_pd(a[4])));
+    p811 = _mm512_fmadd_pd(_mm512_fmadd_pd(_mm512_set1_pd(a[11]), r, _mm512_set1_pd(a[10])), r2, _mm512_fmadd_pd(_mm512_set1_pd(a[9]), r, _mm512_set1_pd(a[8])));
+    p1213 = _mm512_fmadd_pd(_mm512_set1_pd(a[13]), r, _mm512_set1_pd(a[12]));
+    p = _mm512_fmadd_pd(_mm512_fmadd_pd(p1213, r4, p811), _mm512_mul_pd(r4, r4), _mm512_fmadd_pd(p47, r4, p03));
+    p = _mm512_mul_pd(p, _mm512_castsi512_pd(_mm512_slli_epi64(_mm512_add_epi64(_mm512_castpd_si512(t), _mm512_set1_epi64(1023)), 52)));
+    return _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(x, _mm512_set1_pd(EXP_MIN), _CMP_GT_OQ), p);
+}
+__attribute__((target("avx512f")))
+static void fill_row_avx512(const tiled_w *W, int i, int j0, int j1, double *row) {
+    const int N = W->points->rows, d = W->points->cols;
+    const double *x = MAT_ROW(W->points, i);
+    const __m512d inv_i = _mm512_set1_pd(W->inv_sqrt_degrees[i]);
+    __m512d dist, diff;
+    __mmask8 mask;
+    int j, c;
+
+    for (j = j0; j < j1; j += 8) {
+        mask = (__mmask8)(j1 - j >= 8 ? 0xff : (1 << (j1 - j)) - 1);
+        dist = _mm512_setzero_pd();
+        for (c = 0; c < d; c++) {
+            diff = _mm512_sub_pd(_mm512_set1_pd(x[c]), _mm512_maskz_loadu_pd(mask, W->columns + (size_t)c * N + j));
+            dist = _mm512_fmadd_pd(diff, diff, dist);
+        }
+        dist = exp_avx512(_mm512_mul_pd(dist, _mm512_set1_pd(-0.5)));
+        _mm512_mask_storeu_pd(row + j, mask, _mm512_mul_pd(dist, _mm512_mul_pd(inv_i, _mm512_maskz_loadu_pd(mask, W->inv_sqrt_degrees + j))));
+    }
+    if (i >= j0 && i < j1) { row[i] = 0.0; } /* same point */
+}
+#endif
+/*
+ * ========================================FILL_ROW================================================
+ * row[j] = W_ij for j0 <= j < j1 through the widest kernel of the isa (gemm_detect_isa())
+*/
+static void fill_row(int isa, const tiled_w *W, int i, int j0, int j1, double *row) {
+#ifdef TILED_X86
+    if (isa == GEMM_ISA_AVX512) { fill_row_avx512(W, i, j0, j1, row); return; }
+    if (isa == GEMM_ISA_AVX2) { fill_row_avx2(W, i, j0, j1, row); return; }
+#endif
+    (void)isa;
+    fill_row_scalar(W, i, j0, j1, row);
+}
+/*
+ * ========================================TILED_WORKSPACE_ALLOC===================================
+ * in the GEMM_NR wide panel layout of gemm.c: H packed into panels, then one segment per thread
+ * holding the partials of the transposed contributions (panels x N rows), the accumulated
+ * out rows of a row tile (panels x tile rows) and a tile x tile block of W
+*/
+static size_t segment_rows(int N, int panels, int tile) {
+    return (size_t)panels * N + (size_t)panels * tile + ((size_t)tile * tile + GEMM_NR - 1) / GEMM_NR;
+}
+static matrix* tiled_workspace_alloc(const w_operator *op, int k) {
+    const tiled_w *W = (const tiled_w *)op->data;
+    const int panels = (k + GEMM_NR - 1) / GEMM_NR;
+    return matrix_alloc((int)((size_t)panels * op->N + symnmf_max_threads() * segment_rows(op->N, panels, W->tile)), GEMM_NR);
+}
+/*
+ * ========================================TILED_MULTIPLY==========================================
+ * out = W*H with W generated block by block, only the blocks on and above the diagonal
+ * row tiles are dealt round robin to the threads. every block is evaluated once into the thread's
+ * buffer and then swept by symm_span() like a row strip of packed W: W_IJ*H_J is accumulated for
+ * the rows of I, W_IJ^T*H_I goes to the thread's partials, which are added to out in thread order
+ * once every block is done (as symm_multiply() does), so a fixed thread count gives fixed results
+*/
+static void tiled_multiply(const w_operator *op, const matrix *H, matrix *out, matrix *workspace) {
+    const tiled_w *W = (const tiled_w *)op->data;
+    const int N = op->N, k = H->cols, tile = W->tile;
+    const int tiles = (N + tile - 1) / tile, panels = (k + GEMM_NR - 1) / GEMM_NR;
+    const size_t panel_rows = (size_t)panels * N, segment = segment_rows(N, panels, tile);
+    const int isa = gemm_detect_isa();
+    const double *a_rows[SYMM_MR];
+    const double *h_panel;
+    int I, J, i, j, r, s, q, c, t, threads, i0, i1, j0, j1, mr, width;
+    double *part, *acc, *block, *tile_q, *out_row;
+    double a;
+    matrix packed_H; /* view of the first panels * N rows of the workspace */
+
+    if (N == 0) { return; }
+    packed_H = *workspace;
+    packed_H.rows = (int)panel_rows;
+#ifdef _OPENMP
+#pragma omp parallel private(a_rows, h_panel, I, J, i, j, r, s, q, c, t, threads, i0, i1, j0, j1, mr, width, part, acc, block, tile_q, out_row, a) num_threads((int)((workspace->rows - panel_rows) / segment))
+#endif
+    {
+#ifdef _OPENMP
+        t = omp_get_thread_num(); threads = omp_get_num_threads();
+#else
+        t = 0; threads = 1;
+#endif
+        gemm_pack_b(H, &packed_H); /* shared among the team, ends with a barrier */
+        part = MAT_ROW(workspace, panel_rows + (size_t)t * segment);
+        acc = part + panel_rows * GEMM_NR;
+        block = acc + (size_t)panels * tile * GEMM_NR;
+        for (j = 0; j < (int)panel_rows * GEMM_NR; j++) { part[j] = 0.0; }
+        /* row tiles get shorter with I, round robin keeps the threads balanced */
+#ifdef _OPENMP
+#pragma omp for schedule(static, 1)
+#endif
+        for (I = 0; I < tiles; I++) {
+            i0 = I * tile;
+            i1 = i0 + tile < N ? i0 + tile : N;
+            for (j = 0; j < panels * tile * GEMM_NR; j++) { acc[j] = 0.0; }
+            for (J = I; J < tiles; J++) {
+                j0 = J * tile;
+                j1 = j0 + tile < N ? j0 + tile : N;
+                width = j1 - j0;
+                for (i = i0; i < i1; i++) { /* on the diagonal block only j >= i is needed */
+                    fill_row(isa, W, i, j0 > i ? j0 : i, j1, block + (size_t)(i - i0) * width - j0);
+                }
+                for (i = i0; i < i1; i += SYMM_MR) {
+                    mr = i1 - i < SYMM_MR ? i1 - i : SYMM_MR;
+                    for (r = 0; r < mr; r++) { a_rows[r] = block + (size_t)(i - i0 + r) * width - j0; }
+                    for (q = 0; q < panels; q++) {
+                        h_panel = MAT_ROW(&packed_H, (size_t)q * N);
+                        tile_q = acc + ((size_t)q * tile + (i - i0)) * GEMM_NR;
+                        if (J > I) { symm_span(isa, mr, j0, j1, a_rows, h_panel + (size_t)i * GEMM_NR, h_panel, part + (size_t)q * N * GEMM_NR, tile_q); continue; }
+                        for (r = 0; r < mr; r++) { /* triangle of the strip, diagonal included, its rows are all ours */
+                            for (s = r; s < mr; s++) {
+                                a = a_rows[r][i + s];
+                                for (c = 0; c < GEMM_NR; c++) { tile_q[r * GEMM_NR + c] += a * h_panel[(size_t)(i + s) * GEMM_NR + c]; }
+                                if (s == r) { continue; }
+                                for (c = 0; c < GEMM_NR; c++) { tile_q[s * GEMM_NR + c] += a * h_panel[(size_t)(i + r) * GEMM_NR + c]; }
+                            }
+                        }
+                        symm_span(isa, mr, i + mr, j1, a_rows, h_panel + (size_t)i * GEMM_NR, h_panel, part + (size_t)q * N * GEMM_NR, tile_q);
+                    }
+                }
+            }
+            for (i = i0; i < i1; i++) {
+                out_row = MAT_ROW(out, i);
+                for (q = 0; q < panels; q++) {
+                    width = k - q * GEMM_NR < GEMM_NR ? k - q * GEMM_NR : GEMM_NR;
+                    for (c = 0; c < width; c++) { out_row[q * GEMM_NR + c] = acc[((size_t)q * tile + (i - i0)) * GEMM_NR + c]; }
+                }
+            }
+        }
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (j = 0; j < N; j++) { /* add the transposed contributions, thread 0 first */
+            out_row = MAT_ROW(out, j);
+            for (t = 0; t < threads; t++) {
+                part = MAT_ROW(workspace, panel_rows + (size_t)t * segment);
+                for (q = 0; q < panels; q++) {
+                    width = k - q * GEMM_NR < GEMM_NR ? k - q * GEMM_NR : GEMM_NR;
+                    for (c = 0; c < width; c++) { out_row[q * GEMM_NR + c] += part[((size_t)q * N + j) * GEMM_NR + c]; }
+                }
+            }
+        }
+    }
+}
+/*
+ * ========================================TILED_W_CREATE==========================================
+ * keeps the points and their transpose, the degrees are the row sums of A taken with the
+ * operator itself (every inverse square root set to 1 makes it A) against a vector of ones
+ * tile <= 0 selects TILED_DEFAULT_TILE, the tile is rounded up to a multiple of SYMM_MR
+ * returns NULL on failure, caller is the handler
+*/
+tiled_w* tiled_w_create(const matrix *data_points, int tile) {
+    const int N = data_points->rows, d = data_points->cols;
+    tiled_w *W;
+    w_operator A_operator;
+    matrix *ones, *degrees, *workspace;
+    int i, c;
+
+    W = (tiled_w *)malloc(sizeof(tiled_w) + (size_t)N * (1 + (size_t)d) * sizeof(double));
+    if (W == NULL) { return NULL; }
+    PROFILE_ALLOC(sizeof(tiled_w) + (size_t)N * (1 + (size_t)d) * sizeof(double));
+    if (tile <= 0) { tile = TILED_DEFAULT_TILE; }
+    if (tile > N) { tile = N; }
+    W->points = data_points;
+    W->tile = (tile + SYMM_MR - 1) / SYMM_MR * SYMM_MR;
+    W->inv_sqrt_degrees = (double *)(W + 1);
+    W->columns = W->inv_sqrt_degrees + N;
+    for (i = 0; i < N; i++) {
+        W->inv_sqrt_degrees[i] = 1.0;
+        for (c = 0; c < d; c++) { W->columns[(size_t)c * N + i] = MAT_AT(data_points, i, c); }
+    }
+    w_operator_tiled(&A_operator, W);
+    ones = matrix_alloc(N, 1);
+    degrees = matrix_alloc(N, 1);
+    workspace = tiled_workspace_alloc(&A_operator, 1);
+    if (ones == NULL || degrees == NULL || workspace == NULL) {
+        free(W); free_matrix(ones); free_matrix(degrees); free_matrix(workspace);
+        return NULL;
+    }
+    PROFILE_BEGIN("degrees");
+    for (i = 0; i < N; i++) { MAT_AT(ones, i, 0) = 1.0; }
+    tiled_multiply(&A_operator, ones, degrees, workspace);
+    for (i = 0; i < N; i++) { /* avoid division by zero, an isolated point has an all zero row */
+        W->inv_sqrt_degrees[i] = MAT_AT(degrees, i, 0) > 0 ? 1.0 / sqrt(MAT_AT(degrees, i, 0)) : 0.0;
+    }
+    PROFILE_END(PROFILE_PAIRS(N) * (PROFILE_KERNEL_FLOPS(d) + 4));
+    free_matrix(ones); free_matrix(degrees); free_matrix(workspace);
+    return W;
+}
+/*
+ * ========================================FREE_TILED_W============================================
+ * free a tiled W from tiled_w_create(), the points are not touched
+*/
+void free_tiled_w(tiled_w *W) {
+    free(W);
+}
+/*
+ * ========================================TILED_SQUARED_NORM======================================
+ * ||W||_F^2 from the entries above the diagonal, summed per row tile and then in tile order
+ * without memory for the per tile sums the same sums are taken serially, giving the same bits
+*/
+static double tiled_squared_norm(const w_operator *op) {
+    const tiled_w *W = (const tiled_w *)op->data;
+    const int N = op->N, tile = W->tile;
+    const int tiles = N > 0 ? (N + tile - 1) / tile : 0;
+    double *sums, sum, total = 0.0, w;
+    int I, i, j;
+
+    sums = (double *)malloc((tiles > 0 ? (size_t)tiles : 1) * sizeof(double));
+#ifdef _OPENMP
+#pragma omp parallel for private(i, j, sum, w) schedule(dynamic, 1) if (sums != NULL)
+#endif
+    for (I = 0; I < tiles; I++) {
+        sum = 0.0;
+        for (i = I * tile; i < (I + 1) * tile && i < N; i++) {
+            for (j = i + 1; j < N; j++) { w = tiled_entry(W, i, j); sum += w * w; }
+        }
+        if (sums != NULL) { sums[I] = sum; }
+        else { total += sum; }
+    }
+    if (sums != NULL) {
+        for (I = 0; I < tiles; I++) { total += sums[I]; }
+        free(sums);
+    }
+    return 2 * total;
+}
+/*
+ * ========================================PRINT_TILED=============================================
+ * print W in the print_matrix() format, every row is generated as it is printed
+ * returns 1 on success, 0 if the output could not be written
+*/
+static void fill_tiled_row(const void *source, int i, double *row) {
+    const tiled_w *W = (const tiled_w *)source;
+    fill_row(gemm_detect_isa(), W, i, 0, W->points->rows, row);
+}
+int print_tiled(const tiled_w *W) {
+    return output_rows(stdout, W->points->rows, W->points->rows, fill_tiled_row, W);
+}
+/*
+ * ========================================W_OPERATOR_TILED========================================
+ * exposes a tiled W to optimize_h_op(), every product regenerates W, N^2/2 kernel evaluations
+*/
+void w_operator_tiled(w_operator *op, const tiled_w *W) {
+    op->N = W->points->rows;
+    op->entries = (double)W->points->rows * W->points->rows;
+    op->data = W;
+    op->workspace_alloc = tiled_workspace_alloc;
+    op->multiply = tiled_multiply;
+    op->squared_norm = tiled_squared_norm;
+}
+/*
+ * ========================================TILED_PREFERRED=========================================
+ * 1 if W of N points in d dimensions should be regenerated rather than stored (packed):
+ * always when packed W would take more than half of the physical memory, and for small d when
+ * W is far larger than any cache and enough threads share the memory bus. a product then costs
+ * a packed W 8 bytes of memory traffic per pair, the bus is shared by every thread, while
+ * regenerating costs a few ns of arithmetic per pair that the threads split among themselves
+ * SYMNMF_W=packed or SYMNMF_W=tiled overrides the choice
+*/
+int tiled_preferred(int N, int d, int threads) {
+    const char *forced = getenv("SYMNMF_W");
+    const double packed_bytes = (double)N * (N + 1) / 2 * sizeof(double);
+    double memory = 0.0;
+#ifdef TILED_SYSCONF
+    long pages = sysconf(_SC_PHYS_PAGES), page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0) { memory = (double)pages * page_size; }
+#endif
+    if (forced != NULL && strcmp(forced, "tiled") == 0) { return 1; }
+    if (forced != NULL && strcmp(forced, "packed") == 0) { return 0; }
+    if (memory > 0 && packed_bytes > memory / 2) { return 1; }
+    return d <= TILED_MAX_AUTO_D && threads >= TILED_AUTO_MIN_THREADS && packed_bytes > TILED_AUTO_MIN_BYTES;
+}
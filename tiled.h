@@ -0,0 +1,25 @@
+/*
+ * the normalized W of a set of points without storing it: only the points (not owned), their
+ * transpose and the N inverse square roots of the degrees are kept, and W is regenerated in
+ * tile x tile blocks whenever a product needs it, so memory is O(N*(d + k) + tile^2) per thread
+ * instead of O(N^2). the header and the arrays share a single allocation
+ */
+typedef struct {
+    const matrix *points;
+    int tile;                 /* a multiple of SYMM_MR */
+    double *inv_sqrt_degrees; /* N entries, 0 for a point with no neighbors */
+    double *columns;          /* d rows of N, coordinate c of every point, read along j by the kernels */
+} tiled_w;
+
+#define TILED_DEFAULT_TILE 256 /* a 512KB block of W, about the size of L2 */
+/* automatic choice (tiled_preferred()): regenerating W beats reading it for small d, a W beyond
+ * any cache and enough threads to outrun the memory bandwidth */
+#define TILED_MAX_AUTO_D 16
+#define TILED_AUTO_MIN_THREADS 8
+#define TILED_AUTO_MIN_BYTES (512.0 * 1024 * 1024)
+
+tiled_w* tiled_w_create(const matrix *data_points, int tile);
+void free_tiled_w(tiled_w *W);
+int print_tiled(const tiled_w *W);
+void w_operator_tiled(w_operator *op, const tiled_w *W);
+int tiled_preferred(int N, int d, int threads);
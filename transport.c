@@ -0,0 +1,262 @@
+#define _POSIX_C_SOURCE 200809L /* fork, waitpid, socketpair, MSG_NOSIGNAL, shm_open, mmap */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "symnmf.h"
+#include "transport.h"
+#include "profile.h"
+#if defined(__unix__) || defined(__APPLE__)
+#define TRANSPORT_SHM
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#ifdef TRANSPORT_SHM
+typedef struct {
+    int fd;           /* the shared memory file, already unlinked */
+    double *region;   /* (size + 2) buffers of capacity doubles, NULL until the first collective */
+    size_t capacity;  /* doubles per buffer */
+    long gathers;     /* allgather() calls so far, the parity picks the gather buffer */
+    int broken;       /* a collective failed, every later one fails at once */
+    int *sockets;     /* rank 0: the socket to rank r at [r], the others: the socket to rank 0 at [0] */
+    pid_t *children;  /* rank 0: the pid of rank r at [r] */
+} shm_state;
+
+#define SHM_BUFFER(state, b) ((state)->region + (size_t)(b) * (state)->capacity)
+
+/*
+ * ========================================SEND_BYTE / RECV_BYTE===================================
+ * one status byte over a socket, retried when a signal interrupts it
+ * send returns 1 on success, recv the byte or -1 if the peer is gone
+*/
+static int send_byte(int fd, unsigned char byte) {
+    ssize_t sent;
+    do { sent = send(fd, &byte, 1, MSG_NOSIGNAL); } while (sent < 0 && errno == EINTR);
+    return sent == 1;
+}
+static int recv_byte(int fd) {
+    unsigned char byte;
+    ssize_t received;
+    do { received = recv(fd, &byte, 1, 0); } while (received < 0 && errno == EINTR);
+    return received == 1 ? byte : -1;
+}
+/*
+ * ========================================SHM_FAIL================================================
+ * marks the transport broken and closes its sockets, so the processes waiting on this one see
+ * the end of the stream and fail too instead of hanging. returns 0 for the caller to pass on
+*/
+static int shm_fail(transport *t) {
+    shm_state *state = (shm_state *)t->data;
+    int r;
+    if (!state->broken) {
+        for (r = 0; r < (t->rank == 0 ? t->size : 1); r++) {
+            if (state->sockets[r] >= 0) { close(state->sockets[r]); state->sockets[r] = -1; }
+        }
+    }
+    state->broken = 1;
+    return 0;
+}
+/*
+ * ========================================SHM_ARRIVE==============================================
+ * the first half of a collective: every process of rank 1 and up reports with a status byte and
+ * rank 0 waits for all of them. returns 1 if everyone succeeded, 0 otherwise (the transport is
+ * then broken)
+*/
+static int shm_arrive(transport *t, int ok) {
+    shm_state *state = (shm_state *)t->data;
+    int r;
+    if (t->rank != 0) { return send_byte(state->sockets[0], (unsigned char)ok) ? 1 : shm_fail(t); }
+    for (r = 1; r < t->size; r++) {
+        if (recv_byte(state->sockets[r]) != 1) { ok = 0; }
+    }
+    return ok ? 1 : shm_fail(t);
+}
+/*
+ * ========================================SHM_RELEASE=============================================
+ * the second half: rank 0 sends the outcome to every process, which waits for it
+*/
+static int shm_release(transport *t, int ok) {
+    shm_state *state = (shm_state *)t->data;
+    int r;
+    if (t->rank != 0) { return recv_byte(state->sockets[0]) == 1 ? 1 : shm_fail(t); }
+    for (r = 1; r < t->size; r++) {
+        if (!send_byte(state->sockets[r], (unsigned char)ok)) { ok = 0; }
+    }
+    return ok ? 1 : shm_fail(t);
+}
+/*
+ * ========================================SHM_RESERVE=============================================
+ * makes every buffer hold at least count doubles. all processes ask for the same counts in the
+ * same order, so they grow together: in a barrier (nobody is still reading an old buffer) rank 0
+ * extends the file, then every process maps it again
+*/
+static int shm_reserve(transport *t, size_t count) {
+    shm_state *state = (shm_state *)t->data;
+    const size_t bytes = (size_t)(t->size + 2) * count * sizeof(double);
+    void *mapping;
+    int ok;
+
+    if (state->broken) { return 0; }
+    if (count <= state->capacity) { return 1; }
+    if (!shm_arrive(t, 1)) { return 0; }
+    ok = t->rank != 0 || ftruncate(state->fd, (off_t)bytes) == 0;
+    if (!shm_release(t, ok)) { return 0; }
+    if (state->region != NULL) { munmap(state->region, (size_t)(t->size + 2) * state->capacity * sizeof(double)); }
+    state->region = NULL;
+    mapping = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, state->fd, 0);
+    if (mapping == MAP_FAILED) { return shm_fail(t); }
+    state->region = (double *)mapping;
+    state->capacity = count;
+    return 1;
+}
+/*
+ * ========================================SHM_ALLREDUCE_SUM=======================================
+ * every process of rank 1 and up writes its values into its slot, rank 0 adds the slots to its
+ * own values in rank order and publishes the sums, which the others copy back
+*/
+static int shm_allreduce_sum(transport *t, double *values, int count) {
+    shm_state *state = (shm_state *)t->data;
+    double *result, sum;
+    int i, r, ok;
+
+    if (t->size == 1) { return 1; }
+    PROFILE_BEGIN("exchange");
+    ok = shm_reserve(t, (size_t)count);
+    if (ok && t->rank != 0) {
+        memcpy(SHM_BUFFER(state, t->rank), values, (size_t)count * sizeof(double));
+        ok = shm_arrive(t, 1) && shm_release(t, 1);
+        if (ok) { memcpy(values, SHM_BUFFER(state, TRANSPORT_RESULT), (size_t)count * sizeof(double)); }
+    }
+    else if (ok) {
+        ok = shm_arrive(t, 1);
+        if (ok) {
+            result = SHM_BUFFER(state, TRANSPORT_RESULT);
+            for (i = 0; i < count; i++) {
+                for (sum = values[i], r = 1; r < t->size; r++) { sum += SHM_BUFFER(state, r)[i]; }
+                values[i] = result[i] = sum;
+            }
+            ok = shm_release(t, 1);
+        }
+    }
+    PROFILE_END((double)count * (t->rank == 0 ? t->size - 1 : 0));
+    return ok;
+}
+/*
+ * ========================================SHM_ALLGATHER===========================================
+ * every process writes its rows into the shared gather buffer of this call, and after the
+ * barrier copies the rows of the others out of it
+*/
+static int shm_allgather(transport *t, double *all, const int *starts, int width) {
+    shm_state *state = (shm_state *)t->data;
+    const size_t own = (size_t)starts[t->rank] * width, own_count = (size_t)(starts[t->rank + 1] - starts[t->rank]) * width;
+    const size_t total = (size_t)starts[t->size] * width;
+    double *buffer;
+    int ok;
+
+    if (t->size == 1) { return 1; }
+    PROFILE_BEGIN("exchange");
+    ok = shm_reserve(t, total);
+    if (ok) {
+        buffer = SHM_BUFFER(state, t->size + (int)(state->gathers++ % 2));
+        memcpy(buffer + own, all + own, own_count * sizeof(double));
+        ok = shm_arrive(t, 1) && shm_release(t, 1);
+        if (ok) {
+            memcpy(all, buffer, own * sizeof(double));
+            memcpy(all + own + own_count, buffer + own + own_count, (total - own - own_count) * sizeof(double));
+        }
+    }
+    PROFILE_END(0);
+    return ok;
+}
+/*
+ * ========================================SHM_CLOSE===============================================
+ * rank 0 closes its sockets and waits for the other processes to end, they only free their side
+*/
+static void shm_close(transport *t) {
+    shm_state *state = (shm_state *)t->data;
+    int r, status;
+    for (r = 0; r < (t->rank == 0 ? t->size : 1); r++) {
+        if (state->sockets[r] >= 0) { close(state->sockets[r]); }
+    }
+    if (t->rank == 0) {
+        for (r = 1; r < t->size; r++) {
+            if (state->children[r] > 0) { while (waitpid(state->children[r], &status, 0) < 0 && errno == EINTR) { } }
+        }
+    }
+    if (state->region != NULL) { munmap(state->region, (size_t)(t->size + 2) * state->capacity * sizeof(double)); }
+    close(state->fd);
+    free(state->sockets); free(state->children); free(state); free(t);
+}
+#endif
+/*
+ * ========================================TRANSPORT_SHM_SPAWN=====================================
+ * forks procs - 1 processes and returns the transport of the calling process in each of them:
+ * rank 0 in the caller, 1 to procs - 1 in the children, which continue from this call as well.
+ * it must be called before any OpenMP parallel region, a child of a process whose thread pool
+ * exists hangs in its first region. stdio buffers are flushed first so nothing is written twice
+ * returns NULL on failure (in the caller, no child is left running) or where fork() and shared
+ * memory are not available, caller is the handler
+*/
+transport* transport_shm_spawn(int procs) {
+#ifdef TRANSPORT_SHM
+    transport *t;
+    shm_state *state;
+    char name[64];
+    int pair[2], r, other, failed = 0;
+    pid_t pid;
+
+    if (procs < 1) { return NULL; }
+    t = (transport *)malloc(sizeof(transport));
+    state = (shm_state *)calloc(1, sizeof(shm_state));
+    if (t == NULL || state == NULL) { free(t); free(state); return NULL; }
+    state->sockets = (int *)malloc((size_t)procs * sizeof(int));
+    state->children = (pid_t *)calloc((size_t)procs, sizeof(pid_t));
+    sprintf(name, "/symnmf-%ld", (long)getpid());
+    state->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (state->fd >= 0) { shm_unlink(name); } /* the processes share the open file, nobody else needs the name */
+    if (state->sockets == NULL || state->children == NULL || state->fd < 0) {
+        if (state->fd >= 0) { close(state->fd); }
+        free(state->sockets); free(state->children); free(state); free(t);
+        return NULL;
+    }
+    t->rank = 0;
+    t->size = procs;
+    t->data = state;
+    t->allreduce_sum = shm_allreduce_sum;
+    t->allgather = shm_allgather;
+    t->close = shm_close;
+    state->sockets[0] = -1;
+    fflush(NULL);
+    for (r = 1; r < procs && !failed; r++) {
+        state->sockets[r] = -1;
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) { failed = 1; break; }
+        pid = fork();
+        if (pid < 0) { close(pair[0]); close(pair[1]); failed = 1; break; }
+        if (pid == 0) { /* the child keeps only its end towards rank 0 */
+            close(pair[0]);
+            for (other = 1; other < r; other++) { close(state->sockets[other]); }
+            state->sockets[0] = pair[1];
+            t->rank = r;
+            return t;
+        }
+        close(pair[1]);
+        state->sockets[r] = pair[0];
+        state->children[r] = pid;
+    }
+    if (failed) { /* the children see their socket close and end */
+        t->size = r;
+        shm_close(t);
+        return NULL;
+    }
+    return t;
+#else
+    (void)procs;
+    return NULL;
+#endif
+}
@@ -0,0 +1,12 @@
+/*
+ * a transport (see symnmf.h) between processes of one machine: rank 0 forks the others, the data
+ * of every collective goes through a shared memory file and each process signals rank 0 over a
+ * UNIX socket pair. rank 0 sums the contributions in rank order and releases the others with one
+ * byte each, so a collective costs two small messages per process besides the copies. the file
+ * grows (in a barrier) to the largest collective seen, every buffer holds that many doubles:
+ * the result, one contribution slot per process of rank 1 and up, and two gather buffers used
+ * alternately so a process can start the next gather while the slowest one still reads
+ */
+#define TRANSPORT_RESULT 0 /* buffer of the allreduce result, the slot of rank r is buffer r */
+
+transport* transport_shm_spawn(int procs);